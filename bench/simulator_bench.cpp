@@ -0,0 +1,119 @@
+// simulator_bench.cpp
+// Throughput of the simulated machine (translation + cache accesses, no
+// trace I/O) in accesses per second, for the main translation paths: page
+// tables cacheable or not, TOC on or off.
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "simulator.h"
+#include "synthetic_trace.h"
+#include "trace_reader.h"
+
+using std::cerr;
+using std::cout;
+
+struct BenchCase {
+    const char* name;
+    bool pteCachable;
+    bool tocEnabled;
+};
+
+// Best accesses/sec over repeat runs, each on a fresh simulator
+static double RunCase(const BenchCase& bench,
+                      const std::vector<MEMREF>& accesses, UINT64 batchSize,
+                      int repeat) {
+    SimConfig config;
+    config.pgtbl.pteCachable = bench.pteCachable;
+    config.pgtbl.tocEnabled = bench.tocEnabled;
+    config.pgtbl.tocSize = bench.tocEnabled ? 8 : 0;
+
+    double best = 0;
+    std::vector<ADDRINT> paddrs(batchSize);
+    for (int r = 0; r < repeat; ++r) {
+        Simulator sim(config);
+        auto start = std::chrono::steady_clock::now();
+        for (UINT64 i = 0; i < accesses.size(); i += batchSize) {
+            UINT64 n = std::min<UINT64>(batchSize, accesses.size() - i);
+            sim.ProcessBatch(accesses.data() + i, n, paddrs.data());
+        }
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+        best = std::max(best, accesses.size() / seconds);
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    UINT64 numAccesses = 2000000;
+    UINT64 batchSize = 4096;
+    int repeat = 3;
+    UINT64 seed = 1;
+    std::string traceFile;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            cout << "Usage: " << argv[0] << " [options] [traceFile]\n"
+                 << "Options:\n"
+                 << "  -h, --help                Show this help message\n"
+                 << "  --accesses N              Synthetic accesses, or "
+                    "accesses read from the trace (default: 2000000)\n"
+                 << "  --batch_size N            Batch size for processing "
+                    "(default: 4096)\n"
+                 << "  --repeat N                Runs per case, the best is "
+                    "reported (default: 3)\n"
+                 << "  --seed N                  Synthetic stream seed "
+                    "(default: 1)\n";
+            return 0;
+        } else if (arg == "--accesses" && i + 1 < argc) {
+            numAccesses = std::stoull(argv[++i]);
+        } else if (arg == "--batch_size" && i + 1 < argc) {
+            batchSize = std::stoull(argv[++i]);
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::stoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        } else if (arg[0] != '-') {
+            traceFile = arg;
+        } else {
+            cerr << "Unknown option: " << arg << '\n';
+            return 1;
+        }
+    }
+
+    // Decode everything up front so only the simulator is timed
+    std::vector<MEMREF> accesses(numAccesses);
+    if (traceFile.empty()) {
+        SyntheticTrace(seed).Fill(accesses.data(), accesses.size());
+    } else {
+        TraceReader input;
+        if (!input.Open(traceFile)) {
+            cerr << "Error: Could not open trace file: " << traceFile << '\n';
+            return 1;
+        }
+        accesses.resize(input.ReadBatch(accesses.data(), accesses.size()));
+        input.Close();
+    }
+
+    const BenchCase cases[] = {
+        {"default", false, false},
+        {"pte_cachable", true, false},
+        {"toc", false, true},
+        {"pte_cachable+toc", true, true},
+    };
+    cout << "Simulator throughput, " << accesses.size() << " accesses ("
+         << (traceFile.empty() ? "synthetic" : traceFile) << "), best of "
+         << repeat << '\n';
+    for (const BenchCase& bench : cases) {
+        double rate = RunCase(bench, accesses, batchSize, repeat);
+        cout << std::left << std::setw(20) << bench.name << std::right
+             << std::setw(12) << std::fixed << std::setprecision(2)
+             << rate / 1e6 << " M accesses/s\n";
+    }
+    return 0;
+}
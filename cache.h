@@ -1,8 +1,11 @@
 #pragma once
 
+#include <cassert>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "common.h"
+#include "huge_page.h"
 
 // Base class for set-associative caches
 template <typename TagType, typename ValueType>
@@ -13,10 +16,18 @@ class SetAssociativeCache {
         ValueType value;
         bool valid;
         bool dirty;  // NEW: dirty bit for write-back policy
+        UINT8 lineClass;  // Requester class of the line (see CacheLineClass)
+        UINT8 prefetchSource;  // Prefetcher that filled the line, until used
         UINT64 lruCounter;
 
         CacheEntry()
-            : tag(0), value(0), valid(false), dirty(false), lruCounter(0) {}
+            : tag(0),
+              value(0),
+              valid(false),
+              dirty(false),
+              lineClass(0),
+              prefetchSource(kDemandFill),
+              lruCounter(0) {}
     };
 
     std::string name_;         // Cache name_ for reporting
@@ -25,28 +36,213 @@ class SetAssociativeCache {
     UINT64 accesses_;          // Access counter
     UINT64 hits_;              // Hit counter
     UINT64 globalLruCounter_;  // Global counter for LRU policy
-    std::vector<std::vector<CacheEntry>> sets_;  // Cache storage [set][way]
+    // Prefetch accounting by source: lines filled, lines hit by a demand
+    // access before eviction (useful) and lines evicted unused (useless)
+    UINT64 prefetchFills_[kNumPrefetchSources] = {};
+    UINT64 usefulPrefetches_[kNumPrefetchSources] = {};
+    UINT64 uselessPrefetches_[kNumPrefetchSources] = {};
+    // Cache storage, set-major: the ways of a set are contiguous so a whole
+    // set can be prefetched ahead of its lookup
+    std::vector<CacheEntry, HugePageAllocator<CacheEntry>> sets_;
+    // Way partitioning (CAT-style): lookups hit in any way, but a requester
+    // may only allocate into the ways of its class of service (COS)
+    std::vector<UINT64> wayMasks_;  // Allocation way mask per COS
+    UINT64 allWaysMask_;            // Mask with every way set
+    UINT64 allocMask_;              // Ways the current requester may fill
+    UINT64 cos_;                    // Current class of service
+    // Retention policy by line class (bit N of a mask stands for class N)
+    UINT8 fillClass_;         // Class stamped on lines the requester fills
+    UINT64 lruInsertClasses_;  // Classes inserted at LRU instead of MRU
+    UINT64 pinnedClasses_;     // Classes never chosen as victims
+    UINT64 protectedClasses_;  // Classes shielded from other classes' fills
+    UINT64 protectedWays_;     // Max protected lines per set
+    bool retentionActive_;     // Any pinning/protection configured
+    UINT8 evictClass_;         // Class of the line HandleEviction reports
+    CacheEntry* Set(UINT64 setIndex) { return &sets_[setIndex * numWays_]; }
+    const CacheEntry* Set(UINT64 setIndex) const {
+        return &sets_[setIndex * numWays_];
+    }
+
+    // Fully-associative index, used when there is a single set too large to
+    // scan: tag -> way map, intrusive LRU list over valid ways (MRU at head)
+    // and a stack of invalid ways
+    static constexpr UINT64 kFullyAssociativeScanLimit = 16;
+    static constexpr UINT32 kNoWay = ~0U;
+    bool fullyAssociative_;
+    std::unordered_map<TagType, UINT32> wayIndex_;
+    std::vector<UINT32> lruPrev_;
+    std::vector<UINT32> lruNext_;
+    UINT32 lruHead_;
+    UINT32 lruTail_;
+    std::vector<UINT32> freeWays_;
+    std::vector<UINT32> freeSlot_;  // Position of each invalid way in freeWays_
+
+    void LruUnlink(UINT32 way) {
+        UINT32 prev = lruPrev_[way];
+        UINT32 next = lruNext_[way];
+        (prev == kNoWay ? lruHead_ : lruNext_[prev]) = next;
+        (next == kNoWay ? lruTail_ : lruPrev_[next]) = prev;
+    }
+
+    void LruPushHead(UINT32 way) {
+        lruPrev_[way] = kNoWay;
+        lruNext_[way] = lruHead_;
+        (lruHead_ == kNoWay ? lruTail_ : lruPrev_[lruHead_]) = way;
+        lruHead_ = way;
+    }
+
+    void LruPushTail(UINT32 way) {
+        lruNext_[way] = kNoWay;
+        lruPrev_[way] = lruTail_;
+        (lruTail_ == kNoWay ? lruHead_ : lruNext_[lruTail_]) = way;
+        lruTail_ = way;
+    }
+
+    void FreeWayPush(UINT32 way) {
+        freeSlot_[way] = freeWays_.size();
+        freeWays_.push_back(way);
+    }
+
+    void FreeWayRemove(UINT32 way) {
+        UINT32 last = freeWays_.back();
+        freeWays_[freeSlot_[way]] = last;
+        freeSlot_[last] = freeSlot_[way];
+        freeWays_.pop_back();
+    }
+
+    // Make way hold tag as a valid entry, keeping the fully-associative
+    // index in sync. The caller fills in the rest of the entry.
+    void InstallTag(UINT64 setIndex, UINT64 way, const TagType& tag) {
+        CacheEntry& entry = Set(setIndex)[way];
+        if (fullyAssociative_) {
+            if (entry.valid) {
+                wayIndex_.erase(entry.tag);
+            } else {
+                FreeWayRemove(way);
+                LruPushHead(way);
+            }
+            wayIndex_[tag] = way;
+        }
+        entry.tag = tag;
+        entry.valid = true;
+    }
+
+    // Move a just-filled entry to the LRU position: first victim unless reused
+    void DemoteToLru(UINT64 setIndex, UINT64 way) {
+        Set(setIndex)[way].lruCounter = 0;
+        if (fullyAssociative_) {
+            LruUnlink(way);
+            LruPushTail(way);
+        }
+    }
+
+    // Find the victim for a line of lineClass among the allowed ways,
+    // honoring the retention policy. Falls back to plain LRU over the
+    // allowed ways when every candidate is pinned or protected.
+    UINT64 FindPolicyVictimWay(UINT64 setIndex, UINT8 lineClass) const {
+        const CacheEntry* set = Set(setIndex);
+        UINT64 candidates = 0;
+        UINT64 protectedMask = 0;
+        for (UINT64 way = 0; way < numWays_; way++) {
+            if (!(allocMask_ >> way & 1)) {
+                continue;
+            }
+            if (!set[way].valid) {
+                return way;  // Return first invalid entry
+            }
+            UINT64 classBit = 1ULL << set[way].lineClass;
+            if (pinnedClasses_ & classBit) {
+                continue;
+            }
+            if (protectedClasses_ & classBit) {
+                protectedMask |= 1ULL << way;
+            }
+            candidates |= 1ULL << way;
+        }
+        // Protected lines only survive fills of other classes, and only the
+        // protectedWays_ most recently used of them per set
+        if (!(protectedClasses_ >> lineClass & 1) && protectedMask != 0) {
+            while ((UINT64)__builtin_popcountll(protectedMask) >
+                   protectedWays_) {
+                UINT64 lruWay = 0;
+                UINT64 minCounter = ~0ULL;
+                for (UINT64 way = 0; way < numWays_; way++) {
+                    if ((protectedMask >> way & 1) &&
+                        set[way].lruCounter < minCounter) {
+                        minCounter = set[way].lruCounter;
+                        lruWay = way;
+                    }
+                }
+                protectedMask &= ~(1ULL << lruWay);
+            }
+            if (candidates != protectedMask) {
+                candidates &= ~protectedMask;
+            }
+        }
+        if (candidates == 0) {
+            candidates = allocMask_;
+        }
+
+        UINT64 lruWay = numWays_;
+        UINT64 minCounter = ~0ULL;
+        for (UINT64 way = 0; way < numWays_; way++) {
+            if ((candidates >> way & 1) && set[way].lruCounter < minCounter) {
+                minCounter = set[way].lruCounter;
+                lruWay = way;
+            }
+        }
+        return lruWay;
+    }
 
     // Find the LRU entry in a set
     UINT64 FindLruWay(UINT64 setIndex) const {
+        return FindLruWay(setIndex, fillClass_);
+    }
+
+    // Find the way a line of lineClass replaces
+    UINT64 FindLruWay(UINT64 setIndex, UINT8 lineClass) const {
+        if (allocMask_ != allWaysMask_ || retentionActive_) {
+            return FindPolicyVictimWay(setIndex, lineClass);
+        }
+        if (fullyAssociative_) {
+            return freeWays_.empty() ? lruTail_ : freeWays_.back();
+        }
         UINT64 lruWay = 0;
-        UINT64 minCounter = sets_[setIndex][0].lruCounter;
+        UINT64 minCounter = Set(setIndex)[0].lruCounter;
 
         for (UINT64 way = 0; way < numWays_; way++) {
-            if (!sets_[setIndex][way].valid) {
+            if (!Set(setIndex)[way].valid) {
                 return way;  // Return first invalid entry
             }
-            if (sets_[setIndex][way].lruCounter < minCounter) {
-                minCounter = sets_[setIndex][way].lruCounter;
+            if (Set(setIndex)[way].lruCounter < minCounter) {
+                minCounter = Set(setIndex)[way].lruCounter;
                 lruWay = way;
             }
         }
         return lruWay;
     }
 
+    // Way holding tag in the set, or numWays_ if absent
+    UINT64 FindWay(UINT64 setIndex, const TagType& tag) const {
+        if (fullyAssociative_) {
+            auto it = wayIndex_.find(tag);
+            return it == wayIndex_.end() ? numWays_ : it->second;
+        }
+        for (UINT64 way = 0; way < numWays_; way++) {
+            if (Set(setIndex)[way].valid && Set(setIndex)[way].tag == tag) {
+                return way;
+            }
+        }
+        return numWays_;
+    }
+
     // Update LRU status for an entry
     void UpdateLru(UINT64 setIndex, UINT64 wayIndex) {
-        sets_[setIndex][wayIndex].lruCounter = ++globalLruCounter_;
+        Set(setIndex)[wayIndex].lruCounter = ++globalLruCounter_;
+        if (fullyAssociative_ && lruHead_ != wayIndex) {
+            LruUnlink(wayIndex);
+            LruPushHead(wayIndex);
+        }
     }
 
     // Hash function to map from tag to set index
@@ -64,81 +260,236 @@ class SetAssociativeCache {
           numWays_(ways),
           accesses_(0),
           hits_(0),
-          globalLruCounter_(0) {
+          globalLruCounter_(0),
+          allWaysMask_(ways >= 64 ? ~0ULL : (1ULL << ways) - 1),
+          allocMask_(allWaysMask_),
+          cos_(0),
+          fillClass_(0),
+          lruInsertClasses_(0),
+          pinnedClasses_(0),
+          protectedClasses_(0),
+          protectedWays_(0),
+          retentionActive_(false),
+          evictClass_(0),
+          fullyAssociative_(numSets == 1 &&
+                            ways > kFullyAssociativeScanLimit),
+          lruHead_(kNoWay),
+          lruTail_(kNoWay) {
 
         // Initialize cache structure
-        sets_.resize(numSets);
-        for (UINT64 i = 0; i < numSets; i++) {
-            sets_[i].resize(numWays_);
-            for (UINT64 j = 0; j < numWays_; j++) {
-                sets_[i][j].valid = false;
+        sets_.resize(numSets * numWays_);
+        if (fullyAssociative_) {
+            wayIndex_.reserve(numWays_);
+            lruPrev_.assign(numWays_, kNoWay);
+            lruNext_.assign(numWays_, kNoWay);
+            freeSlot_.resize(numWays_);
+            for (UINT64 way = numWays_; way-- > 0;) {
+                FreeWayPush(way);  // Lowest way on top, as in the set scan
             }
         }
     }
 
     virtual ~SetAssociativeCache() = default;
 
+    // Pull the set a later access to tag will search into the host cache
+    void PrefetchSet(const TagType& tag) const {
+        if (fullyAssociative_) {
+            return;
+        }
+        const char* set = reinterpret_cast<const char*>(Set(GetSetIndex(tag)));
+        for (UINT64 offset = 0; offset < numWays_ * sizeof(CacheEntry);
+             offset += 64) {
+            __builtin_prefetch(set + offset);
+        }
+    }
+
     // Core lookup operation
     bool Lookup(const TagType& tag, ValueType& value) {
+        if (Probe(tag, value)) {
+            return true;
+        }
         accesses_++;
+        return false;
+    }
+
+    // Lookup that leaves a miss uncounted, for callers that may hand the
+    // access to another path; CountMiss records it if they go on
+    bool Probe(const TagType& tag, ValueType& value) {
         UINT64 setIndex = GetSetIndex(tag);
+        UINT64 way = FindWay(setIndex, tag);
+        if (way == numWays_) {
+            return false;
+        }
 
-        for (UINT64 way = 0; way < numWays_; way++) {
-            if (sets_[setIndex][way].valid && sets_[setIndex][way].tag == tag) {
-                hits_++;
-                value = sets_[setIndex][way].value;
-                UpdateLru(setIndex, way);
-                return true;
+        CacheEntry& entry = Set(setIndex)[way];
+        accesses_++;
+        hits_++;
+        value = entry.value;
+        if (entry.prefetchSource != kDemandFill) {
+            usefulPrefetches_[entry.prefetchSource]++;
+            entry.prefetchSource = kDemandFill;
+        }
+        UpdateLru(setIndex, way);
+        return true;
+    }
+
+    void CountMiss() { accesses_++; }
+
+    // Check for a block without touching stats or LRU state
+    bool Contains(const TagType& tag) const {
+        UINT64 setIndex = GetSetIndex(tag);
+        return FindWay(setIndex, tag) != numWays_;
+    }
+
+    // Drop a block without write-back, returns whether it was present
+    bool Invalidate(const TagType& tag) {
+        UINT64 setIndex = GetSetIndex(tag);
+        UINT64 way = FindWay(setIndex, tag);
+        if (way == numWays_) {
+            return false;
+        }
+        Set(setIndex)[way].valid = false;
+        Set(setIndex)[way].dirty = false;
+        if (fullyAssociative_) {
+            wayIndex_.erase(tag);
+            LruUnlink(way);
+            FreeWayPush(way);
+        }
+        return true;
+    }
+
+    // Clear a block's dirty bit, returns whether it was dirty
+    bool Clean(const TagType& tag) {
+        UINT64 setIndex = GetSetIndex(tag);
+        UINT64 way = FindWay(setIndex, tag);
+        if (way == numWays_ || !Set(setIndex)[way].dirty) {
+            return false;
+        }
+        Set(setIndex)[way].dirty = false;
+        return true;
+    }
+
+    // Tags of the valid entries that satisfy pred
+    template <typename Pred>
+    std::vector<TagType> FindTags(Pred pred) const {
+        std::vector<TagType> tags;
+        for (const CacheEntry& entry : sets_) {
+            if (entry.valid && pred(entry.tag)) {
+                tags.push_back(entry.tag);
             }
         }
-        return false;
+        return tags;
+    }
+
+    // Fill a block on behalf of a prefetcher; no-op if already present
+    bool PrefetchInsert(const TagType& tag, const ValueType& value,
+                        UINT8 source) {
+        if (Contains(tag)) {
+            return false;
+        }
+        UINT64 way = Insert(tag, value, false);
+        Set(GetSetIndex(tag))[way].prefetchSource = source;
+        prefetchFills_[source]++;
+        return true;
     }
 
     // In cache.h, inside SetAssociativeCache class:
-    void Insert(const TagType& tag, const ValueType& value,
-                bool isWrite = false) {
+    // Returns the way now holding the block
+    UINT64 Insert(const TagType& tag, const ValueType& value,
+                  bool isWrite = false) {
+        return InsertAs(tag, value, isWrite, fillClass_);
+    }
+
+    // Insert a block of the given class instead of the fill class, e.g. a
+    // write-back keeping the class it had in the level above
+    UINT64 InsertAs(const TagType& tag, const ValueType& value, bool isWrite,
+                    UINT8 lineClass) {
         UINT64 setIndex = GetSetIndex(tag);
 
         // If block already in cache, update value and mark dirty on write
-        for (UINT64 way = 0; way < numWays_; ++way) {
-            if (sets_[setIndex][way].valid && sets_[setIndex][way].tag == tag) {
-                sets_[setIndex][way].value = value;
-                if (isWrite) {
-                    sets_[setIndex][way].dirty = true;  // mark as modified
-                }
-                // (If not a write, leave dirty flag as is)
-                UpdateLru(setIndex, way);
-                return;
+        UINT64 way = FindWay(setIndex, tag);
+        if (way != numWays_) {
+            Set(setIndex)[way].value = value;
+            if (isWrite) {
+                Set(setIndex)[way].dirty = true;  // mark as modified
             }
+            // (If not a write, leave dirty flag as is)
+            UpdateLru(setIndex, way);
+            return way;
         }
 
         // Block not present – choose a victim to evict (LRU)
-        UINT64 victimWay = FindLruWay(setIndex);
-        bool evictValid = sets_[setIndex][victimWay].valid;
+        UINT64 victimWay = FindLruWay(setIndex, lineClass);
+        bool evictValid = Set(setIndex)[victimWay].valid;
         bool evictDirty = false;
         TagType evictTag;
         ValueType evictValue;
         if (evictValid) {
             // Save evicted block info for write-back
-            evictDirty = sets_[setIndex][victimWay].dirty;
-            evictTag = sets_[setIndex][victimWay].tag;
-            evictValue = sets_[setIndex][victimWay].value;
+            evictDirty = Set(setIndex)[victimWay].dirty;
+            evictTag = Set(setIndex)[victimWay].tag;
+            evictValue = Set(setIndex)[victimWay].value;
+            evictClass_ = Set(setIndex)[victimWay].lineClass;
+            if (Set(setIndex)[victimWay].prefetchSource != kDemandFill) {
+                uselessPrefetches_[Set(setIndex)[victimWay]
+                                       .prefetchSource]++;
+            }
         }
 
         // Replace victim with new block
-        sets_[setIndex][victimWay].tag = tag;
-        sets_[setIndex][victimWay].value = value;
-        sets_[setIndex][victimWay].valid = true;
-        sets_[setIndex][victimWay].dirty =
+        InstallTag(setIndex, victimWay, tag);
+        Set(setIndex)[victimWay].value = value;
+        Set(setIndex)[victimWay].dirty =
             isWrite;  // dirty if this is a write access
-        UpdateLru(setIndex, victimWay);
+        Set(setIndex)[victimWay].lineClass = lineClass;
+        Set(setIndex)[victimWay].prefetchSource = kDemandFill;
+        if (lruInsertClasses_ >> lineClass & 1) {
+            DemoteToLru(setIndex, victimWay);
+        } else {
+            UpdateLru(setIndex, victimWay);
+        }
+
+        // Report the eviction (data caches write back dirty blocks)
+        if (evictValid) {
+            HandleEviction(evictTag, evictValue, evictDirty);
+        }
+        return victimWay;
+    }
 
-        // Write-back to next level if we evicted a dirty block
-        if (evictValid && evictDirty) {
-            HandleEviction(evictTag, evictValue, true);
+    // Restrict allocations of a class of service to the ways in mask
+    void SetWayMask(UINT64 cos, UINT64 mask) {
+        assert(numWays_ <= 64 && (mask & allWaysMask_) != 0);
+        if (wayMasks_.size() <= cos) {
+            wayMasks_.resize(cos + 1, allWaysMask_);
         }
+        wayMasks_[cos] = mask & allWaysMask_;
+        SetClassOfService(cos_);
+    }
+
+    // Select the requester whose way mask applies to subsequent fills
+    void SetClassOfService(UINT64 cos) {
+        cos_ = cos;
+        allocMask_ = cos < wayMasks_.size() ? wayMasks_[cos] : allWaysMask_;
+    }
+
+    // Class stamped on subsequently filled lines
+    void SetFillClass(UINT8 lineClass) { fillClass_ = lineClass; }
+
+    // Configure the retention policy, each mask has bit N set for class N
+    void SetRetentionPolicy(UINT64 lruInsertClasses, UINT64 pinnedClasses,
+                            UINT64 protectedClasses, UINT64 protectedWays) {
+        assert(numWays_ <= 64);
+        lruInsertClasses_ = lruInsertClasses;
+        pinnedClasses_ = pinnedClasses;
+        protectedClasses_ = protectedWays > 0 ? protectedClasses : 0;
+        protectedWays_ = protectedWays;
+        retentionActive_ = pinnedClasses_ != 0 || protectedClasses_ != 0;
     }
 
+    bool IsPartitioned() const { return !wayMasks_.empty(); }
+    UINT64 GetClassOfService() const { return cos_; }
+    const std::vector<UINT64>& GetWayMasks() const { return wayMasks_; }
+
     // Stats reporting methods
     UINT64 GetAccesses() const { return accesses_; }
     UINT64 GetHits() const { return hits_; }
@@ -146,7 +497,17 @@ class SetAssociativeCache {
         return accesses_ > 0 ? (double)hits_ / accesses_ : 0.0;
     }
     const std::string& GetName() const { return name_; }
+    UINT64 GetPrefetchFills(UINT8 source) const {
+        return prefetchFills_[source];
+    }
+    UINT64 GetUsefulPrefetches(UINT8 source) const {
+        return usefulPrefetches_[source];
+    }
+    UINT64 GetUselessPrefetches(UINT8 source) const {
+        return uselessPrefetches_[source];
+    }
     UINT64 GetSize() const { return numSets_ * numWays_; }
     UINT64 GetNumSets() const { return numSets_; }
     UINT64 GetNumWays() const { return numWays_; }
+    bool IsFullyAssociative() const { return fullyAssociative_; }
 };
\ No newline at end of file
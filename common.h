@@ -1,37 +1,167 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <iomanip>
 #include <iostream>
 #include <string>
+#include <vector>
 
 // Define types to match those in the original simulator
 typedef uint64_t ADDRINT;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
 typedef uint32_t UINT32;
 typedef uint64_t UINT64;
+typedef int64_t INT64;
 
 // Constants for page table
 constexpr UINT64 kPageShift = 12;  // log2(kMemTracePageSize)
 constexpr UINT64 kMemTracePageSize = 1ULL << kPageShift;  // 4KB page size
 constexpr UINT64 kPageMask =
     kMemTracePageSize - 1;  // Mask for offset within page
+// Accesses ahead of the current one whose sets the batch APIs prefetch
+constexpr UINT64 kBatchPrefetchDistance = 8;
 constexpr UINT64 kPhysicalMemorySize = 1ULL << 40;  // 1TB physical memory
+// ASIDs are folded into TLB/PWC tags above the 48-bit virtual address space
+constexpr UINT64 kAsidTagShift = 48;
+
+// Classes of cache lines, used by the page-table line retention policy
+enum CacheLineClass : UINT8 {
+    kDataLine = 0,            // Program data
+    kPageTableLine = 1,       // PMD/PTE entries referenced by page walks
+    kUpperPageTableLine = 2,  // PGD/PUD entries referenced by page walks
+};
+
+// Level that served a page walk reference
+enum WalkRefSource : UINT8 {
+    kWalkRefUncached = 0,  // Page tables not cacheable
+    kWalkRefPteCache = 1,  // Dedicated PTE cache
+    kWalkRefL2 = 2,
+    kWalkRefL3 = 3,
+    kWalkRefMemory = 4,
+};
+
+// Relationship between the contents of the L1 and L2 TLBs
+enum TlbInclusion {
+    kTlbNine,       // Fill both, no back-invalidation (non-inclusive)
+    kTlbInclusive,  // Fill both, L2 evictions invalidate the L1 copy
+    kTlbExclusive,  // Walks fill L1 only, L2 holds L1 victims
+};
+
+inline const char* TlbInclusionName(TlbInclusion inclusion) {
+    switch (inclusion) {
+        case kTlbInclusive:
+            return "inclusive";
+        case kTlbExclusive:
+            return "exclusive";
+        default:
+            return "nine";
+    }
+}
+
+// Physical placement of page-table pages
+enum PageTablePlacement {
+    kPtInterleaved,   // Next free frame, interleaved with data pages
+    kPtReserved,      // Contiguous region reserved for page tables
+    kPtColocated,     // Sibling tables share a block of adjacent frames
+    kPtSeparateNode,  // Separate pool at the top of memory (other node/tier)
+};
+
+inline const char* PageTablePlacementName(PageTablePlacement placement) {
+    switch (placement) {
+        case kPtReserved:
+            return "reserved";
+        case kPtColocated:
+            return "colocate";
+        case kPtSeparateNode:
+            return "node";
+        default:
+            return "interleaved";
+    }
+}
+
+// Host page backing of large simulator structures (see huge_page.h)
+enum HugePagePolicy {
+    kHugePagesOff,      // Regular pages, THP explicitly declined
+    kHugePagesThp,      // Transparent huge pages via madvise(MADV_HUGEPAGE)
+    kHugePagesHugetlb,  // Reserved hugetlb pages, THP if the pool is empty
+};
+
+inline const char* HugePagePolicyName(HugePagePolicy policy) {
+    switch (policy) {
+        case kHugePagesOff:
+            return "off";
+        case kHugePagesHugetlb:
+            return "hugetlb";
+        default:
+            return "thp";
+    }
+}
+
+// Origin of a cache fill, used for prefetch accuracy accounting
+enum PrefetchSource : UINT8 {
+    kDemandFill = 0,        // Regular demand miss fill
+    kWalkPrefetch = 1,      // Target line prefetched at page walk completion
+    kSoftwarePrefetch = 2,  // PREFETCH* instruction in the trace
+    kNumPrefetchSources,
+};
 
 // Memory reference structure - matches the format in the trace file
+// Access kinds tagged by the Pin tool in MEMREF::flags
+enum MemRefFlag : UINT16 {
+    kMemRefNonTemporal = 1 << 0,  // MOVNT* (stores bypass the caches)
+    kMemRefFlush = 1 << 1,        // CLFLUSH/CLFLUSHOPT: write back, evict
+    kMemRefCleanLine = 1 << 2,    // CLWB: write back, keep the line
+    kMemRefPrefetch = 1 << 3,     // Software prefetch
+    kMemRefAtomic = 1 << 4,       // Locked read-modify-write
+    kMemRefIfetch = 1 << 5,       // Instruction fetch (simulated as a read)
+    kMemRefStack = 1 << 6,        // Stack push/pop or stack-pointer relative
+    // Software prefetch hints; kMemRefPrefetch alone is PREFETCHT0/W
+    kMemRefPrefetchL2 = 1 << 7,   // PREFETCHT1/T2: fill L2 and L3, not L1
+    kMemRefPrefetchNta = 1 << 8,  // PREFETCHNTA: fill L1 only
+};
+
 struct MEMREF {
-    ADDRINT pc;   // Program counter (8 bytes)
-    ADDRINT ea;   // Effective address (8 bytes)
-    UINT32 size;  // Size of memory access (4 bytes)
-    UINT32 read;  // Is this a read (1) or write (0) (4 bytes)
+    ADDRINT pc;    // Program counter (8 bytes)
+    ADDRINT ea;    // Effective address (8 bytes)
+    UINT32 size;   // Size of memory access (4 bytes)
+    UINT16 read;   // Is this a read (1) or write (0) (2 bytes)
+    UINT16 flags;  // MemRefFlag bits (2 bytes); the high half of the
+                   // former 32-bit read word, so older traces read as 0
 };
 // Ensure the struct has no padding
 static_assert(sizeof(MEMREF) == 24, "MEMREF struct has unexpected padding");
 
+// Per-access context carried by extended (version 2) traces next to each
+// MEMREF; all zero for version 1 traces
+struct MemRefContext {
+    UINT32 tid;           // Thread that made the access
+    UINT32 instructions;  // Instructions the thread retired since its
+                          // previous access
+};
+
 // make a constexpr version of log2
 constexpr UINT64 StaticLog2(UINT64 n) {
     return (n == 0) ? 0 : (31 - __builtin_clz(n));
 }
 
+// One stage of the trace filter pipeline (applied in order, see trace_filter.h)
+struct TraceFilterStage {
+    enum Kind {
+        kReadsOnly,   // Keep only reads
+        kWritesOnly,  // Keep only writes
+        kPcRange,     // Keep accesses with lo <= pc < hi
+        kEaRange,     // Keep accesses with lo <= ea < hi
+        kRebase,      // Rewrite ea as ea - lo + hi
+        kScale,       // Rewrite ea as ea * lo
+        kThread,      // Keep accesses of thread lo (version 2 traces)
+    };
+    Kind kind;
+    UINT64 lo = 0;
+    UINT64 hi = 0;
+};
+
 struct SimConfig {
     UINT64 physMemGb = 30;
     struct {
@@ -39,6 +169,9 @@ struct SimConfig {
         UINT64 l1Ways = 4;
         UINT64 l2Size = 1024;
         UINT64 l2Ways = 8;
+        TlbInclusion inclusion = kTlbNine;  // L1/L2 TLB relationship
+        UINT64 victimSize = 0;    // Fully-associative victim TLB (0 = none)
+        bool l2Bypass = false;    // PC-based dead-entry bypass of L2 TLB
     } tlb;
     struct {
         UINT64 pgdSize = 4;
@@ -68,24 +201,113 @@ struct SimConfig {
         bool pteCachable = false;
         bool tocEnabled = false;
         UINT64 tocSize = 0;  // Size of the table of contents (TOC) in bytes
+        PageTablePlacement placement = kPtInterleaved;
+        UINT64 regionMb = 64;       // Reserved page-table region size
+        UINT64 colocateFrames = 8;  // Frames per sibling-table block
     } pgtbl;
 
+    struct {
+        bool insertLru = false;     // Insert page-table lines at LRU position
+        UINT64 protectedWays = 0;   // Page-table lines per set kept from data
+        bool pinUpper = false;      // Never evict PGD/PUD lines
+        UINT64 cacheSize = 0;       // Dedicated PTE cache in bytes (0 = none)
+        UINT64 cacheWays = 4;       // Dedicated PTE cache associativity
+    } pteLines;
+
+    struct {
+        bool walkEnabled = false;  // Prefetch target line(s) after page walks
+        UINT64 walkLevel = 2;      // Fill into L2 (and L3) or only L3
+        UINT64 walkLines = 1;      // Lines prefetched from the target address
+    } prefetch;
+
+    struct {
+        // Way masks per class of service (COS); tenant N uses COS N
+        std::vector<UINT64> l2Masks;     // L2 cache (empty = unpartitioned)
+        std::vector<UINT64> l3Masks;     // L3 cache (empty = unpartitioned)
+        std::vector<UINT64> l2TlbMasks;  // L2 TLB, per ASID
+        int walkCos = -1;  // COS of page walk references (-1 = requester's)
+        bool l3Ucp = false;           // Utility-based partitioning of L3
+        UINT64 ucpInterval = 1000000;  // L3 accesses between repartitions
+        UINT64 ucpSampleStride = 32;   // UMON samples every Nth set
+    } partition;
+
+    std::vector<TraceFilterStage> filters;  // Trace filter pipeline
+
     std::string traceFile;  // Path to the trace file
+    std::vector<std::string> traceFiles;  // All traces, one per tenant/ASID
+    struct {
+        UINT64 quantum = 10000;       // Accesses per tenant per slice
+        std::vector<UINT64> weights;  // Slices per round (empty = round-robin)
+    } sched;
     UINT64 batchSize =
         4096;  // Number of MEMREF entries to process in each batch
+    HugePagePolicy hugePages = kHugePagesThp;  // Simulator structure backing
+    std::string eventLog;  // Translation event log path (empty = off)
+
+    // Range-limited (region base + offset) tags, 0 regions = full tags
+    struct {
+        UINT64 tlbRegions = 0;
+        UINT64 tlbOffsetBits = 16;  // VPN bits kept per TLB entry
+        UINT64 pwcRegions = 0;
+        UINT64 pwcOffsetBits = 9;  // VA tag bits kept per PWC entry
+    } tagRegions;
+
+    // Store handling: per cache level (L1, L2, L3) write-through and
+    // write-allocate, the store buffer, and TLB dirty-bit updates
+    struct {
+        bool writeThrough[3] = {false, false, false};
+        bool writeAllocate[3] = {true, true, true};
+        UINT64 storeBuffer = 0;  // Entries, 0 = stores on the critical path
+        bool tlbDirty = false;   // First write to a page updates its PTE
+    } writes;
+
+    // Configurations simulated in lockstep with this one, each given as
+    // options applied on top of it
+    struct {
+        std::vector<std::string> variants;
+        UINT64 interval = 1000000;  // Accesses per comparison interval
+        bool intervalInstructions = false;  // interval counts instructions
+        UINT64 topPcs = 10;         // PCs listed in the per-PC deltas
+    } compare;
 
     UINT64 PhysicalMemBytes() const { return physMemGb * (1ULL << 30); }
 
+    // Classes of service UCP divides the L3 among: one per tenant, way
+    // mask and the walk COS
+    UINT64 UcpClassesOfService() const {
+        return std::max<UINT64>({traceFiles.size(), partition.l3Masks.size(),
+                                 (UINT64)(partition.walkCos + 1)});
+    }
+
     void Print(std::ostream& os = std::cout) const {
         os << "Simulation Configuration:\n"
            << "==============================\n"
-           << "Trace File:          " << traceFile << "\n"
-           << "Batch Size:          " << batchSize << " entries\n"
+           << "Trace File:          " << traceFile << "\n";
+        if (traceFiles.size() > 1) {
+            os << "Co-located Traces:   " << traceFiles.size() << " ("
+               << (sched.weights.empty() ? "round-robin" : "proportional")
+               << ", quantum " << sched.quantum << " accesses)\n";
+            for (size_t i = 0; i < traceFiles.size(); ++i) {
+                os << "  ASID " << i << ":           " << traceFiles[i];
+                if (!sched.weights.empty()) {
+                    os << " (weight " << sched.weights[i] << ")";
+                }
+                os << "\n";
+            }
+        }
+        os << "Batch Size:          " << batchSize << " entries\n"
            << "Physical Memory:     " << physMemGb << " GB\n"
+           << "Host Huge Pages:     " << HugePagePolicyName(hugePages) << "\n"
+           << "Event Log:           " << (eventLog.empty() ? "off" : eventLog)
+           << "\n"
            << "L1 TLB:             " << tlb.l1Size << " entries, " << tlb.l1Ways
            << "-way\n"
            << "L2 TLB:             " << tlb.l2Size << " entries, " << tlb.l2Ways
            << "-way\n"
+           << "TLB Inclusion:      " << TlbInclusionName(tlb.inclusion) << "\n"
+           << "Victim TLB:         " << tlb.victimSize << " entries\n"
+           << "L2 TLB Bypass:      " << (tlb.l2Bypass ? "true" : "false")
+           << "\n"
            << "Page Walk Cache (PGD): " << pwc.pgdSize << " entries, "
            << pwc.pgdWays << "-way\n"
            << "Page Walk Cache (PUD): " << pwc.pudSize << " entries, "
@@ -106,13 +328,55 @@ struct SimConfig {
            << "PTE Size:           " << pgtbl.pteSize << " entries\n"
            << "TOC Enabled:        " << (pgtbl.tocEnabled ? "true" : "false")
            << "\n"
-           << "TOC Size:          " << pgtbl.tocSize << "\n";
+           << "TOC Size:          " << pgtbl.tocSize << "\n"
+           << "Table Placement:    " << PageTablePlacementName(pgtbl.placement);
+        if (pgtbl.placement == kPtReserved) {
+            os << " (" << pgtbl.regionMb << "MB region)";
+        } else if (pgtbl.placement == kPtColocated) {
+            os << " (" << pgtbl.colocateFrames << " frames per block)";
+        }
+        os << "\n"
+           << "PTE Line Insertion: " << (pteLines.insertLru ? "LRU" : "MRU")
+           << "\n"
+           << "PTE Protected Ways: " << pteLines.protectedWays << "\n"
+           << "Pin PGD/PUD Lines:  " << (pteLines.pinUpper ? "true" : "false")
+           << "\n"
+           << "PTE Cache:          " << pteLines.cacheSize / 1024 << "KB, "
+           << pteLines.cacheWays << "-way\n"
+           << "Walk Prefetch:      "
+           << (prefetch.walkEnabled ? "true" : "false") << " (L"
+           << prefetch.walkLevel << ", " << prefetch.walkLines << " line(s))\n"
+           << "L2 Way Masks:       " << partition.l2Masks.size() << " COS\n"
+           << "L3 Way Masks:       " << partition.l3Masks.size() << " COS"
+           << (partition.l3Ucp ? " (UCP)" : "") << "\n"
+           << "L2 TLB Way Masks:   " << partition.l2TlbMasks.size() << " ASID\n"
+           << "Walk COS:           " << partition.walkCos << "\n"
+           << "Tag Regions:        TLB " << tagRegions.tlbRegions << " x "
+           << tagRegions.tlbOffsetBits << "b, PWC " << tagRegions.pwcRegions
+           << " x " << tagRegions.pwcOffsetBits << "b\n"
+           << "Write Policy:      ";
+        for (int level = 0; level < 3; ++level) {
+            os << " L" << level + 1 << " "
+               << (writes.writeThrough[level] ? "wt" : "wb") << "/"
+               << (writes.writeAllocate[level] ? "wa" : "nwa")
+               << (level < 2 ? "," : "");
+        }
+        os << "\n"
+           << "Store Buffer:       " << writes.storeBuffer << " entries\n"
+           << "TLB Dirty Bits:     " << (writes.tlbDirty ? "true" : "false")
+           << "\n"
+           << "Trace Filters:      " << filters.size() << " stage(s)\n";
+        for (size_t i = 0; i < compare.variants.size(); ++i) {
+            os << "Variant " << i + 1 << ":          " << compare.variants[i]
+               << "\n";
+        }
     }
 };
 
 // Stats for translation paths
 struct TranslationStats {
     UINT64 l1TlbHits = 0;           // Translations satisfied by L1 TLB
+    UINT64 victimTlbHits = 0;       // Translations satisfied by victim TLB
     UINT64 l2TlbHits = 0;           // Translations satisfied by L2 TLB
     UINT64 pmdCacheHits = 0;        // Translations requiring PMD PWC
     UINT64 pudCacheHits = 0;        // Translations requiring PUD PWC
@@ -126,14 +390,20 @@ struct TranslationStats {
     UINT64 l2DataCacheHits = 0;    // Hits in data cache during walk
     UINT64 l3DataCacheAccess = 0;  // Data cache accesses during walk
     UINT64 l3DataCacheHits = 0;    // Hits in data cache during walk
+    UINT64 pteCacheAccess = 0;     // Dedicated PTE cache accesses during walk
+    UINT64 pteCacheHits = 0;       // Hits in dedicated PTE cache during walk
+    UINT64 dirtyBitUpdates = 0;    // PTE writes setting the dirty bit
+    UINT64 droppedPrefetches = 0;  // Software prefetches to unmapped pages
 
     TranslationStats() = default;
 
     UINT64 GetTotalTranslation() const {
-        return l1TlbHits + l2TlbHits + pmdCacheHits + pudCacheHits +
-               pgdCacheHits + fullWalks;
+        return l1TlbHits + victimTlbHits + l2TlbHits + pmdCacheHits +
+               pudCacheHits + pgdCacheHits + fullWalks;
     }
 
+    UINT64 GetTlbHits() const { return l1TlbHits + victimTlbHits + l2TlbHits; }
+
     void PrintTranslationStats(std::ostream& os) const {
         UINT64 totalTranslations = this->GetTotalTranslation();
         os << "\nTranslation Path Statistics:" << '\n';
@@ -150,6 +420,14 @@ struct TranslationStats {
                    : 0.0)
            << "%" << '\n';
 
+        if (this->victimTlbHits > 0) {
+            os << std::left << std::setw(30) << "Victim TLB Hit" << std::right
+               << std::setw(15) << this->victimTlbHits << std::setw(15)
+               << std::fixed << std::setprecision(2)
+               << (double)this->victimTlbHits / totalTranslations * 100.0
+               << "%" << '\n';
+        }
+
         os << std::left << std::setw(30) << "L2 TLB Hit" << std::right
            << std::setw(15) << this->l2TlbHits << std::setw(15) << std::fixed
            << std::setprecision(2)
@@ -194,9 +472,22 @@ struct TranslationStats {
            << std::setw(15) << totalTranslations << std::setw(15) << "100.00%"
            << '\n';
 
+        if (this->dirtyBitUpdates > 0) {
+            os << std::left << std::setw(30) << "Dirty Bit Updates"
+               << std::right << std::setw(15) << this->dirtyBitUpdates
+               << std::setw(15) << std::fixed << std::setprecision(2)
+               << (double)this->dirtyBitUpdates / totalTranslations * 100.0
+               << "%" << '\n';
+        }
+        if (this->droppedPrefetches > 0) {
+            os << std::left << std::setw(30) << "Dropped Prefetches"
+               << std::right << std::setw(15) << this->droppedPrefetches
+               << '\n';
+        }
+
         // Calculate TLB efficiency
-        double tlbEfficiency = (double)(this->l1TlbHits + this->l2TlbHits) /
-                               totalTranslations * 100.0;
+        double tlbEfficiency =
+            (double)this->GetTlbHits() / totalTranslations * 100.0;
         os << "\nTLB Efficiency: " << std::fixed << std::setprecision(2)
            << tlbEfficiency << "% (translations resolved by L1 or L2 TLB)"
            << '\n';
@@ -217,6 +508,18 @@ struct TranslationStats {
                                            totalTranslations * 100.0
                                      : 0.0)
            << "%" << '\n';
+        if (this->pteCacheAccess > 0) {
+            os << std::left << std::setw(30) << "PTE Cache Access"
+               << std::right << std::setw(15) << this->pteCacheAccess
+               << std::setw(15) << std::fixed << std::setprecision(2)
+               << (double)this->pteCacheAccess / totalTranslations * 100.0
+               << "%" << '\n';
+            os << std::left << std::setw(30) << "PTE Cache Hits" << std::right
+               << std::setw(15) << this->pteCacheHits << std::setw(15)
+               << std::fixed << std::setprecision(2)
+               << (double)this->pteCacheHits / totalTranslations * 100.0
+               << "%" << '\n';
+        }
         os << std::left << std::setw(30) << "L2 Data Cache Access" << std::right
            << std::setw(15) << this->l2DataCacheAccess << std::setw(15)
            << std::fixed << std::setprecision(2)
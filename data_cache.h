@@ -3,10 +3,14 @@
 
 #include <cassert>
 #include <cstdint>
+#include <deque>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <vector>
 #include "cache.h"
 #include "common.h"
+#include "partition.h"
 
 class DataCache : public SetAssociativeCache<UINT64, UINT64> {
    private:
@@ -24,6 +28,9 @@ class DataCache : public SetAssociativeCache<UINT64, UINT64> {
         nextLevel_;  // pointer to next level cache (L2 or L3), or nullptr if last level
     UINT64*
         memAccessCounter_;  // pointer to memory access counter (for last level)
+    std::unique_ptr<UcpController> ucp_;  // utility-based partitioning, if on
+    std::vector<UINT64> cosAccesses_;     // per-COS accesses (when partitioned)
+    std::vector<UINT64> cosHits_;         // per-COS hits (when partitioned)
 
    protected:
     UINT64 GetSetIndex(const UINT64& tag) const override {
@@ -41,7 +48,10 @@ class DataCache : public SetAssociativeCache<UINT64, UINT64> {
                 UINT64 nextLevelTag =
                     tag << offsetBits_ >> nextLevel_->GetOffsetBits();
                 // we don't want to Lookup here, it doesn't matter and it is not in critical path
-                nextLevel_->Insert(tag, parseValue, /*isWrite*/ true);
+                // The line keeps its class, whatever the next level is
+                // currently filling (a walk may be in progress)
+                nextLevel_->InsertAs(tag, parseValue, /*isWrite*/ true,
+                                     evictClass_);
             } else {
                 // No next level (this is L3) – write back to main memory
                 if (memAccessCounter_) {
@@ -83,6 +93,18 @@ class DataCache : public SetAssociativeCache<UINT64, UINT64> {
             }
         }
 
+        if (IsPartitioned()) {
+            if (cosAccesses_.size() <= cos_) {
+                cosAccesses_.resize(cos_ + 1, 0);
+                cosHits_.resize(cos_ + 1, 0);
+            }
+            cosAccesses_[cos_]++;
+            cosHits_[cos_] += hit;
+            if (ucp_ && ucp_->Observe(cos_, GetSetIndex(tag), tag)) {
+                ApplyWayMasks(ucp_->GetWayMasks());
+            }
+        }
+
         if (!hit) {
             if (globalLruCounter_ < numSets_ * numWays_)
                 coldMisses_++;
@@ -94,6 +116,20 @@ class DataCache : public SetAssociativeCache<UINT64, UINT64> {
         return hit;
     }
 
+    void ApplyWayMasks(const std::vector<UINT64>& masks) {
+        for (UINT64 cos = 0; cos < masks.size(); ++cos) {
+            SetWayMask(cos, masks[cos]);
+        }
+    }
+
+    // Let UCP divide the ways among numCos requesters, starting evenly
+    void EnableUcp(UINT64 numCos, UINT64 interval, UINT64 sampleStride) {
+        assert(numCos > 0 && numCos <= numWays_);
+        ucp_ = std::make_unique<UcpController>(numCos, numSets_, numWays_,
+                                               interval, sampleStride);
+        ApplyWayMasks(ucp_->GetWayMasks());
+    }
+
     // New statistics methods
     uint64_t GetAllMisses() const {
         return coldMisses_ + capacityMisses_ + conflictMisses_;
@@ -128,6 +164,25 @@ class DataCache : public SetAssociativeCache<UINT64, UINT64> {
         // In DataCache::printDetailedStats (adding writeback count):
         os << std::left << std::setw(25) << "Writebacks" << std::right
            << std::setw(15) << writebacks_ << "\n";
+        if (IsPartitioned()) {
+            PrintPartitionStats(os);
+        }
+    }
+
+    void PrintPartitionStats(std::ostream& os) const {
+        os << "Way Partitioning" << (ucp_ ? " (UCP)" : " (static)") << ":\n";
+        for (UINT64 cos = 0; cos < wayMasks_.size(); ++cos) {
+            UINT64 accesses = cos < cosAccesses_.size() ? cosAccesses_[cos] : 0;
+            UINT64 hits = cos < cosHits_.size() ? cosHits_[cos] : 0;
+            os << "  COS " << cos << ": mask 0x" << std::hex << wayMasks_[cos]
+               << std::dec << " (" << __builtin_popcountll(wayMasks_[cos])
+               << " ways), accesses " << accesses << ", hit rate "
+               << std::fixed << std::setprecision(2)
+               << (accesses ? (double)hits / accesses * 100.0 : 0.0) << "%\n";
+        }
+        if (ucp_) {
+            os << "  UCP repartitions: " << ucp_->GetRepartitions() << "\n";
+        }
     }
 };
 
@@ -136,6 +191,68 @@ class CacheHierarchy {
     DataCache l1Cache_;
     DataCache l2Cache_;
     DataCache l3Cache_;
+    std::unique_ptr<DataCache> pteCache_;  // dedicated page-table line cache
+    UINT8 activeLineClass_;  // line class currently stamped on L2/L3 fills
+
+    // Classes of service used for data and page walk references
+    UINT64 activeCos_;  // COS currently programmed into the caches
+    UINT64 dataCos_;    // COS of the current requester's data accesses
+    UINT64 walkCos_;    // COS of page walk references
+    bool separateWalkCos_;
+
+    void SelectLineClass(UINT8 lineClass) {
+        if (lineClass != activeLineClass_) {
+            l2Cache_.SetFillClass(lineClass);
+            l3Cache_.SetFillClass(lineClass);
+            activeLineClass_ = lineClass;
+        }
+    }
+
+    void SelectCos(UINT64 cos) {
+        if (cos != activeCos_) {
+            l1Cache_.SetClassOfService(cos);
+            l2Cache_.SetClassOfService(cos);
+            l3Cache_.SetClassOfService(cos);
+            activeCos_ = cos;
+        }
+    }
+
+    // Prefetch traffic, kept apart from memAccessCount so demand accounting
+    // stays consistent with the L3 miss count
+    UINT64 prefetchRequests_;     // Lines requested by prefetchers
+    UINT64 redundantPrefetches_;  // Requests already present at the target
+    UINT64 prefetchMemAccesses_;  // Memory reads issued by prefetches
+    UINT64 softwarePrefetches_;   // PREFETCH* instructions simulated
+    UINT64 hiddenPrefetchCycles_;  // Software prefetch walks, non-blocking
+    UINT8 lastWalkRefSource_;     // WalkRefSource of the last TranslateLookup
+
+    // Per-level store policies (index 0 = L1); writes only take
+    // AccessWrite when some level differs from write-back/write-allocate
+    bool writeThrough_[3];
+    bool writeAllocate_[3];
+    bool writePolicy_;
+    UINT64 memWrites_;         // Writes passed from L3 to memory
+    UINT64 unmatchedMemWrites_;  // Memory writes besides L3 write-backs
+
+    // Cache-control accesses (MemRefFlag): non-temporal stores bypass the
+    // caches and combine per line in a write-combining buffer
+    UINT64 ntStoreLine_;     // Line in the write-combining buffer, ~0 if none
+    UINT64 ntStores_;
+    UINT64 ntLineWrites_;    // Write-combining buffer flushes to memory
+    UINT64 lineFlushes_;     // CLFLUSH/CLFLUSHOPT
+    UINT64 lineCleans_;      // CLWB
+    UINT64 flushWritebacks_;  // Dirty lines written by the above
+
+    // Store buffer: a store costs one issue cycle, and the rest of its
+    // latency drains behind later accesses unless storeBufferEntries_
+    // stores are already outstanding
+    UINT64 storeBufferEntries_;        // 0 = stores on the critical path
+    std::deque<UINT64> storeDone_;     // Completion cycle, oldest first
+    UINT64 lastStoreDone_;
+    UINT64 stores_;
+    UINT64 storeBufferStalls_;         // Stores that found the buffer full
+    UINT64 storeStallCycles_;
+    UINT64 hiddenStoreCycles_;         // Store latency off the critical path
 
    public:
     UINT64 memAccessCount;
@@ -147,6 +264,34 @@ class CacheHierarchy {
         : l1Cache_("L1 Cache", l1Size, l1Ways, l1Line),
           l2Cache_("L2 Cache", l2Size, l2Ways, l2Line),
           l3Cache_("L3 Cache", l3Size, l3Ways, l3Line),
+          activeLineClass_(kDataLine),
+          activeCos_(0),
+          dataCos_(0),
+          walkCos_(0),
+          separateWalkCos_(false),
+          prefetchRequests_(0),
+          redundantPrefetches_(0),
+          prefetchMemAccesses_(0),
+          softwarePrefetches_(0),
+          hiddenPrefetchCycles_(0),
+          lastWalkRefSource_(kWalkRefUncached),
+          writeThrough_{false, false, false},
+          writeAllocate_{true, true, true},
+          writePolicy_(false),
+          memWrites_(0),
+          unmatchedMemWrites_(0),
+          ntStoreLine_(~0ULL),
+          ntStores_(0),
+          ntLineWrites_(0),
+          lineFlushes_(0),
+          lineCleans_(0),
+          flushWritebacks_(0),
+          storeBufferEntries_(0),
+          lastStoreDone_(0),
+          stores_(0),
+          storeBufferStalls_(0),
+          storeStallCycles_(0),
+          hiddenStoreCycles_(0),
           memAccessCount(0) {
         // Set up cache hierarchy
         l1Cache_.SetNextLevel(&l2Cache_);
@@ -157,14 +302,159 @@ class CacheHierarchy {
         l3Cache_.SetMemCounter(&memAccessCount);  // L3 writes to memory
     }
 
+    // Treatment of page-table lines in L2/L3: insertion at LRU, up to
+    // protectedWays page-table lines per set kept from data fills, and
+    // pinning of PGD/PUD lines
+    void SetPageTableLinePolicy(bool insertLru, UINT64 protectedWays,
+                                bool pinUpper) {
+        const UINT64 tableClasses =
+            1ULL << kPageTableLine | 1ULL << kUpperPageTableLine;
+        UINT64 lruInsert = insertLru ? tableClasses : 0;
+        UINT64 pinned = pinUpper ? 1ULL << kUpperPageTableLine : 0;
+        l2Cache_.SetRetentionPolicy(lruInsert, pinned, tableClasses,
+                                    protectedWays);
+        l3Cache_.SetRetentionPolicy(lruInsert, pinned, tableClasses,
+                                    protectedWays);
+    }
+
+    // Small cache looked up by page walks before L2, holding only
+    // page-table lines
+    void EnablePteCache(UINT64 size, UINT64 ways, UINT64 line) {
+        pteCache_ = std::make_unique<DataCache>("PTE Cache", size, ways, line);
+        pteCache_->SetNextLevel(nullptr);
+        pteCache_->SetMemCounter(nullptr);
+    }
+
+    // Prefetch the lines starting at paddr (clipped to its page) into L2 and
+    // L3 (level 2) or only L3 (level 3), without demand stats side effects
+    void PrefetchLines(ADDRINT paddr, UINT64 lines, UINT64 level,
+                       UINT8 source) {
+        SelectCos(dataCos_);
+        SelectLineClass(kDataLine);
+        UINT64 lineSize = 1ULL << l2Cache_.GetOffsetBits();
+        ADDRINT lineAddr = paddr & ~(lineSize - 1);
+        ADDRINT pageEnd = (paddr & ~kPageMask) + kMemTracePageSize;
+        for (UINT64 i = 0; i < lines && lineAddr < pageEnd;
+             ++i, lineAddr += lineSize) {
+            prefetchRequests_++;
+            UINT64 value = 0;
+            UINT64 l3CacheTag = lineAddr >> l3Cache_.GetOffsetBits();
+            bool filled = false;
+            if (!l3Cache_.Contains(l3CacheTag)) {
+                prefetchMemAccesses_++;
+                filled = l3Cache_.PrefetchInsert(l3CacheTag, value, source);
+            }
+            if (level == 2) {
+                UINT64 l2CacheTag = lineAddr >> l2Cache_.GetOffsetBits();
+                filled |= l2Cache_.PrefetchInsert(l2CacheTag, value, source);
+            }
+            if (!filled) {
+                redundantPrefetches_++;
+            }
+        }
+    }
+
+    // Software prefetch of paddr's line (MemRefFlag hints): T0 fills L1
+    // and below, T1/T2 L2 and L3, NTA only L1. It does not block the core,
+    // so like the walk prefetch it stays out of demand stats and cycles;
+    // fills are tagged at the hinted level only, where its accuracy is
+    // measured.
+    void SoftwarePrefetch(ADDRINT paddr, UINT16 flags) {
+        SelectCos(dataCos_);
+        SelectLineClass(kDataLine);
+        DataCache* levels[3] = {&l1Cache_, &l2Cache_, &l3Cache_};
+        int target = (flags & kMemRefPrefetchL2) ? 1 : 0;
+        int lowest = (flags & kMemRefPrefetchNta) ? target : 2;
+        prefetchRequests_++;
+        softwarePrefetches_++;
+        bool cached = false;
+        for (DataCache* cache : levels) {
+            cached |= cache->Contains(paddr >> cache->GetOffsetBits());
+        }
+        if (!cached) {
+            prefetchMemAccesses_++;
+        }
+        UINT64 value = 0;
+        bool filled = false;
+        for (int level = lowest; level >= target; --level) {
+            DataCache& cache = *levels[level];
+            UINT64 tag = paddr >> cache.GetOffsetBits();
+            if (level == target) {
+                filled = cache.PrefetchInsert(tag, value, kSoftwarePrefetch);
+            } else if (!cache.Contains(tag)) {
+                cache.Insert(tag, value, false);
+            }
+        }
+        if (!filled) {
+            redundantPrefetches_++;
+        }
+    }
+
+    // Take cycles spent for a non-blocking access off the critical path
+    void HidePrefetchCycles(UINT64 cycles) { hiddenPrefetchCycles_ += cycles; }
+
+    // Write-through and write-allocate for each level (index 0 = L1)
+    void SetWritePolicy(const bool writeThrough[3],
+                        const bool writeAllocate[3]) {
+        writePolicy_ = false;
+        for (int level = 0; level < 3; ++level) {
+            writeThrough_[level] = writeThrough[level];
+            writeAllocate_[level] = writeAllocate[level];
+            writePolicy_ |= writeThrough[level] || !writeAllocate[level];
+        }
+    }
+
+    // Take stores off the critical path through a buffer of entries stores
+    void EnableStoreBuffer(UINT64 entries) { storeBufferEntries_ = entries; }
+
+    // Way masks per class of service for L2 (level 2) or L3 (level 3)
+    void SetWayMasks(int level, const std::vector<UINT64>& masks) {
+        DataCache& cache = level == 2 ? l2Cache_ : l3Cache_;
+        cache.ApplyWayMasks(masks);
+    }
+
+    // Utility-based partitioning of the L3 among numCos requesters
+    void EnableL3Ucp(UINT64 numCos, UINT64 interval, UINT64 sampleStride) {
+        l3Cache_.EnableUcp(numCos, interval, sampleStride);
+    }
+
+    // Give page walk references their own class of service
+    void SetWalkCos(UINT64 cos) {
+        walkCos_ = cos;
+        separateWalkCos_ = true;
+    }
+
+    // Select the requester (tenant) whose class of service data uses
+    void SetRequester(UINT64 cos) {
+        dataCos_ = cos;
+        if (!separateWalkCos_) {
+            walkCos_ = cos;
+        }
+    }
+
     // translation access start from L2, do not access L1
     bool TranslateLookup(ADDRINT paddr, UINT64& value,
-                         TranslationStats& translationStats) {
+                         TranslationStats& translationStats,
+                         UINT8 lineClass = kPageTableLine) {
+        SelectCos(walkCos_);
+        SelectLineClass(lineClass);
+        UINT64 pteCacheTag = 0;
+        if (pteCache_) {
+            pteCacheTag = paddr >> pteCache_->GetOffsetBits();
+            translationStats.pteCacheAccess++;
+            if (pteCache_->Lookup(pteCacheTag, value)) {
+                translationStats.pteCacheHits++;
+                lastWalkRefSource_ = kWalkRefPteCache;
+                return true;
+            }
+            pteCache_->Insert(pteCacheTag, value, false);
+        }
         UINT64 l2CacheTag = paddr >> l2Cache_.GetOffsetBits();
         // L2 access
         translationStats.l2DataCacheAccess++;
         if (l2Cache_.Lookup(l2CacheTag, value)) {
             translationStats.l2DataCacheHits++;
+            lastWalkRefSource_ = kWalkRefL2;
             return true;
         }
         UINT64 l3CacheTag = paddr >> l3Cache_.GetOffsetBits();
@@ -174,6 +464,7 @@ class CacheHierarchy {
             // On L3 hit, fill L2
             translationStats.l3DataCacheHits++;
             l2Cache_.Insert(l2CacheTag, value, false);
+            lastWalkRefSource_ = kWalkRefL3;
             return true;
         }
 
@@ -182,10 +473,41 @@ class CacheHierarchy {
         // Fill all levels with the new block (inclusive cache policy)
         l3Cache_.Insert(l3CacheTag, value, false);
         l2Cache_.Insert(l2CacheTag, value, false);
+        lastWalkRefSource_ = kWalkRefMemory;
         return false;
     }
 
-    bool Access(ADDRINT paddr, UINT64& value, bool isWrite) {
+    // Level that served the last TranslateLookup (a WalkRefSource)
+    UINT8 GetLastWalkRefSource() const { return lastWalkRefSource_; }
+
+    // Data access; flags are the access's MemRefFlag bits
+    bool Access(ADDRINT paddr, UINT64& value, bool isWrite, UINT16 flags = 0) {
+        // Flushes, non-temporal stores (write-combined) and prefetches do
+        // not take a store buffer entry; they may access no level at all
+        if (storeBufferEntries_ > 0 &&
+            !(flags & (kMemRefFlush | kMemRefCleanLine | kMemRefNonTemporal |
+                       kMemRefPrefetch))) {
+            return BufferedAccess(paddr, value, isWrite, flags);
+        }
+        return AccessLine(paddr, value, isWrite, flags);
+    }
+
+    bool AccessLine(ADDRINT paddr, UINT64& value, bool isWrite,
+                    UINT16 flags = 0) {
+        SelectCos(dataCos_);
+        SelectLineClass(kDataLine);
+        if (flags & kMemRefPrefetch) {
+            SoftwarePrefetch(paddr, flags);
+            return true;
+        }
+        // Non-temporal loads are ordinary loads on write-back memory
+        if ((flags & (kMemRefFlush | kMemRefCleanLine)) ||
+            (isWrite && (flags & kMemRefNonTemporal))) {
+            return AccessCacheControl(paddr, flags);
+        }
+        if (isWrite && writePolicy_) {
+            return AccessWrite(paddr, value);
+        }
         UINT64 l1CacheTag = paddr >> l1Cache_.GetOffsetBits();
         // L1 access
         if (l1Cache_.Lookup(l1CacheTag, value, isWrite)) {
@@ -225,7 +547,7 @@ class CacheHierarchy {
         // Miss in all caches: access main memory
         memAccessCount++;  // memory read for the new block
         assert(l3Cache_.GetAccesses() - l3Cache_.GetHits() +
-                   l3Cache_.GetWritebacks() ==
+                   l3Cache_.GetWritebacks() + unmatchedMemWrites_ ==
                memAccessCount);
         // Fill all levels with the new block (inclusive cache policy)
         l3Cache_.Insert(l3CacheTag, value, false);
@@ -235,21 +557,230 @@ class CacheHierarchy {
         return false;
     }
 
+    // Access a batch of translated addresses in order, prefetching the sets
+    // of the access kBatchPrefetchDistance ahead at every level
+    void AccessBatch(const ADDRINT* paddrs, const MEMREF* refs,
+                     UINT64 numRefs) {
+        for (UINT64 i = 0; i < numRefs; ++i) {
+            if (i + kBatchPrefetchDistance < numRefs) {
+                ADDRINT ahead = paddrs[i + kBatchPrefetchDistance];
+                l1Cache_.PrefetchSet(ahead >> l1Cache_.GetOffsetBits());
+                l2Cache_.PrefetchSet(ahead >> l2Cache_.GetOffsetBits());
+                l3Cache_.PrefetchSet(ahead >> l3Cache_.GetOffsetBits());
+            }
+            UINT64 value = 0;
+            Access(paddrs[i], value, !refs[i].read, refs[i].flags);
+        }
+    }
+
     void PrintStats(std::ostream& os) const {
         os << "\n=== Cache Hierarchy Statistics ===\n";
+        if (pteCache_) {
+            PrintCacheStats(os, *pteCache_);
+        }
         PrintCacheStats(os, l1Cache_);
         PrintCacheStats(os, l2Cache_);
         PrintCacheStats(os, l3Cache_);
         os << "Memory Accesses: " << memAccessCount << "\n";
-        os << "Total Access Cost (cycles): "
-           << l1Cache_.GetAccesses() * 1 +       // L1 access cycles
-                  l2Cache_.GetAccesses() * 4 +   // L2 access cycles
-                  l3Cache_.GetAccesses() * 10 +  // L3 access cycles
-                  memAccessCount * 100           // Memory access cycles
-           << "\n";
+        if (writePolicy_) {
+            os << "Memory Writes (write-through/no-allocate): " << memWrites_
+               << "\n";
+        }
+        if (prefetchRequests_ > 0) {
+            PrintPrefetchStats(os);
+        }
+        if (storeBufferEntries_ > 0) {
+            PrintStoreBufferStats(os);
+        }
+        if (ntStores_ + lineFlushes_ + lineCleans_ > 0) {
+            os << "Non-Temporal Stores: " << ntStores_ << " (" << ntLineWrites_
+               << " line writes)\n"
+               << "Line Flushes: " << lineFlushes_
+               << ", Line Write-Backs: " << lineCleans_ << " ("
+               << flushWritebacks_ << " dirty lines written)\n";
+        }
+        os << "Total Access Cost (cycles): " << GetTotalCycles() << "\n";
+    }
+
+    // Access cost with every access on the critical path
+    UINT64 GetAccessCycles() const {
+        return l1Cache_.GetAccesses() * 1 +   // L1 access cycles
+               l2Cache_.GetAccesses() * 4 +   // L2 access cycles
+               l3Cache_.GetAccesses() * 10 +  // L3 access cycles
+               memAccessCount * 100;          // Memory access cycles
+    }
+
+    // Access cost less the store latency the store buffer hides and the
+    // walks of software prefetches
+    UINT64 GetTotalCycles() const {
+        return GetAccessCycles() - hiddenStoreCycles_ -
+               hiddenPrefetchCycles_ + storeStallCycles_;
+    }
+
+    // Data cache of level 1, 2 or 3
+    const DataCache& GetCache(int level) const {
+        return level == 1 ? l1Cache_ : level == 2 ? l2Cache_ : l3Cache_;
     }
 
    private:
+    // Write under the per-level policies. A write-back level ends the write
+    // on the line it holds (dirty); a write-through level keeps its copy
+    // clean and passes the write down. A write-allocate miss first reads
+    // the line from below; a no-write-allocate miss passes the write down
+    // without filling. Returns whether a cache level held the line.
+    bool AccessWrite(ADDRINT paddr, UINT64& value) {
+        DataCache* levels[3] = {&l1Cache_, &l2Cache_, &l3Cache_};
+        bool cached = false;
+        for (int level = 0; level < 3; ++level) {
+            DataCache& cache = *levels[level];
+            UINT64 tag = paddr >> cache.GetOffsetBits();
+            bool hit = cache.Lookup(tag, value, true);
+            cached |= hit;
+            if (!hit && writeAllocate_[level]) {
+                cached |= FetchLine(paddr, level + 1, value);
+            }
+            if (hit || writeAllocate_[level]) {
+                cache.Insert(tag, value, !writeThrough_[level]);
+                if (!writeThrough_[level]) {
+                    return cached;
+                }
+                if (level == 2) {
+                    unmatchedMemWrites_++;  // L3 holds the line
+                }
+            }
+        }
+        memAccessCount++;
+        memWrites_++;
+        return cached;
+    }
+
+    // Non-temporal store or line flush/write-back: no level is filled.
+    // Dirty copies are written to memory; flushes and non-temporal stores
+    // also drop the line everywhere. Returns whether a level held it.
+    bool AccessCacheControl(ADDRINT paddr, UINT16 flags) {
+        DataCache* levels[3] = {&l1Cache_, &l2Cache_, &l3Cache_};
+        bool evict = !(flags & kMemRefCleanLine);
+        bool cached = false;
+        bool dirty = false;
+        for (DataCache* cache : levels) {
+            UINT64 tag = paddr >> cache->GetOffsetBits();
+            cached |= cache->Contains(tag);
+            dirty |= cache->Clean(tag);
+            if (evict) {
+                cache->Invalidate(tag);
+            }
+        }
+        if (dirty) {
+            flushWritebacks_++;
+            memAccessCount++;
+            unmatchedMemWrites_++;
+        }
+
+        if (flags & kMemRefFlush) {
+            lineFlushes_++;
+        } else if (flags & kMemRefCleanLine) {
+            lineCleans_++;
+        } else {
+            // Consecutive stores to one line leave in one memory write
+            ntStores_++;
+            UINT64 line = paddr >> l1Cache_.GetOffsetBits();
+            if (line != ntStoreLine_) {
+                ntStoreLine_ = line;
+                ntLineWrites_++;
+                memAccessCount++;
+                unmatchedMemWrites_++;
+            }
+        }
+        return cached;
+    }
+
+    // Read the line into the levels from fromLevel (0 = L1) down to the
+    // one holding it, or from memory; returns whether a cache held it
+    bool FetchLine(ADDRINT paddr, int fromLevel, UINT64& value) {
+        DataCache* levels[3] = {&l1Cache_, &l2Cache_, &l3Cache_};
+        int level = fromLevel;
+        while (level < 3 &&
+               !levels[level]->Lookup(paddr >> levels[level]->GetOffsetBits(),
+                                      value, false)) {
+            level++;
+        }
+        if (level == 3) {
+            memAccessCount++;
+        }
+        for (int fill = level - 1; fill >= fromLevel; --fill) {
+            levels[fill]->Insert(paddr >> levels[fill]->GetOffsetBits(), value,
+                                 false);
+        }
+        return level < 3;
+    }
+
+    // Access with stores going through the store buffer
+    bool BufferedAccess(ADDRINT paddr, UINT64& value, bool isWrite,
+                        UINT16 flags) {
+        UINT64 now = GetTotalCycles();
+        UINT64 start = GetAccessCycles();
+        bool hit = AccessLine(paddr, value, isWrite, flags);
+        if (!isWrite) {
+            return hit;
+        }
+        // At least the L1 lookup, so the issue cycle stays on the path
+        UINT64 latency = GetAccessCycles() - start;
+
+        // A full buffer stalls the store until its oldest entry drains
+        stores_++;
+        if (storeDone_.size() == storeBufferEntries_) {
+            UINT64 oldest = storeDone_.front();
+            storeDone_.pop_front();
+            if (oldest > now) {
+                storeBufferStalls_++;
+                storeStallCycles_ += oldest - now;
+                now = oldest;
+            }
+        }
+        // Stores drain one at a time, in order
+        lastStoreDone_ = std::max(now, lastStoreDone_) + latency;
+        storeDone_.push_back(lastStoreDone_);
+        hiddenStoreCycles_ += latency - 1;
+        return hit;
+    }
+
+    void PrintStoreBufferStats(std::ostream& os) const {
+        os << "\nStore Buffer (" << storeBufferEntries_ << " entries):\n"
+           << "Stores: " << stores_ << "\n"
+           << "Full-Buffer Stalls: " << storeBufferStalls_ << " ("
+           << storeStallCycles_ << " cycles)\n"
+           << "Store Cycles Hidden: " << hiddenStoreCycles_ << "\n"
+           << "Access Cost Without Store Buffer (cycles): "
+           << GetAccessCycles() << "\n";
+    }
+
+    void PrintPrefetchStats(std::ostream& os) const {
+        os << "\nPrefetch Statistics:\n";
+        os << "====================\n";
+        os << "Prefetch Requests: " << prefetchRequests_ << "\n"
+           << "Redundant Prefetches: " << redundantPrefetches_ << "\n"
+           << "Prefetch Memory Accesses: " << prefetchMemAccesses_ << "\n";
+        if (softwarePrefetches_ > 0) {
+            os << "Software Prefetches: " << softwarePrefetches_ << "\n";
+        }
+        const char* sourceNames[kNumPrefetchSources] = {"Demand", "Walk",
+                                                        "Software"};
+        for (UINT8 src = kDemandFill + 1; src < kNumPrefetchSources; ++src) {
+            for (const DataCache* cache : {&l1Cache_, &l2Cache_, &l3Cache_}) {
+                UINT64 fills = cache->GetPrefetchFills(src);
+                if (fills == 0) {
+                    continue;
+                }
+                UINT64 useful = cache->GetUsefulPrefetches(src);
+                os << "[" << cache->GetName() << "] " << sourceNames[src]
+                   << " prefetch fills: " << fills << ", useful: " << useful
+                   << ", useless: " << cache->GetUselessPrefetches(src)
+                   << ", accuracy: " << std::fixed << std::setprecision(2)
+                   << (double)useful / fills * 100.0 << "%\n";
+            }
+        }
+    }
+
     void PrintCacheStats(std::ostream& os, const DataCache& cache) const {
         os << "[" << cache.GetName() << "]\n"
            << "Size: " << cache.GetSize() / 1024 << "KB\n"
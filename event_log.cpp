@@ -0,0 +1,237 @@
+// event_log.cpp
+// Standalone tool for translation event logs written with --event_log:
+// dumps a log, or diffs two logs (two configurations, or two builds on the
+// same configuration) and reports where they first diverge.
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "event_log.h"
+
+using std::cerr;
+using std::cout;
+
+static const char* WalkRefSourceName(UINT8 source) {
+    switch (source) {
+        case kWalkRefUncached:
+            return "uncached";
+        case kWalkRefPteCache:
+            return "pte_cache";
+        case kWalkRefL2:
+            return "L2";
+        case kWalkRefL3:
+            return "L3";
+        case kWalkRefMemory:
+            return "memory";
+        default:
+            return "unknown";
+    }
+}
+
+// Sequential event access over EventLogReader batches. Also rebuilds the
+// full translation index from the 32-bit value stored per event.
+class EventCursor {
+   private:
+    static constexpr UINT64 kBatchEvents = 4096;
+
+    EventLogReader reader_;
+    std::vector<TranslationEvent> buffer_;
+    UINT64 pos_ = 0;
+    UINT64 count_ = 0;
+    UINT64 index_ = 0;           // Events returned so far
+    UINT64 translationBase_ = 0;  // High bits of the translation index
+    UINT32 lastTranslation_ = 0;
+    UINT64 typeCounts_[kNumEventTypes] = {};
+
+   public:
+    EventCursor() : buffer_(kBatchEvents) {}
+
+    bool Open(const std::string& path) { return reader_.Open(path); }
+
+    // Next event and its translation index, false at end of log
+    bool Next(TranslationEvent& event, UINT64& translation) {
+        if (pos_ == count_) {
+            count_ = reader_.ReadBatch(buffer_.data(), buffer_.size());
+            pos_ = 0;
+            if (count_ == 0) {
+                return false;
+            }
+        }
+        event = buffer_[pos_++];
+        if (event.translation < lastTranslation_) {
+            translationBase_ += 1ULL << 32;
+        }
+        lastTranslation_ = event.translation;
+        translation = translationBase_ | event.translation;
+        if (event.type < kNumEventTypes) {
+            typeCounts_[event.type]++;
+        }
+        index_++;
+        return true;
+    }
+
+    UINT64 GetIndex() const { return index_; }
+    const UINT64* GetTypeCounts() const { return typeCounts_; }
+};
+
+static std::string FormatEvent(const TranslationEvent& event,
+                               UINT64 translation) {
+    std::ostringstream os;
+    os << "translation " << translation << " asid " << (int)event.asid << ' '
+       << std::left << std::setw(12) << TranslationEventName(event.type)
+       << " level " << (int)event.level;
+    if (event.type == kEventWalkRef) {
+        os << " from " << std::setw(9) << WalkRefSourceName(event.hitLevel);
+    }
+    os << " 0x" << std::hex << event.addr;
+    return os.str();
+}
+
+static bool SameEvent(const TranslationEvent& a, const TranslationEvent& b) {
+    return std::memcmp(&a, &b, sizeof(TranslationEvent)) == 0;
+}
+
+static void PrintTypeCounts(std::ostream& os, const std::string& label,
+                            const UINT64* counts) {
+    os << label << ":";
+    for (UINT8 type = 0; type < kNumEventTypes; type++) {
+        os << ' ' << TranslationEventName(type) << '=' << counts[type];
+    }
+    os << '\n';
+}
+
+static int Dump(const std::string& path, UINT64 limit) {
+    EventCursor log;
+    if (!log.Open(path)) {
+        cerr << "Error: Not a readable event log: " << path << '\n';
+        return 1;
+    }
+    TranslationEvent event;
+    UINT64 translation;
+    while (log.Next(event, translation)) {
+        if (log.GetIndex() <= limit) {
+            cout << FormatEvent(event, translation) << '\n';
+        }
+    }
+    cout << log.GetIndex() << " events\n";
+    PrintTypeCounts(cout, path, log.GetTypeCounts());
+    return 0;
+}
+
+// Exit status follows diff: 0 identical, 1 diverging, 2 on errors
+static int Diff(const std::string& pathA, const std::string& pathB,
+                UINT64 context) {
+    EventCursor logA;
+    EventCursor logB;
+    if (!logA.Open(pathA)) {
+        cerr << "Error: Not a readable event log: " << pathA << '\n';
+        return 2;
+    }
+    if (!logB.Open(pathB)) {
+        cerr << "Error: Not a readable event log: " << pathB << '\n';
+        return 2;
+    }
+
+    // Common events before the divergence, most recent last
+    std::deque<std::string> history;
+    TranslationEvent eventA, eventB;
+    UINT64 translationA = 0, translationB = 0;
+    bool moreA, moreB;
+    while (true) {
+        moreA = logA.Next(eventA, translationA);
+        moreB = logB.Next(eventB, translationB);
+        if (!moreA || !moreB || !SameEvent(eventA, eventB)) {
+            break;
+        }
+        if (context > 0) {
+            if (history.size() == context) {
+                history.pop_front();
+            }
+            history.push_back(FormatEvent(eventA, translationA));
+        }
+    }
+
+    if (!moreA && !moreB) {
+        cout << "Logs are identical (" << logA.GetIndex() << " events)\n";
+        return 0;
+    }
+
+    UINT64 common = logA.GetIndex() - (moreA ? 1 : 0);
+    cout << "Logs diverge after " << common << " common events";
+    if (moreA && moreB) {
+        cout << ", at translation " << std::min(translationA, translationB);
+    } else {
+        cout << ", " << (moreA ? pathB : pathA) << " ends first";
+    }
+    cout << '\n';
+    for (const std::string& line : history) {
+        cout << "  " << line << '\n';
+    }
+
+    // A few events of each log from the divergence on, then drain both so
+    // the totals cover the whole logs
+    for (int side = 0; side < 2; side++) {
+        EventCursor& log = side == 0 ? logA : logB;
+        TranslationEvent& event = side == 0 ? eventA : eventB;
+        UINT64& translation = side == 0 ? translationA : translationB;
+        bool more = side == 0 ? moreA : moreB;
+        cout << (side == 0 ? "< " : "> ") << (side == 0 ? pathA : pathB)
+             << '\n';
+        for (UINT64 shown = 0; more; more = log.Next(event, translation)) {
+            if (shown++ < std::max<UINT64>(context, 1)) {
+                cout << (side == 0 ? "< " : "> ")
+                     << FormatEvent(event, translation) << '\n';
+            }
+        }
+    }
+
+    cout << '\n'
+         << pathA << ": " << logA.GetIndex() << " events\n"
+         << pathB << ": " << logB.GetIndex() << " events\n";
+    PrintTypeCounts(cout, pathA, logA.GetTypeCounts());
+    PrintTypeCounts(cout, pathB, logB.GetTypeCounts());
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args;
+    UINT64 context = 8;
+    UINT64 limit = ~0ULL;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            cout << "Usage: " << argv[0] << " [options] dump <log>\n"
+                 << "       " << argv[0] << " [options] diff <logA> <logB>\n"
+                 << "Options:\n"
+                 << "  -h, --help                Show this help message\n"
+                 << "  --limit N                 Events printed by dump "
+                    "(default: all)\n"
+                 << "  --context N               Events shown around the "
+                    "divergence by diff (default: 8)\n";
+            return 0;
+        } else if (arg == "--limit" && i + 1 < argc) {
+            limit = std::stoull(argv[++i]);
+        } else if (arg == "--context" && i + 1 < argc) {
+            context = std::stoull(argv[++i]);
+        } else if (arg[0] != '-') {
+            args.push_back(arg);
+        } else {
+            cerr << "Unknown option: " << arg << '\n';
+            return 2;
+        }
+    }
+
+    if (args.size() == 2 && args[0] == "dump") {
+        return Dump(args[1], limit);
+    }
+    if (args.size() == 3 && args[0] == "diff") {
+        return Diff(args[1], args[2], context);
+    }
+    cerr << "Error: Expected 'dump <log>' or 'diff <logA> <logB>'" << '\n';
+    return 2;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include "common.h"
+
+// Compact binary log of translation events, written by EventLogWriter
+// (event_log_writer.h) and read by the event_log tool. A log is a header
+// followed by fixed-size records. Only translations that miss the L1 TLB
+// produce events, so the log stays small next to the trace.
+
+enum TranslationEventType : UINT8 {
+    kEventTlbMiss,     // L1 TLB miss, addr = virtual address
+    kEventTlbHit,      // Hit beyond L1, level 1 = victim TLB, 2 = L2 TLB
+    kEventPwcHit,      // PWC hit, level 0 = PGD, 1 = PUD, 2 = PMD PWC
+    kEventFullWalk,    // Walk from the root
+    kEventWalkRef,     // Table entry read, addr = entry paddr, level 0..3
+    kEventTableAlloc,  // New table, addr = table paddr, level 0..3
+    kEventPageAlloc,   // New data page, addr = frame paddr
+    kNumEventTypes,
+};
+
+struct TranslationEvent {
+    UINT64 addr;         // Address, meaning depends on type
+    UINT32 translation;  // Low 32 bits of the translation index
+    UINT8 type;          // TranslationEventType
+    UINT8 level;         // Page table / TLB / PWC level, see type
+    UINT8 hitLevel;      // WalkRefSource of a kEventWalkRef
+    UINT8 asid;          // Address space of the translation
+};
+static_assert(sizeof(TranslationEvent) == 16,
+              "TranslationEvent struct has unexpected padding");
+
+struct EventLogHeader {
+    char magic[8];      // kEventLogMagic
+    UINT32 version;     // kEventLogVersion
+    UINT32 recordSize;  // sizeof(TranslationEvent)
+};
+
+constexpr char kEventLogMagic[8] = "TLBEVLG";
+constexpr UINT32 kEventLogVersion = 1;
+
+inline EventLogHeader MakeEventLogHeader() {
+    EventLogHeader header;
+    std::memcpy(header.magic, kEventLogMagic, sizeof(header.magic));
+    header.version = kEventLogVersion;
+    header.recordSize = sizeof(TranslationEvent);
+    return header;
+}
+
+inline bool IsValidEventLogHeader(const EventLogHeader& header) {
+    return std::memcmp(header.magic, kEventLogMagic, sizeof(header.magic)) ==
+               0 &&
+           header.version == kEventLogVersion &&
+           header.recordSize == sizeof(TranslationEvent);
+}
+
+inline const char* TranslationEventName(UINT8 type) {
+    switch (type) {
+        case kEventTlbMiss:
+            return "tlb_miss";
+        case kEventTlbHit:
+            return "tlb_hit";
+        case kEventPwcHit:
+            return "pwc_hit";
+        case kEventFullWalk:
+            return "full_walk";
+        case kEventWalkRef:
+            return "walk_ref";
+        case kEventTableAlloc:
+            return "table_alloc";
+        case kEventPageAlloc:
+            return "page_alloc";
+        default:
+            return "unknown";
+    }
+}
+
+// Destination of translation events. Kept free of threading so the Pin
+// tool can include it; the offline analyzer plugs in EventLogWriter.
+class TranslationEventSink {
+   public:
+    virtual ~TranslationEventSink() = default;
+    virtual void Record(const TranslationEvent& event) = 0;
+};
+
+// Batch reader for event logs
+class EventLogReader {
+   private:
+    std::ifstream input_;
+    UINT64 eventsRead_;
+
+   public:
+    EventLogReader() : eventsRead_(0) {}
+
+    // Fails when the file is missing or not an event log of this version
+    bool Open(const std::string& path) {
+        eventsRead_ = 0;
+        input_.open(path, std::ios::binary);
+        EventLogHeader header;
+        input_.read(reinterpret_cast<char*>(&header), sizeof(header));
+        return input_.gcount() == sizeof(header) &&
+               IsValidEventLogHeader(header);
+    }
+
+    // Read up to maxEvents events into buffer, returns 0 at end of log
+    UINT64 ReadBatch(TranslationEvent* buffer, UINT64 maxEvents) {
+        input_.read(reinterpret_cast<char*>(buffer),
+                    maxEvents * sizeof(TranslationEvent));
+        UINT64 events = input_.gcount() / sizeof(TranslationEvent);
+        eventsRead_ += events;
+        return events;
+    }
+
+    UINT64 GetEventsRead() const { return eventsRead_; }
+};
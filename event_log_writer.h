@@ -0,0 +1,99 @@
+#pragma once
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+#include "event_log.h"
+
+// Buffered event log writer: the simulator fills one buffer while a
+// background thread writes the other, so logging does not stall on I/O
+class EventLogWriter : public TranslationEventSink {
+   private:
+    static constexpr UINT64 kBufferEvents = 1 << 16;  // 1MB per buffer
+
+    std::ofstream output_;
+    std::vector<TranslationEvent> active_;   // Filled by the simulator
+    std::vector<TranslationEvent> pending_;  // Being written by the thread
+    bool pendingFull_;                       // pending_ awaits writing
+    bool closing_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+    UINT64 eventsWritten_;
+
+    void WriterLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return pendingFull_ || closing_; });
+            if (pendingFull_) {
+                lock.unlock();
+                output_.write(reinterpret_cast<const char*>(pending_.data()),
+                              pending_.size() * sizeof(TranslationEvent));
+                lock.lock();
+                eventsWritten_ += pending_.size();
+                pending_.clear();
+                pendingFull_ = false;
+                cv_.notify_all();
+            } else {
+                return;  // Closing with nothing left to write
+            }
+        }
+    }
+
+    // Hand the active buffer to the writer thread
+    void Submit() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !pendingFull_; });
+        pending_.swap(active_);
+        pendingFull_ = true;
+        cv_.notify_all();
+    }
+
+   public:
+    EventLogWriter()
+        : pendingFull_(false), closing_(false), eventsWritten_(0) {}
+    ~EventLogWriter() override { Close(); }
+
+    bool Open(const std::string& path) {
+        output_.open(path, std::ios::binary);
+        if (!output_.is_open()) {
+            return false;
+        }
+        EventLogHeader header = MakeEventLogHeader();
+        output_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        active_.reserve(kBufferEvents);
+        pending_.reserve(kBufferEvents);
+        thread_ = std::thread(&EventLogWriter::WriterLoop, this);
+        return true;
+    }
+
+    void Record(const TranslationEvent& event) override {
+        active_.push_back(event);
+        if (active_.size() == kBufferEvents) {
+            Submit();
+        }
+    }
+
+    // Flush buffered events and stop the writer thread
+    void Close() {
+        if (!thread_.joinable()) {
+            return;
+        }
+        if (!active_.empty()) {
+            Submit();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closing_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+        output_.close();
+    }
+
+    UINT64 GetEventsWritten() const { return eventsWritten_; }
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include "common.h"
+
+// Backing of large simulator structures (cache tag arrays, page tables,
+// the physical frame bitmap). These span many MB and are accessed randomly,
+// so on small host pages the simulator itself takes host TLB misses.
+constexpr UINT64 kHostHugePageSize = 2ULL << 20;  // 2MB host huge page
+
+// Currently selected policy; structures allocated afterwards follow it
+inline HugePagePolicy& ActiveHugePagePolicy() {
+    static HugePagePolicy policy = kHugePagesThp;
+    return policy;
+}
+
+inline void SetHugePagePolicy(HugePagePolicy policy) {
+    ActiveHugePagePolicy() = policy;
+}
+
+// Parse "off", "thp" or "hugetlb", returns false for anything else
+inline bool ParseHugePagePolicy(const std::string& text,
+                                HugePagePolicy& policy) {
+    for (HugePagePolicy p : {kHugePagesOff, kHugePagesThp, kHugePagesHugetlb}) {
+        if (text == HugePagePolicyName(p)) {
+            policy = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Map bytes (a multiple of kHostHugePageSize) following the active policy.
+// hugetlb falls back to transparent huge pages when the pool is empty.
+inline void* MapHugePageRegion(UINT64 bytes) {
+    HugePagePolicy policy = ActiveHugePagePolicy();
+    void* region = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (policy == kHugePagesHugetlb) {
+        region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (region != MAP_FAILED) {
+            return region;
+        }
+        static bool warned = false;
+        if (!warned) {
+            std::cerr << "Warning: hugetlb pages unavailable, falling back to "
+                         "transparent huge pages\n";
+            warned = true;
+        }
+    }
+#endif
+    region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+    // Explicitly opt out when disabled so "always" THP hosts honor the knob
+    madvise(region, bytes,
+            policy == kHugePagesOff ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+#endif
+    return region;
+}
+
+inline void UnmapHugePageRegion(void* region, UINT64 bytes) {
+    munmap(region, bytes);
+}
+
+inline UINT64 RoundUpToHugePage(UINT64 bytes) {
+    return (bytes + kHostHugePageSize - 1) & ~(kHostHugePageSize - 1);
+}
+
+// Allocator for large containers: requests of at least one huge page are
+// mapped directly, smaller ones go to the regular heap. The path depends
+// only on the size, so deallocate always matches allocate.
+template <typename T>
+class HugePageAllocator {
+   public:
+    typedef T value_type;
+
+    HugePageAllocator() = default;
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        UINT64 bytes = n * sizeof(T);
+        if (bytes < kHostHugePageSize) {
+            return static_cast<T*>(::operator new(bytes));
+        }
+        return static_cast<T*>(MapHugePageRegion(RoundUpToHugePage(bytes)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        UINT64 bytes = n * sizeof(T);
+        if (bytes < kHostHugePageSize) {
+            ::operator delete(p);
+            return;
+        }
+        UnmapHugePageRegion(p, RoundUpToHugePage(bytes));
+    }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U>&) const {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const HugePageAllocator<U>&) const {
+        return false;
+    }
+};
+
+// Bump allocator for many small objects that live as long as their owner
+// (page tables), carved out of huge-page-backed chunks
+class HugePageArena {
+   private:
+    static constexpr UINT64 kChunkSize = 16 * kHostHugePageSize;
+
+    std::vector<std::pair<char*, UINT64>> chunks_;  // Mapped regions
+    char* next_;   // Next free byte in the current chunk
+    UINT64 left_;  // Free bytes in the current chunk
+    UINT64 used_;  // Bytes handed out
+
+   public:
+    HugePageArena() : next_(nullptr), left_(0), used_(0) {}
+    HugePageArena(const HugePageArena&) = delete;
+    HugePageArena& operator=(const HugePageArena&) = delete;
+
+    ~HugePageArena() {
+        for (auto& chunk : chunks_) {
+            UnmapHugePageRegion(chunk.first, chunk.second);
+        }
+    }
+
+    // Zero-filled, align must be a power of two
+    void* Allocate(UINT64 bytes, UINT64 align = alignof(std::max_align_t)) {
+        UINT64 pad = -reinterpret_cast<uintptr_t>(next_) & (align - 1);
+        if (pad + bytes > left_) {
+            UINT64 size = RoundUpToHugePage(bytes > kChunkSize ? bytes
+                                                               : kChunkSize);
+            next_ = static_cast<char*>(MapHugePageRegion(size));
+            left_ = size;
+            chunks_.emplace_back(next_, size);
+            pad = 0;
+        }
+        void* block = next_ + pad;
+        next_ += pad + bytes;
+        left_ -= pad + bytes;
+        used_ += bytes;
+        return block;  // Fresh anonymous mappings are already zeroed
+    }
+
+    UINT64 GetUsedBytes() const { return used_; }
+    UINT64 GetMappedBytes() const {
+        UINT64 mapped = 0;
+        for (const auto& chunk : chunks_) {
+            mapped += chunk.second;
+        }
+        return mapped;
+    }
+};
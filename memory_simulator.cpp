@@ -3,10 +3,13 @@
 #include <iostream>
 #include <memory>
 #include <ostream>
+#include <vector>
 #include "common.h"
 #include "data_cache.h"
 #include "page_table.h"
 #include "pin.H"
+#include "shm_ring.h"
+#include "trace_format.h"
 
 using std::cerr;
 using std::cout;
@@ -78,10 +81,42 @@ KNOB<bool> KnobTOCEnabled(KNOB_MODE_WRITEONCE, "pintool", "toc_enabled", "0",
                           "Enable Table of Contents (TOC) for PWC");
 KNOB<UINT64> KnobTOCSize(KNOB_MODE_WRITEONCE, "pintool", "toc_size", "0",
                          "Size of the Table of Contents (TOC) in bytes");
+KNOB<std::string> KnobHugePages(KNOB_MODE_WRITEONCE, "pintool", "huge_pages",
+                                "thp",
+                                "Host page backing of large simulator "
+                                "structures: off, thp or hugetlb");
 KNOB<std::string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool", "o",
                                  "memory_simulator.out",
                                  "Output file for simulation results");
 
+// --- Shared-memory fan-out to offline consumers ---
+KNOB<std::string> KnobShmRing(KNOB_MODE_WRITEONCE, "pintool", "shm_ring", "",
+                              "Publish accesses to the shared-memory ring "
+                              "NAME, read by memory_simulator_offline "
+                              "shm:NAME, instead of simulating in-process");
+KNOB<UINT64> KnobShmRingRecords(KNOB_MODE_WRITEONCE, "pintool",
+                                "shm_ring_records", "4194304",
+                                "Ring capacity in accesses (24 bytes each)");
+KNOB<UINT64> KnobShmConsumers(KNOB_MODE_WRITEONCE, "pintool", "shm_consumers",
+                              "1",
+                              "Consumers to wait for before the first "
+                              "accesses are published");
+ShmRingWriter* g_ring = nullptr;
+PIN_MUTEX g_ringMutex;  // Buffers of several threads fill one ring
+UINT64 g_published = 0;
+
+// --- Trace file output ---
+KNOB<std::string> KnobTraceFile(KNOB_MODE_WRITEONCE, "pintool", "trace", "",
+                                "Write accesses to a version 2 trace file "
+                                "(thread ids and access kinds) for "
+                                "memory_simulator_offline instead of "
+                                "simulating in-process");
+std::ofstream* g_traceFile = nullptr;
+TraceWriter g_traceWriter;
+PIN_MUTEX g_traceMutex;  // Buffers of several threads fill one file
+std::vector<MemRefContext> g_traceContext;
+UINT64 g_traced = 0;
+
 // --- Simulator Class ---
 class Simulator {
    public:
@@ -107,9 +142,26 @@ class Simulator {
             const MEMREF& ref = buffer[i];
             access_count_++;
             const ADDRINT vaddr = ref.ea;
-            const ADDRINT paddr = page_table_.Translate(vaddr);
-            UINT64 value = 0;
-            cache_hierarchy_.Access(paddr, value, !ref.read);
+            if (ref.flags & kMemRefPrefetch) {
+                // Non-blocking, walk included; dropped on unmapped pages
+                UINT64 start = cache_hierarchy_.GetAccessCycles();
+                ADDRINT paddr;
+                if (page_table_.TranslatePrefetch(vaddr, ref.pc, paddr)) {
+                    cache_hierarchy_.SoftwarePrefetch(paddr, ref.flags);
+                }
+                cache_hierarchy_.HidePrefetchCycles(
+                    cache_hierarchy_.GetAccessCycles() - start);
+            } else {
+                ADDRINT paddr;
+                try {
+                    paddr = page_table_.Translate(vaddr);
+                } catch (const std::runtime_error& e) {
+                    cerr << "Error: " << e.what() << '\n';
+                    PIN_ExitProcess(1);
+                }
+                UINT64 value = 0;
+                cache_hierarchy_.Access(paddr, value, !ref.read, ref.flags);
+            }
 
             // UINT64 vpn = vaddr / kMemTracePageSize;
             // UINT64 ppn = paddr / kMemTracePageSize;
@@ -165,35 +217,82 @@ VOID Instruction(INS ins, VOID* v) {
 }
 
 // --- Pin Instrumentation ---
+// MemRefFlag bits of an instruction's memory references
+UINT16 MemRefFlags(INS ins) {
+    if (INS_IsCacheLineFlush(ins)) {
+        return INS_Mnemonic(ins) == "CLWB" ? kMemRefCleanLine : kMemRefFlush;
+    }
+    if (INS_IsPrefetch(ins)) {
+        // PREFETCHT0, PREFETCHW and PREFETCHWT1 fill L1 (T0 hint)
+        const std::string mnemonic = INS_Mnemonic(ins);
+        if (mnemonic == "PREFETCHNTA") {
+            return kMemRefPrefetch | kMemRefPrefetchNta;
+        }
+        if (mnemonic == "PREFETCHT1" || mnemonic == "PREFETCHT2") {
+            return kMemRefPrefetch | kMemRefPrefetchL2;
+        }
+        return kMemRefPrefetch;
+    }
+    UINT16 flags = 0;
+    // MOVNTI, MOVNTQ, (V)MOVNTDQ/PS/PD, (V)MOVNTDQA and (V)MASKMOVDQU
+    const std::string mnemonic = INS_Mnemonic(ins);
+    UINT64 start = mnemonic[0] == 'V' ? 1 : 0;
+    if (mnemonic.compare(start, 5, "MOVNT") == 0 ||
+        mnemonic.compare(start, 7, "MASKMOV") == 0) {
+        flags |= kMemRefNonTemporal;
+    }
+    if (INS_IsAtomicUpdate(ins)) {
+        flags |= kMemRefAtomic;
+    }
+    if (INS_IsStackRead(ins) || INS_IsStackWrite(ins)) {
+        flags |= kMemRefStack;
+    }
+    return flags;
+}
+
+// Record one memory operand. read and flags are filled as one 32-bit word
+// (read in the low half), so IARG_UINT32 covers both fields.
+VOID InsertMemRef(INS ins, UINT32 memOp, bool isRead, UINT16 flags) {
+    INS_InsertFillBuffer(ins, IPOINT_BEFORE, bufId, IARG_INST_PTR,
+                         offsetof(MEMREF, pc), IARG_MEMORYOP_EA, memOp,
+                         offsetof(MEMREF, ea), IARG_UINT64,
+                         INS_MemoryOperandSize(ins, memOp),
+                         offsetof(MEMREF, size), IARG_UINT32,
+                         (UINT32)isRead | (UINT32)flags << 16,
+                         offsetof(MEMREF, read), IARG_END);
+}
+
 VOID Trace(TRACE trace, VOID* v) {
     // Count all instructions in this trace
     for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
         for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
             // Increment instruction count
 
+            UINT16 flags = MemRefFlags(ins);
+            // A flush or write-back is one reference to its line
+            if (flags & (kMemRefFlush | kMemRefCleanLine)) {
+                if (INS_MemoryOperandCount(ins) > 0) {
+                    InsertMemRef(ins, 0, false, flags);
+                }
+                continue;
+            }
+            // So is a prefetch, which is not a standard memop
+            if (flags & kMemRefPrefetch) {
+                if (INS_MemoryOperandCount(ins) > 0) {
+                    InsertMemRef(ins, 0, true, flags);
+                }
+                continue;
+            }
             if (!INS_IsStandardMemop(ins))
                 continue;
             UINT64 memOps = INS_MemoryOperandCount(ins);
             for (UINT64 memOp = 0; memOp < memOps; memOp++) {
                 if (INS_MemoryOperandIsRead(ins, memOp)) {
-                    INS_InsertFillBuffer(ins, IPOINT_BEFORE, bufId,
-                                         IARG_INST_PTR, offsetof(MEMREF, pc),
-                                         IARG_MEMORYOP_EA, memOp,
-                                         offsetof(MEMREF, ea), IARG_UINT64,
-                                         INS_MemoryOperandSize(ins, memOp),
-                                         offsetof(MEMREF, size), IARG_BOOL,
-                                         INS_MemoryOperandIsRead(ins, memOp),
-                                         offsetof(MEMREF, read), IARG_END);
+                    InsertMemRef(ins, memOp, true, flags);
                 }
                 if (INS_MemoryOperandIsWritten(ins, memOp)) {
-                    INS_InsertFillBuffer(ins, IPOINT_BEFORE, bufId,
-                                         IARG_INST_PTR, offsetof(MEMREF, pc),
-                                         IARG_MEMORYOP_EA, memOp,
-                                         offsetof(MEMREF, ea), IARG_UINT64,
-                                         INS_MemoryOperandSize(ins, memOp),
-                                         offsetof(MEMREF, size), IARG_BOOL,
-                                         INS_MemoryOperandIsRead(ins, memOp),
-                                         offsetof(MEMREF, read), IARG_END);
+                    InsertMemRef(ins, memOp,
+                                 INS_MemoryOperandIsRead(ins, memOp), flags);
                 }
             }
         }
@@ -203,6 +302,31 @@ VOID Trace(TRACE trace, VOID* v) {
 // --- Buffer Handling ---
 VOID* BufferFull(BUFFER_ID id, THREADID tid, const CONTEXT* ctx, VOID* buf,
                  UINT64 numElements, VOID* v) {
+    if (g_ring) {
+        PIN_MutexLock(&g_ringMutex);
+        g_ring->Publish(static_cast<MEMREF*>(buf), numElements);
+        g_published += numElements;
+        PIN_MutexUnlock(&g_ringMutex);
+        if (KnobInstrThreshold.Value() &&
+            g_instr_count >= KnobInstrThreshold.Value()) {
+            PIN_ExitProcess(0);
+        }
+        return buf;
+    }
+    if (g_traceFile) {
+        // Each thread fills its own buffer, so the whole batch is tid's
+        PIN_MutexLock(&g_traceMutex);
+        g_traceContext.assign(numElements, MemRefContext{tid, 0});
+        g_traceWriter.Write(static_cast<MEMREF*>(buf), g_traceContext.data(),
+                            numElements);
+        g_traced += numElements;
+        PIN_MutexUnlock(&g_traceMutex);
+        if (KnobInstrThreshold.Value() &&
+            g_instr_count >= KnobInstrThreshold.Value()) {
+            PIN_ExitProcess(0);
+        }
+        return buf;
+    }
     Simulator* simulator = static_cast<Simulator*>(v);
     simulator->process_batch(static_cast<MEMREF*>(buf), numElements);
     return buf;
@@ -210,6 +334,21 @@ VOID* BufferFull(BUFFER_ID id, THREADID tid, const CONTEXT* ctx, VOID* buf,
 
 // --- Fini Function ---
 VOID Fini(INT32 code, VOID* v) {
+    if (g_ring) {
+        // Consumers drain the ring and print their own results
+        g_ring->Close();
+        cerr << "Published " << g_published << " accesses to shm:"
+             << KnobShmRing.Value() << '\n';
+        delete g_ring;
+        return;
+    }
+    if (g_traceFile) {
+        g_traceFile->close();
+        cerr << "Wrote " << g_traced << " accesses to "
+             << KnobTraceFile.Value() << '\n';
+        delete g_traceFile;
+        return;
+    }
     Simulator* simulator = static_cast<Simulator*>(v);
     simulator->print_stats();
     delete simulator;
@@ -257,6 +396,12 @@ int main(int argc, char* argv[]) {
     config.pgtbl.pteSize = KnobPTESize.Value();
     config.pgtbl.tocEnabled = KnobTOCEnabled.Value();
     config.pgtbl.tocSize = KnobTOCSize.Value();
+    if (!ParseHugePagePolicy(KnobHugePages.Value(), config.hugePages)) {
+        cerr << "Error: Unknown huge page policy " << KnobHugePages.Value()
+             << '\n';
+        return 1;
+    }
+    SetHugePagePolicy(config.hugePages);
 
     // Open output file
     auto out_file = std::make_unique<std::ofstream>(KnobOutputFile.Value());
@@ -266,10 +411,33 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    config.Print(*out_file);
-
-    // Initialize simulator
-    Simulator* simulator = new Simulator(config, std::move(out_file));
+    // Publish to the shared-memory ring, write a trace, or simulate
+    // in-process
+    Simulator* simulator = nullptr;
+    if (!KnobShmRing.Value().empty()) {
+        g_ring = new ShmRingWriter();
+        if (!g_ring->Open(KnobShmRing.Value(), KnobShmRingRecords.Value(),
+                          KnobShmConsumers.Value())) {
+            cerr << "Error: Unable to create shared-memory ring "
+                 << KnobShmRing.Value() << '\n';
+            return 1;
+        }
+        PIN_MutexInit(&g_ringMutex);
+    } else if (!KnobTraceFile.Value().empty()) {
+        g_traceFile = new std::ofstream(KnobTraceFile.Value(), std::ios::binary);
+        if (!g_traceFile->is_open()) {
+            cerr << "Error: Unable to open trace file "
+                 << KnobTraceFile.Value() << '\n';
+            return 1;
+        }
+        // Pin's buffers carry no instruction counts
+        g_traceWriter.Open(*g_traceFile, kTraceFormatVersion,
+                           kTraceHasThreads);
+        PIN_MutexInit(&g_traceMutex);
+    } else {
+        config.Print(*out_file);
+        simulator = new Simulator(config, std::move(out_file));
+    }
 
     // Define trace buffer
     bufId = PIN_DefineTraceBuffer(sizeof(MEMREF), NUM_BUF_PAGES, BufferFull,
@@ -1,15 +1,24 @@
 // offline_analyzer.cpp
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include "common.h"
 #include "data_cache.h"
+#include "event_log_writer.h"
 #include "page_table.h"
+#include "sim_options.h"
+#include "simulator.h"
+#include "trace_filter.h"
+#include "trace_reader.h"
 
 using std::cerr;
 using std::cout;
@@ -17,35 +26,58 @@ using std::cout;
 // --- Offline Analyzer Class ---
 class OfflineAnalyzer {
    public:
-    OfflineAnalyzer(const SimConfig& config)
-        : config_(config),
-          physicalMemory_(config.PhysicalMemBytes()),
-          cacheHierarchy_(
-              config.cache.l1Size, config.cache.l1Ways, config.cache.l1Line,
-              config.cache.l2Size, config.cache.l2Ways, config.cache.l2Line,
-              config.cache.l3Size, config.cache.l3Ways, config.cache.l3Line),
-          pageTable_(physicalMemory_, cacheHierarchy_, config.pgtbl.pteCachable,
-                     config.tlb.l1Size, config.tlb.l1Ways, config.tlb.l2Size,
-                     config.tlb.l2Ways, config.pwc.pgdSize, config.pwc.pgdWays,
-                     config.pwc.pudSize, config.pwc.pudWays, config.pwc.pmdSize,
-                     config.pwc.pmdWays, config.pgtbl.pgdSize,
-                     config.pgtbl.pudSize, config.pgtbl.pmdSize,
-                     config.pgtbl.pteSize, config.pgtbl.tocEnabled,
-                     config.pgtbl.tocSize) {}
+    // Each of variants runs in lockstep with the base configuration on the
+    // same accesses, see PrintComparison
+    OfflineAnalyzer(const SimConfig& config,
+                    const std::vector<SimConfig>& variants = {})
+        : config_(config), base_(config), traceFilter_(config.filters) {
+        for (const SimConfig& variant : variants) {
+            variants_.emplace_back(new Simulator(variant));
+        }
+        if (!variants_.empty()) {
+            base_.pageTable.EnablePcWalkStats();
+            for (auto& variant : variants_) {
+                variant->pageTable.EnablePcWalkStats();
+            }
+            nextIntervalEnd_ = config_.compare.interval;
+        }
+    }
 
     bool Run() {
+        if (!config_.eventLog.empty()) {
+            if (!eventLog_.Open(config_.eventLog)) {
+                cerr << "Error: Could not open event log: " << config_.eventLog
+                     << '\n';
+                return false;
+            }
+            base_.pageTable.SetEventSink(&eventLog_);
+        }
+        bool ok = config_.traceFiles.size() > 1 ? RunColocated() : RunSingle();
+        if (!config_.eventLog.empty()) {
+            base_.pageTable.SetEventSink(nullptr);
+            eventLog_.Close();
+            cout << "Wrote " << eventLog_.GetEventsWritten()
+                 << " translation events to " << config_.eventLog << '\n';
+        }
+        return ok;
+    }
+
+    bool RunSingle() {
         // Open trace file
-        std::ifstream input(config_.traceFile, std::ios::binary);
-        if (!input.is_open()) {
+        TraceReader input;
+        if (!input.Open(config_.traceFile)) {
             cerr << "Error: Could not open trace file: " << config_.traceFile
                  << '\n';
             return false;
         }
 
+        NoteTraceFormat(input);
+
         cout << "Starting offline analysis..." << '\n';
 
         // Initialize buffer for batch processing
         std::vector<MEMREF> buffer(config_.batchSize);
+        std::vector<MemRefContext> context(config_.batchSize);
 
         // Timer for progress reporting
         auto startTime = std::chrono::high_resolution_clock::now();
@@ -53,25 +85,21 @@ class OfflineAnalyzer {
 
         while (true) {
             // Read a batch of MEMREF entries from the trace file
-            input.read(reinterpret_cast<char*>(buffer.data()),
-                       config_.batchSize * sizeof(MEMREF));
-
-            std::streamsize bytesRead = input.gcount();
-            if (bytesRead == 0) {
+            UINT64 recordsRead =
+                input.ReadBatch(buffer.data(), buffer.size(), context.data());
+            if (recordsRead == 0) {
                 // End of file reached
                 break;
             }
 
-            // Calculate number of complete records read
-            UINT64 recordsRead = bytesRead / sizeof(MEMREF);
-            if (bytesRead % sizeof(MEMREF) != 0) {
-                cerr << "Warning: Partial record detected at end of file. "
-                        "Skipping."
-                     << '\n';
+            // Drop/rewrite accesses before they reach the simulator
+            if (!traceFilter_.IsEmpty()) {
+                recordsRead = traceFilter_.Apply(buffer.data(), recordsRead,
+                                                 context.data());
             }
 
             // Process each MEMREF in the batch
-            ProcessBatch(buffer.data(), recordsRead);
+            ProcessBatch(buffer.data(), recordsRead, context.data());
 
             // Report progress every few seconds
             auto currentTime = std::chrono::high_resolution_clock::now();
@@ -86,7 +114,7 @@ class OfflineAnalyzer {
             }
         }
 
-        input.close();
+        input.Close();
 
         // Final time calculation
         auto endTime = std::chrono::high_resolution_clock::now();
@@ -99,22 +127,350 @@ class OfflineAnalyzer {
         return true;
     }
 
-    void ProcessBatch(const MEMREF* buffer, UINT64 numElements) {
+    // Interleave several traces, each in its own address space, on the shared
+    // TLBs, PWCs and caches according to the configured schedule
+    bool RunColocated() {
+        tenants_.resize(config_.traceFiles.size());
+        for (size_t t = 0; t < tenants_.size(); ++t) {
+            Tenant& tenant = tenants_[t];
+            if (!tenant.reader.Open(config_.traceFiles[t])) {
+                cerr << "Error: Could not open trace file: "
+                     << config_.traceFiles[t] << '\n';
+                return false;
+            }
+            tenant.buffer.resize(config_.batchSize);
+            tenant.context.resize(config_.batchSize);
+            NoteTraceFormat(tenant.reader);
+            tenant.slice = config_.sched.quantum *
+                           (config_.sched.weights.empty()
+                                ? 1
+                                : config_.sched.weights[t]);
+        }
+
+        cout << "Starting offline analysis of " << tenants_.size()
+             << " co-located traces..." << '\n';
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+        auto lastReportTime = startTime;
+
+        size_t active = tenants_.size();
+        while (active > 0) {
+            for (size_t t = 0; t < tenants_.size(); ++t) {
+                Tenant& tenant = tenants_[t];
+                if (tenant.done) {
+                    continue;
+                }
+                base_.SwitchAddressSpace(t);
+                for (auto& variant : variants_) {
+                    variant->SwitchAddressSpace(t);
+                }
+                const TranslationStats& ts = base_.pageTable.GetTranslationStats();
+                UINT64 accessesBefore = accessCount_;
+                UINT64 tlbMissesBefore =
+                    ts.GetTotalTranslation() - ts.GetTlbHits();
+                UINT64 walkRefsBefore = ts.pageWalkMemAccess;
+                UINT64 memBefore = base_.cacheHierarchy.memAccessCount;
+
+                // Run this tenant for one slice (or until its trace ends)
+                UINT64 remaining = tenant.slice;
+                while (remaining > 0) {
+                    if (tenant.pos == tenant.count && !RefillTenant(tenant)) {
+                        tenant.done = true;
+                        active--;
+                        break;
+                    }
+                    UINT64 n = std::min(remaining, tenant.count - tenant.pos);
+                    ProcessBatch(tenant.buffer.data() + tenant.pos, n,
+                                 tenant.context.data() + tenant.pos);
+                    tenant.pos += n;
+                    remaining -= n;
+                }
+
+                tenant.accesses += accessCount_ - accessesBefore;
+                tenant.tlbMisses += ts.GetTotalTranslation() -
+                                    ts.GetTlbHits() - tlbMissesBefore;
+                tenant.walkMemAccesses += ts.pageWalkMemAccess - walkRefsBefore;
+                tenant.memAccesses +=
+                    base_.cacheHierarchy.memAccessCount - memBefore;
+            }
+
+            auto currentTime = std::chrono::high_resolution_clock::now();
+            if (std::chrono::duration_cast<std::chrono::seconds>(
+                    currentTime - lastReportTime)
+                    .count() >= 5) {
+                cout << "Processed " << accessCount_ << " accesses\r"
+                     << std::flush;
+                lastReportTime = currentTime;
+            }
+        }
+
+        for (Tenant& tenant : tenants_) {
+            tenant.reader.Close();
+        }
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+        auto totalDuration = std::chrono::duration_cast<std::chrono::seconds>(
+                                 endTime - startTime)
+                                 .count();
+
+        cout << "\nAnalysis complete in " << totalDuration << " seconds."
+             << '\n';
+        return true;
+    }
+
+    // Remember the newest trace format read, for the thread report
+    void NoteTraceFormat(const TraceReader& reader) {
+        traceVersion_ = std::max(traceVersion_, reader.GetVersion());
+        traceFeatures_ |= reader.GetFeatures();
+        if (config_.compare.intervalInstructions && !variants_.empty() &&
+            !(reader.GetFeatures() & kTraceHasInstructions)) {
+            cerr << "Warning: " << reader.GetPath()
+                 << " has no instruction counts; instruction-based "
+                    "comparison intervals will not advance"
+                 << '\n';
+        }
+    }
+
+    void ProcessBatch(const MEMREF* buffer, UINT64 numElements,
+                      const MemRefContext* context = nullptr) {
+        if (paddrs_.size() < numElements) {
+            paddrs_.resize(numElements);
+        }
+        ADDRINT* paddrs = paddrs_.data();
+        for (auto& variant : variants_) {
+            variant->ProcessBatch(buffer, numElements, paddrs);
+        }
+        base_.ProcessBatch(buffer, numElements, paddrs);
+        accessCount_ += numElements;
+
+        // Per-thread accounting of extended traces (tids of co-located
+        // traces are told apart by ASID)
+        if (context && traceVersion_ >= 2) {
+            const UINT64 asidKey = base_.pageTable.GetAsid() << 32;
+            for (UINT64 i = 0; i < numElements; ++i) {
+                ThreadStats& thread = threads_[asidKey | context[i].tid];
+                thread.accesses++;
+                thread.instructions += context[i].instructions;
+                instructionCount_ += context[i].instructions;
+            }
+        }
+
+        // Comparison intervals end on batch boundaries
+        const UINT64 position = config_.compare.intervalInstructions
+                                    ? instructionCount_
+                                    : accessCount_;
+        if (!variants_.empty() && position >= nextIntervalEnd_) {
+            RecordInterval();
+            while (nextIntervalEnd_ <= position) {
+                nextIntervalEnd_ += config_.compare.interval;
+            }
+        }
+
+        // Track unique virtual (per address space) and physical pages
+        const UINT64 asidTag = base_.pageTable.GetAsid() << kAsidTagShift;
         for (UINT64 i = 0; i < numElements; ++i) {
-            const MEMREF& ref = buffer[i];
-            accessCount_++;
+            if (paddrs[i] == 0) {
+                continue;  // Prefetch dropped, the page was never touched
+            }
+            virtualPages_[buffer[i].ea / kMemTracePageSize | asidTag]++;
+            physicalPages_[paddrs[i] / kMemTracePageSize]++;
+        }
+    }
+
+    void RecordInterval() {
+        IntervalSample sample;
+        sample.accesses = accessCount_;
+        sample.instructions = instructionCount_;
+        sample.counters.push_back(base_.GetCounters());
+        for (auto& variant : variants_) {
+            sample.counters.push_back(variant->GetCounters());
+        }
+        intervals_.push_back(sample);
+    }
 
-            const ADDRINT vaddr = ref.ea;
-            const ADDRINT paddr = pageTable_.Translate(vaddr);
+    static void PrintDeltaRow(std::ostream& os, const char* metric,
+                              UINT64 base, UINT64 variant) {
+        INT64 delta = (INT64)(variant - base);
+        os << std::left << std::setw(18) << metric << std::right
+           << std::setw(16) << base << std::setw(16) << variant
+           << std::setw(16) << delta << std::setw(11) << std::fixed
+           << std::setprecision(2)
+           << (base > 0 ? delta * 100.0 / base : 0.0) << "%\n";
+    }
 
-            UINT64 value = 0;
-            cacheHierarchy_.Access(paddr, value, !ref.read);
+    // Differences of each variant from the base configuration: totals,
+    // per interval, and the PCs whose walks changed most
+    void PrintComparison(std::ostream& os) {
+        if (variants_.empty()) {
+            return;
+        }
+        if (intervals_.empty() || intervals_.back().accesses < accessCount_) {
+            RecordInterval();
+        }
+        const std::vector<Simulator::Counters>& totals =
+            intervals_.back().counters;
+
+        os << "\nConfiguration Comparison (variant - base):\n"
+           << "==========================================\n";
+        for (size_t v = 0; v < variants_.size(); ++v) {
+            const Simulator::Counters& base = totals[0];
+            const Simulator::Counters& variant = totals[v + 1];
+            os << "Variant " << v + 1 << ": " << config_.compare.variants[v]
+               << '\n'
+               << std::left << std::setw(18) << "Metric" << std::right
+               << std::setw(16) << "Base" << std::setw(16) << "Variant"
+               << std::setw(16) << "Delta" << std::setw(12) << "Delta %"
+               << '\n';
+            PrintDeltaRow(os, "TLB Misses", base.tlbMisses, variant.tlbMisses);
+            PrintDeltaRow(os, "Walk Mem Refs", base.walkMemAccesses,
+                          variant.walkMemAccesses);
+            PrintDeltaRow(os, "Memory Accesses", base.memAccesses,
+                          variant.memAccesses);
+            PrintDeltaRow(os, "Total Cycles", base.cycles, variant.cycles);
+        }
 
-            // Track unique virtual and physical pages
-            UINT64 vpn = vaddr / kMemTracePageSize;
-            UINT64 ppn = paddr / kMemTracePageSize;
-            virtualPages_[vpn]++;
-            physicalPages_[ppn]++;
+        const bool byInstructions = config_.compare.intervalInstructions;
+        os << "\nPer-Interval Deltas (every " << config_.compare.interval
+           << (byInstructions ? " instructions" : " accesses") << "):\n"
+           << std::setw(14) << (byInstructions ? "Instructions" : "Accesses")
+           << std::setw(14) << "Base Misses";
+        for (size_t v = 0; v < variants_.size(); ++v) {
+            std::string label = "V" + std::to_string(v + 1);
+            os << std::setw(16) << label + " dMiss" << std::setw(18)
+               << label + " dCycles";
+        }
+        os << '\n';
+        Simulator::Counters zero;
+        for (size_t k = 0; k < intervals_.size(); ++k) {
+            const IntervalSample& sample = intervals_[k];
+            const IntervalSample* prev = k > 0 ? &intervals_[k - 1] : nullptr;
+            auto interval = [&](size_t sim) {
+                const Simulator::Counters& start =
+                    prev ? prev->counters[sim] : zero;
+                Simulator::Counters counters = sample.counters[sim];
+                counters.tlbMisses -= start.tlbMisses;
+                counters.cycles -= start.cycles;
+                return counters;
+            };
+            Simulator::Counters base = interval(0);
+            os << std::setw(14)
+               << (byInstructions ? sample.instructions : sample.accesses)
+               << std::setw(14) << base.tlbMisses;
+            for (size_t v = 0; v < variants_.size(); ++v) {
+                Simulator::Counters variant = interval(v + 1);
+                os << std::setw(16)
+                   << (INT64)(variant.tlbMisses - base.tlbMisses)
+                   << std::setw(18) << (INT64)(variant.cycles - base.cycles);
+            }
+            os << '\n';
+        }
+
+        for (size_t v = 0; v < variants_.size(); ++v) {
+            PrintPcDeltas(os, v);
+        }
+    }
+
+    // PCs with the largest change in walk memory references
+    void PrintPcDeltas(std::ostream& os, size_t v) const {
+        const auto& baseStats = base_.pageTable.GetPcWalkStats();
+        const auto& variantStats = variants_[v]->pageTable.GetPcWalkStats();
+        std::unordered_map<ADDRINT, std::pair<PcWalkStats, PcWalkStats>> pcs;
+        for (const auto& entry : baseStats) {
+            pcs[entry.first].first = entry.second;
+        }
+        for (const auto& entry : variantStats) {
+            pcs[entry.first].second = entry.second;
+        }
+        auto delta = [](const std::pair<PcWalkStats, PcWalkStats>& stats) {
+            return (INT64)(stats.second.memAccesses - stats.first.memAccesses);
+        };
+        std::vector<std::pair<ADDRINT, std::pair<PcWalkStats, PcWalkStats>>>
+            sorted(pcs.begin(), pcs.end());
+        size_t shown = std::min<size_t>(config_.compare.topPcs, sorted.size());
+        std::partial_sort(sorted.begin(), sorted.begin() + shown, sorted.end(),
+                          [&](const auto& a, const auto& b) {
+                              INT64 da = std::llabs(delta(a.second));
+                              INT64 db = std::llabs(delta(b.second));
+                              return da != db ? da > db : a.first < b.first;
+                          });
+
+        os << "\nPer-PC Walk Deltas, variant " << v + 1 << " (top " << shown
+           << " of " << sorted.size() << " PCs by walk memory references):\n"
+           << std::setw(18) << "PC" << std::setw(14) << "Base Walks"
+           << std::setw(14) << "Var Walks" << std::setw(14) << "Base MemRef"
+           << std::setw(14) << "Var MemRef" << std::setw(14) << "Delta"
+           << '\n';
+        for (size_t i = 0; i < shown; ++i) {
+            const auto& stats = sorted[i].second;
+            os << std::setw(18) << std::hex << std::showbase << sorted[i].first
+               << std::dec << std::noshowbase << std::setw(14)
+               << stats.first.walks << std::setw(14) << stats.second.walks
+               << std::setw(14) << stats.first.memAccesses << std::setw(14)
+               << stats.second.memAccesses << std::setw(14)
+               << delta(stats) << '\n';
+        }
+    }
+
+    // Accesses and instructions per thread of version 2 traces
+    void PrintThreadStats(std::ostream& os) const {
+        if (traceVersion_ < 2) {
+            return;
+        }
+        const bool hasInstructions = traceFeatures_ & kTraceHasInstructions;
+        os << "\nTrace Threads (format version " << traceVersion_ << "):\n";
+        os << "==================================\n";
+        os << std::left << std::setw(14)
+           << (tenants_.empty() ? "Thread" : "ASID/Thread") << std::right
+           << std::setw(15) << "Accesses" << std::setw(15) << "Instructions"
+           << std::setw(15) << "Acc/KI" << '\n';
+        os << std::string(59, '-') << '\n';
+        for (const auto& entry : threads_) {
+            std::string thread = std::to_string(entry.first & 0xffffffff);
+            if (!tenants_.empty()) {
+                thread = std::to_string(entry.first >> 32) + "/" + thread;
+            }
+            const ThreadStats& stats = entry.second;
+            os << std::left << std::setw(14) << thread << std::right
+               << std::setw(15) << stats.accesses << std::setw(15)
+               << stats.instructions << std::setw(15) << std::fixed
+               << std::setprecision(2)
+               << (stats.instructions > 0
+                       ? (double)stats.accesses / stats.instructions * 1000.0
+                       : 0.0)
+               << '\n';
+        }
+        if (!hasInstructions) {
+            os << "(the trace records no instruction counts)\n";
+        } else {
+            os << "Total instructions: " << instructionCount_ << '\n';
+        }
+    }
+
+    void PrintTenantStats(std::ostream& os) const {
+        if (tenants_.empty()) {
+            return;
+        }
+        os << "\nCo-located Tenant Statistics:\n";
+        os << "=============================\n";
+        os << std::left << std::setw(8) << "ASID" << std::right
+           << std::setw(15) << "Accesses" << std::setw(15) << "TLB Misses"
+           << std::setw(15) << "Walk Refs" << std::setw(15) << "Mem Accesses"
+           << std::setw(15) << "TLB MPKA" << '\n';
+        os << std::string(83, '-') << '\n';
+        for (size_t t = 0; t < tenants_.size(); ++t) {
+            const Tenant& tenant = tenants_[t];
+            os << std::left << std::setw(8) << t << std::right
+               << std::setw(15) << tenant.accesses << std::setw(15)
+               << tenant.tlbMisses << std::setw(15) << tenant.walkMemAccesses
+               << std::setw(15) << tenant.memAccesses << std::setw(15)
+               << std::fixed << std::setprecision(2)
+               << (tenant.accesses > 0
+                       ? (double)tenant.tlbMisses / tenant.accesses * 1000.0
+                       : 0.0)
+               << '\n';
+        }
+        for (size_t t = 0; t < tenants_.size(); ++t) {
+            os << "ASID " << t << ": " << config_.traceFiles[t] << '\n';
         }
     }
 
@@ -128,12 +484,16 @@ class OfflineAnalyzer {
              << (physicalPages_.size() * kMemTracePageSize) / (1024.0 * 1024)
              << " MB\n";
 
-        pageTable_.PrintDetailedStats(cout);
-        pageTable_.PrintMemoryStats(cout);
-        cacheHierarchy_.PrintStats(cout);
+        traceFilter_.PrintStats(cout);
+        PrintTenantStats(cout);
+        PrintThreadStats(cout);
+        PrintComparison(cout);
+        base_.pageTable.PrintDetailedStats(cout);
+        base_.pageTable.PrintMemoryStats(cout);
+        base_.cacheHierarchy.PrintStats(cout);
 
         // Optionally save detailed output to a file
-        std::string outputFile = config_.traceFile + ".analysis.txt";
+        std::string outputFile = ReportBaseName() + ".analysis.txt";
         std::ofstream outfile(outputFile);
         if (outfile.is_open()) {
             outfile << "Offline Analysis Results:\n"
@@ -146,9 +506,13 @@ class OfflineAnalyzer {
                            (1024.0 * 1024)
                     << " MB\n";
 
-            pageTable_.PrintDetailedStats(outfile);
-            pageTable_.PrintMemoryStats(outfile);
-            cacheHierarchy_.PrintStats(outfile);
+            traceFilter_.PrintStats(outfile);
+            PrintTenantStats(outfile);
+            PrintThreadStats(outfile);
+            PrintComparison(outfile);
+            base_.pageTable.PrintDetailedStats(outfile);
+            base_.pageTable.PrintMemoryStats(outfile);
+            base_.cacheHierarchy.PrintStats(outfile);
 
             outfile.close();
             cout << "Detailed results saved to " << outputFile << '\n';
@@ -156,21 +520,103 @@ class OfflineAnalyzer {
     }
 
    private:
+    // Detailed results are saved next to the trace; streams have no path
+    std::string ReportBaseName() const {
+        if (config_.traceFile == "-") {
+            return "stdin";
+        }
+        if (config_.traceFile.compare(0, 4, "shm:") == 0) {
+            return "shm-" + config_.traceFile.substr(4);
+        }
+        return config_.traceFile;
+    }
+
+    // One co-located trace and its scheduling/accounting state
+    struct Tenant {
+        TraceReader reader;
+        std::vector<MEMREF> buffer;
+        std::vector<MemRefContext> context;  // Parallel to buffer
+        UINT64 pos = 0;    // Next unprocessed entry in buffer
+        UINT64 count = 0;  // Valid entries in buffer
+        UINT64 slice = 0;  // Accesses per scheduling slice
+        bool done = false;
+        UINT64 accesses = 0;
+        UINT64 tlbMisses = 0;
+        UINT64 walkMemAccesses = 0;
+        UINT64 memAccesses = 0;
+    };
+
+    // Read and filter the tenant's next batch, false at end of its trace
+    bool RefillTenant(Tenant& tenant) {
+        do {
+            tenant.count = tenant.reader.ReadBatch(tenant.buffer.data(),
+                                                   tenant.buffer.size(),
+                                                   tenant.context.data());
+            if (tenant.count == 0) {
+                return false;
+            }
+            if (!traceFilter_.IsEmpty()) {
+                tenant.count = traceFilter_.Apply(
+                    tenant.buffer.data(), tenant.count, tenant.context.data());
+            }
+        } while (tenant.count == 0);
+        tenant.pos = 0;
+        return true;
+    }
+
     SimConfig config_;
-    PhysicalMemory physicalMemory_;
-    CacheHierarchy cacheHierarchy_;
-    PageTable pageTable_;
+    Simulator base_;
+    TraceFilter traceFilter_;
+    EventLogWriter eventLog_;
+    std::vector<std::unique_ptr<Simulator>> variants_;
+    // Cumulative counters at comparison interval ends
+    struct IntervalSample {
+        UINT64 accesses;      // Accesses processed at the interval end
+        UINT64 instructions;  // Instructions of extended traces by then
+        std::vector<Simulator::Counters> counters;  // Base, then variants
+    };
+    std::vector<IntervalSample> intervals_;
+    UINT64 nextIntervalEnd_ = 0;
+    std::vector<Tenant> tenants_;
     UINT64 accessCount_ = 0;
+    // Trace format and per-thread accounting (version 2 traces)
+    struct ThreadStats {
+        UINT64 accesses = 0;
+        UINT64 instructions = 0;
+    };
+    UINT32 traceVersion_ = 1;
+    UINT32 traceFeatures_ = 0;
+    std::map<UINT64, ThreadStats> threads_;  // Keyed by ASID << 32 | tid
+    UINT64 instructionCount_ = 0;
+    std::vector<ADDRINT> paddrs_;  // Translated addresses of the batch
     std::unordered_map<UINT64, UINT64> virtualPages_;
     std::unordered_map<UINT64, UINT64> physicalPages_;
 };
 
 // --- Command Line Argument Parsing ---
-SimConfig ParseArgs(int argc, char* argv[]) {
-    SimConfig config;
+// Machine options parse through ParseSimOption, exiting on a bad value
+bool ParseSimOptionOrExit(int argc, char* argv[], int& i, SimConfig& config) {
+    std::string arg = argv[i];
+    try {
+        return ParseSimOption(argc, argv, i, config);
+    } catch (const std::exception& e) {
+        cerr << "Error: Bad value for " << arg << ": " << e.what() << '\n';
+        exit(1);
+    }
+}
 
-    // Default values are already set in the SimConfig struct
+// Cross-option checks of the simulated machine, exiting when they fail
+void ValidateSimConfigOrExit(const SimConfig& config) {
+    try {
+        ValidateSimConfig(config);
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << '\n';
+        exit(1);
+    }
+}
 
+// Apply the options in argv[1..argc) to config
+void ParseOptions(int argc, char* argv[], SimConfig& config) {
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
 
@@ -178,135 +624,136 @@ SimConfig ParseArgs(int argc, char* argv[]) {
             cout << "Usage: " << argv[0] << " [options] <traceFile>\n"
                  << "Options:\n"
                  << "  -h, --help                Show this help message\n"
-                 << "  --phys_mem_gb N           Physical memory size in GB "
-                    "(default: 1)\n"
                  << "  --batchSize N            Batch size for processing "
                     "(default: 4096)\n"
-                 << "  --l1_tlb_size N           L1 TLB size (default: 64)\n"
-                 << "  --l1_tlb_ways N           L1 TLB associativity "
-                    "(default: 4)\n"
-                 << "  --l2_tlb_size N           L2 TLB size (default: 1024)\n"
-                 << "  --l2_tlb_ways N           L2 TLB associativity "
-                    "(default: 8)\n"
-                 << "  --l1_cache_size N         L1 Cache size in bytes "
-                    "(default: 32768)\n"
-                 << "  --l1Ways N               L1 Cache associativity "
-                    "(default: 8)\n"
-                 << "  --l1Line N               L1 Cache line size (default: "
-                    "64)\n"
-                 << "  --l2_cache_size N         L2 Cache size in bytes "
-                    "(default: 262144)\n"
-                 << "  --l2Ways N               L2 Cache associativity "
-                    "(default: 16)\n"
-                 << "  --l2Line N               L2 Cache line size (default: "
-                    "64)\n"
-                 << "  --l3_cache_size N         L3 Cache size in bytes "
-                    "(default: 8388608)\n"
-                 << "  --l3_ways N               L3 Cache associativity "
-                    "(default: 16)\n"
-                 << "  --l3Line N               L3 Cache line size (default: "
-                    "64)\n"
-                 << "  --pteCachable BOOL       PTE cacheable flag (default: "
-                    "0)\n"
-                 << "  --pgdSize N              PGD size in entries "
-                    "(default: 512)\n"
-                 << "  --pudSize N              PUD size in entries "
-                    "(default: 512)\n"
-                 << "  --pmdSize N              PMD size in entries "
-                    "(default: 512)\n"
-                 << "  --pteSize N              PTE size in entries "
-                    "(default: 512)\n"
-                 << "  --pgd_pwc_size N          PGD PWC size in entries "
-                    "(default: 4)\n"
-                 << "  --pgd_pwc_ways N          PGD PWC associativity "
-                    "(default: 4)\n"
-                 << "  --pud_pwc_size N          PUD PWC size in entries "
-                    "(default: 4)\n"
-                 << "  --pud_pwc_ways N          PUD PWC associativity "
-                    "(default: 4)\n"
-                 << "  --pmd_pwc_size N          PMD PWC size in entries "
-                    "(default: 16)\n"
-                 << "  --pmd_pwc_ways N          PMD PWC associativity "
-                    "(default: 4)\n"
-                 << " ---toc_enabled BOOL          Enable TOC (default: 0)\n"
-                 << "  --toc_size N               TOC size in bytes "
-                    "(default: 0)\n"
-                 << "  <traceFile>              Path to the trace file\n"
+                 << "  --event_log PATH          Binary log of translation "
+                    "events, compare logs with event_log (default: off)\n"
+                 << "  --quantum N              Accesses per tenant slice when "
+                    "interleaving traces (default: 10000)\n"
+                 << "  --weights W1,W2,...      Slices per round for each "
+                    "trace (default: round-robin)\n"
+                 << "  --variant \"OPTIONS\"      Also simulate the configuration "
+                    "with the machine OPTIONS applied, in lockstep, and report "
+                    "deltas (repeatable)\n"
+                 << "  --compare_interval N      Accesses per comparison "
+                    "interval (default: 1000000)\n"
+                 << "  --compare_interval_insns N  Instructions per "
+                    "comparison interval instead (version 2 traces)\n"
+                 << "  --compare_top_pcs N       PCs listed in per-PC walk "
+                    "deltas (default: 10)\n"
+                 << "  <traceFile>...           Path to the trace file(s); "
+                    "several traces run co-located, one ASID each. A trace "
+                    "may be a FIFO, a Unix socket, - (stdin) or shm:NAME "
+                    "(ring published by the Pin tool), in trace format "
+                    "version 1 or 2\n"
                  << '\n';
+            PrintSimOptionsUsage(cout);
+            cout << '\n';
+            PrintFilterUsage(cout);
             exit(0);
-        } else if (arg == "--phys_mem_gb" && i + 1 < argc) {
-            config.physMemGb = std::stoull(argv[++i]);
+        } else if (ParseSimOptionOrExit(argc, argv, i, config)) {
+            // Simulated machine option applied to config
         } else if (arg == "--batch_size" && i + 1 < argc) {
             config.batchSize = std::stoull(argv[++i]);
-        } else if (arg == "--l1_tlb_size" && i + 1 < argc) {
-            config.tlb.l1Size = std::stoull(argv[++i]);
-        } else if (arg == "--l1_tlb_ways" && i + 1 < argc) {
-            config.tlb.l1Ways = std::stoull(argv[++i]);
-        } else if (arg == "--l2_tlb_size" && i + 1 < argc) {
-            config.tlb.l2Size = std::stoull(argv[++i]);
-        } else if (arg == "--l2_tlb_ways" && i + 1 < argc) {
-            config.tlb.l2Ways = std::stoull(argv[++i]);
-        } else if (arg == "--l1_cache_size" && i + 1 < argc) {
-            config.cache.l1Size = std::stoull(argv[++i]);
-        } else if (arg == "--l1_ways" && i + 1 < argc) {
-            config.cache.l1Ways = std::stoull(argv[++i]);
-        } else if (arg == "--l1_line" && i + 1 < argc) {
-            config.cache.l1Line = std::stoull(argv[++i]);
-        } else if (arg == "--l2_cache_size" && i + 1 < argc) {
-            config.cache.l2Size = std::stoull(argv[++i]);
-        } else if (arg == "--l2_ways" && i + 1 < argc) {
-            config.cache.l2Ways = std::stoull(argv[++i]);
-        } else if (arg == "--l2_line" && i + 1 < argc) {
-            config.cache.l2Line = std::stoull(argv[++i]);
-        } else if (arg == "--l3_cache_size" && i + 1 < argc) {
-            config.cache.l3Size = std::stoull(argv[++i]);
-        } else if (arg == "--l3_ways" && i + 1 < argc) {
-            config.cache.l3Ways = std::stoull(argv[++i]);
-        } else if (arg == "--l3_line" && i + 1 < argc) {
-            config.cache.l3Line = std::stoull(argv[++i]);
-        } else if (arg == "--pte_cachable" && i + 1 < argc) {
-            config.pgtbl.pteCachable = (std::stoi(argv[++i]) != 0);
-        } else if (arg == "--pgd_size" && i + 1 < argc) {
-            config.pgtbl.pgdSize = std::stoull(argv[++i]);
-        } else if (arg == "--pud_size" && i + 1 < argc) {
-            config.pgtbl.pudSize = std::stoull(argv[++i]);
-        } else if (arg == "--pmd_size" && i + 1 < argc) {
-            config.pgtbl.pmdSize = std::stoull(argv[++i]);
-        } else if (arg == "--pte_size" && i + 1 < argc) {
-            config.pgtbl.pteSize = std::stoull(argv[++i]);
-        } else if (arg == "--pgd_pwc_size" && i + 1 < argc) {
-            config.pwc.pgdSize = std::stoull(argv[++i]);
-        } else if (arg == "--pgd_pwc_ways" && i + 1 < argc) {
-            config.pwc.pgdWays = std::stoull(argv[++i]);
-        } else if (arg == "--pud_pwc_size" && i + 1 < argc) {
-            config.pwc.pudSize = std::stoull(argv[++i]);
-        } else if (arg == "--pud_pwc_ways" && i + 1 < argc) {
-            config.pwc.pudWays = std::stoull(argv[++i]);
-        } else if (arg == "--pmd_pwc_size" && i + 1 < argc) {
-            config.pwc.pmdSize = std::stoull(argv[++i]);
-        } else if (arg == "--pmd_pwc_ways" && i + 1 < argc) {
-            config.pwc.pmdWays = std::stoull(argv[++i]);
-        } else if (arg == "--toc_enabled" && i + 1 < argc) {
-            config.pgtbl.tocEnabled = (std::stoi(argv[++i]) != 0);
-        } else if (arg == "--toc_size" && i + 1 < argc) {
-            config.pgtbl.tocSize = std::stoull(argv[++i]);
-        } else if (config.traceFile.empty() && arg[0] != '-') {
-            // Assume this is the trace file
-            config.traceFile = arg;
+        } else if (arg == "--event_log" && i + 1 < argc) {
+            config.eventLog = argv[++i];
+        } else if (ParseFilterOption(argc, argv, i, config.filters)) {
+            // Filter stage appended to config.filters
+        } else if (arg == "--quantum" && i + 1 < argc) {
+            config.sched.quantum = std::stoull(argv[++i]);
+        } else if (arg == "--weights" && i + 1 < argc) {
+            config.sched.weights = ParseList(argv[++i]);
+        } else if (arg == "--variant" && i + 1 < argc) {
+            config.compare.variants.push_back(argv[++i]);
+        } else if (arg == "--compare_interval" && i + 1 < argc) {
+            config.compare.interval = std::stoull(argv[++i]);
+        } else if (arg == "--compare_interval_insns" && i + 1 < argc) {
+            config.compare.interval = std::stoull(argv[++i]);
+            config.compare.intervalInstructions = true;
+        } else if (arg == "--compare_top_pcs" && i + 1 < argc) {
+            config.compare.topPcs = std::stoull(argv[++i]);
+        } else if (arg == "-" || arg[0] != '-') {
+            // Assume this is a trace file ("-" streams from stdin)
+            config.traceFiles.push_back(arg);
         } else {
             cerr << "Unknown option: " << arg << '\n';
             exit(1);
         }
     }
+}
+
+SimConfig ParseArgs(int argc, char* argv[]) {
+    SimConfig config;
+
+    // Default values are already set in the SimConfig struct
+    ParseOptions(argc, argv, config);
 
-    if (config.traceFile.empty()) {
+    if (config.traceFiles.empty()) {
         cerr << "Error: No trace file specified" << '\n';
         exit(1);
     }
+    config.traceFile = config.traceFiles[0];
+    if (std::count(config.traceFiles.begin(), config.traceFiles.end(), "-") >
+        1) {
+        cerr << "Error: Only one trace can be read from stdin" << '\n';
+        exit(1);
+    }
+    if (!config.sched.weights.empty() &&
+        config.sched.weights.size() != config.traceFiles.size()) {
+        cerr << "Error: --weights needs one weight per trace file" << '\n';
+        exit(1);
+    }
+    if (config.compare.interval == 0) {
+        cerr << "Error: --compare_interval and --compare_interval_insns "
+                "must be positive"
+             << '\n';
+        exit(1);
+    }
+    // A zero slice would never advance the round-robin schedule
+    if (config.sched.quantum == 0 ||
+        std::count(config.sched.weights.begin(), config.sched.weights.end(),
+                   0) > 0) {
+        cerr << "Error: --quantum and --weights must be positive" << '\n';
+        exit(1);
+    }
+    ValidateSimConfigOrExit(config);
 
     return config;
 }
 
+// Configurations of the --variant options: the base configuration with the
+// variant's options applied. Only simulated machine options are taken;
+// trace files, filters, scheduling, batch size, event log and comparison
+// options are those of the base run, so a variant naming them is an error.
+std::vector<SimConfig> ParseVariants(const SimConfig& config) {
+    std::vector<SimConfig> variants;
+    for (const std::string& options : config.compare.variants) {
+        std::vector<std::string> words = {"variant"};
+        std::stringstream stream(options);
+        std::string word;
+        while (stream >> word) {
+            words.push_back(word);
+        }
+        std::vector<char*> args;
+        for (std::string& w : words) {
+            args.push_back(&w[0]);
+        }
+
+        SimConfig variant = config;
+        int argc = args.size();
+        for (int i = 1; i < argc; i++) {
+            if (!ParseSimOptionOrExit(argc, args.data(), i, variant)) {
+                cerr << "Error: --variant takes configuration options only: "
+                     << options << '\n';
+                exit(1);
+            }
+        }
+        ValidateSimConfigOrExit(variant);
+        variants.push_back(variant);
+    }
+    return variants;
+}
+
 // --- Main Function ---
 int main(int argc, char* argv[]) {
     cout << "Memory Hierarchy Offline Analyzer" << '\n';
@@ -314,19 +761,29 @@ int main(int argc, char* argv[]) {
 
     // Parse command line arguments
     SimConfig config = ParseArgs(argc, argv);
+    std::vector<SimConfig> variants = ParseVariants(config);
 
     // Print configuration
     config.Print();
 
-    // Create and run the offline analyzer
-    OfflineAnalyzer analyzer(config);
-    if (!analyzer.Run()) {
-        cerr << "Error during analysis" << '\n';
+    // Large structures built by the analyzer follow the huge page policy
+    SetHugePagePolicy(config.hugePages);
+
+    // Create and run the offline analyzer; the simulated machine throws
+    // when it runs out of physical memory
+    try {
+        OfflineAnalyzer analyzer(config, variants);
+        if (!analyzer.Run()) {
+            cerr << "Error during analysis" << '\n';
+            return 1;
+        }
+
+        // Print final statistics
+        analyzer.PrintStats();
+    } catch (const std::runtime_error& e) {
+        cerr << "Error: " << e.what() << '\n';
         return 1;
     }
 
-    // Print final statistics
-    analyzer.PrintStats();
-
     return 0;
 }
\ No newline at end of file
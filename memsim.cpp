@@ -0,0 +1,269 @@
+// memsim.cpp
+// Simulator library (memsim.h) and its C interface (memsim_c.h)
+#include "memsim.h"
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include "huge_page.h"
+#include "sim_options.h"
+#include "simulator.h"
+
+static_assert(sizeof(memsim_memref) == sizeof(MEMREF) &&
+                  offsetof(memsim_memref, pc) == offsetof(MEMREF, pc) &&
+                  offsetof(memsim_memref, ea) == offsetof(MEMREF, ea) &&
+                  offsetof(memsim_memref, size) == offsetof(MEMREF, size) &&
+                  offsetof(memsim_memref, read) == offsetof(MEMREF, read) &&
+                  offsetof(memsim_memref, flags) == offsetof(MEMREF, flags),
+              "memsim_memref must match the MEMREF layout");
+
+struct MemorySimulator::Impl {
+    SimConfig config;
+    std::unique_ptr<Simulator> sim;
+    std::vector<ADDRINT> paddrs;  // Scratch when the caller wants none
+    UINT64 accesses = 0;
+
+    // Snapshot journal: accesses, and address space switches with the
+    // number of accesses before them
+    bool journaling;
+    std::vector<MEMREF> refs;
+    std::vector<std::pair<UINT64, UINT64>> switches;
+
+    UINT64 statsInterval = 0;
+    UINT64 nextStats = 0;
+    std::function<void(const memsim_stats&)> statsCallback;
+
+    Impl(const SimConfig& simConfig, bool snapshots)
+        : config(simConfig),
+          sim(new Simulator(simConfig)),
+          journaling(snapshots) {}
+
+    void Process(const MEMREF* buffer, UINT64 count, ADDRINT* out) {
+        if (!out) {
+            paddrs.resize(std::min<UINT64>(config.batchSize, count));
+        }
+        for (UINT64 i = 0; i < count; i += config.batchSize) {
+            UINT64 n = std::min<UINT64>(config.batchSize, count - i);
+            sim->ProcessBatch(buffer + i, n, out ? out + i : paddrs.data());
+        }
+        accesses += count;
+    }
+};
+
+MemorySimulator::MemorySimulator(const SimConfig& config, bool snapshots) {
+    ValidateSimConfig(config);
+    // Structures of the simulated machine follow the huge page policy
+    SetHugePagePolicy(config.hugePages);
+    impl_.reset(new Impl(config, snapshots));
+}
+
+MemorySimulator::~MemorySimulator() = default;
+
+SimConfig MemorySimulator::ParseConfig(const std::vector<std::string>& options) {
+    std::vector<std::string> words = options;
+    std::vector<char*> args;
+    for (std::string& word : words) {
+        args.push_back(&word[0]);
+    }
+
+    SimConfig config;
+    int argc = args.size();
+    for (int i = 0; i < argc; i++) {
+        std::string arg = words[i];
+        bool known;
+        try {
+            known = ParseSimOption(argc, args.data(), i, config);
+        } catch (const std::exception& e) {
+            throw std::invalid_argument("bad value for " + arg + ": " +
+                                        e.what());
+        }
+        if (!known) {
+            throw std::invalid_argument("unknown option or missing value: " +
+                                        arg);
+        }
+    }
+    return config;
+}
+
+void MemorySimulator::Access(const MEMREF* refs, UINT64 count,
+                             ADDRINT* paddrs) {
+    if (impl_->journaling) {
+        impl_->refs.insert(impl_->refs.end(), refs, refs + count);
+    }
+    impl_->Process(refs, count, paddrs);
+
+    if (impl_->statsInterval > 0 && impl_->accesses >= impl_->nextStats) {
+        impl_->nextStats = (impl_->accesses / impl_->statsInterval + 1) *
+                           impl_->statsInterval;
+        impl_->statsCallback(GetStats());
+    }
+}
+
+void MemorySimulator::SwitchAddressSpace(UINT64 asid) {
+    if (impl_->journaling) {
+        impl_->switches.emplace_back(impl_->refs.size(), asid);
+    }
+    impl_->sim->SwitchAddressSpace(asid);
+}
+
+memsim_stats MemorySimulator::GetStats() const {
+    const Simulator& sim = *impl_->sim;
+    const TranslationStats& ts = sim.pageTable.GetTranslationStats();
+    const CacheHierarchy& caches = sim.cacheHierarchy;
+
+    memsim_stats stats = {};
+    stats.accesses = impl_->accesses;
+    stats.l1_tlb_hits = ts.l1TlbHits;
+    stats.victim_tlb_hits = ts.victimTlbHits;
+    stats.l2_tlb_hits = ts.l2TlbHits;
+    stats.pmd_pwc_hits = ts.pmdCacheHits;
+    stats.pud_pwc_hits = ts.pudCacheHits;
+    stats.pgd_pwc_hits = ts.pgdCacheHits;
+    stats.full_walks = ts.fullWalks;
+    stats.walk_mem_accesses = ts.pageWalkMemAccess;
+    stats.l1_accesses = caches.GetCache(1).GetAccesses();
+    stats.l1_hits = caches.GetCache(1).GetHits();
+    stats.l2_accesses = caches.GetCache(2).GetAccesses();
+    stats.l2_hits = caches.GetCache(2).GetHits();
+    stats.l3_accesses = caches.GetCache(3).GetAccesses();
+    stats.l3_hits = caches.GetCache(3).GetHits();
+    stats.mem_accesses = caches.memAccessCount;
+    stats.cycles = caches.GetTotalCycles();
+    stats.page_tables = sim.pageTable.GetNumPageTables();
+    stats.allocated_frames = sim.physicalMemory.GetAllocatedFrames();
+    return stats;
+}
+
+void MemorySimulator::PrintStats(std::ostream& os) const {
+    impl_->sim->pageTable.PrintDetailedStats(os);
+    impl_->sim->pageTable.PrintMemoryStats(os);
+    impl_->sim->cacheHierarchy.PrintStats(os);
+}
+
+void MemorySimulator::SetStatsCallback(
+    UINT64 interval, std::function<void(const memsim_stats&)> callback) {
+    impl_->statsInterval = callback ? interval : 0;
+    impl_->statsCallback = std::move(callback);
+    if (impl_->statsInterval > 0) {
+        impl_->nextStats = (impl_->accesses / interval + 1) * interval;
+    }
+}
+
+UINT64 MemorySimulator::Snapshot() const {
+    if (!impl_->journaling) {
+        throw std::logic_error("simulator created without snapshots");
+    }
+    // Journal position: accesses plus address space switches
+    return impl_->refs.size() + impl_->switches.size();
+}
+
+void MemorySimulator::Restore(UINT64 snapshot) {
+    if (snapshot > Snapshot()) {
+        throw std::out_of_range("snapshot " + std::to_string(snapshot) +
+                                " is past the end of the journal");
+    }
+
+    Impl& impl = *impl_;
+    impl.sim.reset();
+    impl.sim.reset(new Simulator(impl.config));
+    impl.accesses = 0;
+
+    // Replay accesses in runs between address space switches
+    UINT64 refsDone = 0;
+    UINT64 switchesDone = 0;
+    while (refsDone + switchesDone < snapshot) {
+        if (switchesDone < impl.switches.size() &&
+            impl.switches[switchesDone].first == refsDone) {
+            impl.sim->SwitchAddressSpace(impl.switches[switchesDone].second);
+            switchesDone++;
+            continue;
+        }
+        UINT64 end = switchesDone < impl.switches.size()
+                         ? impl.switches[switchesDone].first
+                         : impl.refs.size();
+        end = std::min(end, snapshot - switchesDone);
+        impl.Process(impl.refs.data() + refsDone, end - refsDone, nullptr);
+        refsDone = end;
+    }
+    impl.refs.resize(refsDone);
+    impl.switches.resize(switchesDone);
+
+    if (impl.statsInterval > 0) {
+        impl.nextStats =
+            (impl.accesses / impl.statsInterval + 1) * impl.statsInterval;
+    }
+}
+
+// --- C interface ---
+
+struct memsim {
+    MemorySimulator sim;
+    memsim(const SimConfig& config, bool snapshots) : sim(config, snapshots) {}
+};
+
+static thread_local std::string lastError;
+
+// Run call, turning exceptions into -1 and memsim_last_error()
+template <typename Call>
+static int Guard(Call call) {
+    try {
+        call();
+        return 0;
+    } catch (const std::exception& e) {
+        lastError = e.what();
+    } catch (...) {
+        lastError = "unknown error";
+    }
+    return -1;
+}
+
+extern "C" {
+
+memsim* memsim_create(int argc, const char* const* argv, int snapshots) {
+    memsim* sim = nullptr;
+    Guard([&] {
+        std::vector<std::string> options(argv, argv + argc);
+        sim = new memsim(MemorySimulator::ParseConfig(options), snapshots != 0);
+    });
+    return sim;
+}
+
+void memsim_destroy(memsim* sim) { delete sim; }
+
+const char* memsim_last_error(void) { return lastError.c_str(); }
+
+int memsim_access(memsim* sim, const memsim_memref* refs, uint64_t count) {
+    return Guard([&] {
+        sim->sim.Access(reinterpret_cast<const MEMREF*>(refs), count);
+    });
+}
+
+int memsim_switch_address_space(memsim* sim, uint64_t asid) {
+    return Guard([&] { sim->sim.SwitchAddressSpace(asid); });
+}
+
+void memsim_get_stats(const memsim* sim, memsim_stats* stats) {
+    *stats = sim->sim.GetStats();
+}
+
+void memsim_set_stats_callback(memsim* sim, uint64_t interval,
+                               memsim_stats_callback callback, void* user) {
+    if (!callback) {
+        sim->sim.SetStatsCallback(0, nullptr);
+        return;
+    }
+    sim->sim.SetStatsCallback(
+        interval, [callback, user](const memsim_stats& stats) {
+            callback(&stats, user);
+        });
+}
+
+int memsim_snapshot(memsim* sim, uint64_t* snapshot) {
+    return Guard([&] { *snapshot = sim->sim.Snapshot(); });
+}
+
+int memsim_restore(memsim* sim, uint64_t snapshot) {
+    return Guard([&] { sim->sim.Restore(snapshot); });
+}
+
+}  // extern "C"
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "memsim_c.h"
+
+// Library interface to one simulated machine: push MEMREF batches, read or
+// stream the counters, snapshot and rewind. The implementation lives in
+// memsim.cpp so embedders only see this header and memsim_c.h.
+class MemorySimulator {
+   public:
+    // Snapshots journal every access (24 bytes each) from construction on;
+    // Restore rebuilds the machine and replays the journal up to the
+    // snapshot, so it costs as much as the accesses it replays. An
+    // inconsistent config throws std::invalid_argument
+    explicit MemorySimulator(const SimConfig& config, bool snapshots = false);
+    ~MemorySimulator();
+
+    MemorySimulator(const MemorySimulator&) = delete;
+    MemorySimulator& operator=(const MemorySimulator&) = delete;
+
+    // Configuration from the offline analyzer's machine options, e.g.
+    // {"--l2_tlb_size", "2048"}; throws std::invalid_argument
+    static SimConfig ParseConfig(const std::vector<std::string>& options);
+
+    // Translate and access a batch; the physical addresses go to paddrs
+    // when given. Throws std::runtime_error once physical memory runs out
+    void Access(const MEMREF* refs, UINT64 count, ADDRINT* paddrs = nullptr);
+    void SwitchAddressSpace(UINT64 asid);
+
+    memsim_stats GetStats() const;
+    // Translation, page table and cache reports of the offline analyzer
+    void PrintStats(std::ostream& os) const;
+
+    // Call callback at the end of the first batch after every interval
+    // accesses; an interval of 0 stops the stream
+    void SetStatsCallback(UINT64 interval,
+                          std::function<void(const memsim_stats&)> callback);
+
+    // Position to rewind to; throws std::logic_error without snapshots
+    UINT64 Snapshot() const;
+    // Rewind to a snapshot, dropping the later journal (and its snapshots)
+    void Restore(UINT64 snapshot);
+
+   private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
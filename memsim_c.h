@@ -0,0 +1,73 @@
+#pragma once
+
+/* C interface of the simulator library (see memsim.h for the C++ one). A
+ * memsim handle is one simulated machine configured with the offline
+ * analyzer's machine options; functions returning int give 0 on success
+ * and -1 on error, with the reason in memsim_last_error(). */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct memsim memsim;
+
+/* Same layout as the trace record (MEMREF) */
+typedef struct memsim_memref {
+    uint64_t pc;
+    uint64_t ea;
+    uint32_t size;
+    uint16_t read;
+    uint16_t flags; /* MemRefFlag bits (common.h) */
+} memsim_memref;
+
+/* Counters since creation (or the restored snapshot) */
+typedef struct memsim_stats {
+    uint64_t accesses;
+    uint64_t l1_tlb_hits;
+    uint64_t victim_tlb_hits;
+    uint64_t l2_tlb_hits;
+    uint64_t pmd_pwc_hits;
+    uint64_t pud_pwc_hits;
+    uint64_t pgd_pwc_hits;
+    uint64_t full_walks;
+    uint64_t walk_mem_accesses;
+    uint64_t l1_accesses;
+    uint64_t l1_hits;
+    uint64_t l2_accesses;
+    uint64_t l2_hits;
+    uint64_t l3_accesses;
+    uint64_t l3_hits;
+    uint64_t mem_accesses;
+    uint64_t cycles;
+    uint64_t page_tables;
+    uint64_t allocated_frames;
+} memsim_stats;
+
+typedef void (*memsim_stats_callback)(const memsim_stats* stats, void* user);
+
+/* Create a machine from options such as {"--l2_tlb_size", "2048"}; with
+ * snapshots set, accesses are journaled so memsim_restore can rewind.
+ * Returns NULL on error. */
+memsim* memsim_create(int argc, const char* const* argv, int snapshots);
+void memsim_destroy(memsim* sim);
+
+/* Message of the last failed call on this thread */
+const char* memsim_last_error(void);
+
+int memsim_access(memsim* sim, const memsim_memref* refs, uint64_t count);
+int memsim_switch_address_space(memsim* sim, uint64_t asid);
+void memsim_get_stats(const memsim* sim, memsim_stats* stats);
+
+/* Call callback at the end of the first batch after every interval
+ * accesses; an interval of 0 or a NULL callback stops the stream */
+void memsim_set_stats_callback(memsim* sim, uint64_t interval,
+                               memsim_stats_callback callback, void* user);
+
+int memsim_snapshot(memsim* sim, uint64_t* snapshot);
+int memsim_restore(memsim* sim, uint64_t snapshot);
+
+#ifdef __cplusplus
+}
+#endif
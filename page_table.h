@@ -6,13 +6,18 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "common.h"
 #include "data_cache.h"
+#include "event_log.h"
+#include "huge_page.h"
 #include "physical_memory.h"
 #include "pwc.h"
 #include "tlb.h"
 
-// Page Table Entry
+// Page Table Entry, the simulated in-memory format (the simulator stores only
+// the PFN, see PageTable::EntrySlot)
 struct PageTableEntry {
     UINT64 present : 1;   // Present bit
     UINT64 writable : 1;  // Writable bit
@@ -23,17 +28,94 @@ struct PageTableEntry {
     PageTableEntry() : present(0), writable(0), user(0), pfn(0), unused(0) {}
 };
 
+// Page walks and the walk references that went to memory, charged to the PC
+// of the access that walked
+struct PcWalkStats {
+    UINT64 walks = 0;
+    UINT64 memAccesses = 0;
+};
+
+constexpr UINT64 kFillBuckets = 12;  // Buckets of the table fill histogram
+
+// Statistics of one page table level
+struct PageTableLevelStats {
+    std::string name;    // Level name
+    UINT8 level;         // 0 = PGD .. 3 = PTE
+    UINT64 accesses;     // Number of times this level was accessed
+    UINT64 allocations;  // Number of tables allocated at this level
+    UINT64 entries;      // Number of entries used at this level
+    UINT64 size;         // Size of the table at this level
+    // Tables by fill: empty, <=1%, then <=10%, <=20%, ... <=100%
+    UINT64 fillHistogram[kFillBuckets] = {};
+
+    PageTableLevelStats(const std::string& levelName, UINT8 tableLevel,
+                        UINT64 tableSize)
+        : name(levelName),
+          level(tableLevel),
+          accesses(0),
+          allocations(0),
+          entries(0),
+          size(tableSize) {}
+
+    // Histogram bucket of a table holding the given number of entries
+    UINT64 FillBucket(UINT64 tableEntries) const {
+        if (tableEntries == 0) {
+            return 0;
+        }
+        if (tableEntries * 100 <= size) {
+            return 1;
+        }
+        return 1 + (tableEntries * 10 + size - 1) / size;
+    }
+};
+
 // Page Table (4-level) with PWCs and two-level TLB
 class PageTable {
    private:
-    std::unordered_map<UINT64, std::unique_ptr<PageTableEntry[]>> pageTables_;
+    // Host storage of the simulated tables: each table is an array of
+    // pointers to chunks of kTableChunkEntries 32-bit PFNs, created on first
+    // use. PFN 0 (the frame reserved for null detection) marks a non-present
+    // entry, so sparse tables cost a few hundred bytes instead of a page.
+    static constexpr UINT64 kTableChunkEntries = 64;
+    HugePageArena tableArena_;  // Backing store of every table
+    struct TableStore {
+        UINT32** chunks = nullptr;  // Chunk pointers, created on first use
+        UINT64 entries = 0;         // Present entries
+    };
+    std::unordered_map<UINT64, TableStore> pageTables_;  // By table paddr
     UINT64 cr3_;                 // Page table base register (points to PGD)
+    std::vector<UINT64> roots_;  // PGD base of each address space, by ASID
+    UINT64 asidTag_;             // Current ASID, pre-shifted for TLB tags
     PhysicalMemory& physMem_;    // Reference to physical memory
     CacheHierarchy& dataCache_;  // Reference to data cache
     bool isPteCachable_;         // PTE cacheable flag
+    UINT64 walkPrefetchLines_;   // Target lines prefetched after a walk
+    UINT64 walkPrefetchLevel_;   // Cache level the walk prefetch fills
     // Two-level TLB
     TLB l1Tlb_;  // L1 TLB (smaller, faster)
     TLB l2Tlb_;  // L2 TLB (larger, slower)
+    std::unique_ptr<TLB> victimTlb_;  // Fully-associative L1 victim TLB
+    TlbInclusion tlbInclusion_;       // L1/L2 TLB content relationship
+    std::unique_ptr<TlbDeadEntryPredictor> l2TlbPredictor_;  // L2 bypass
+    UINT64 tlbBackInvalidations_;  // L1 entries dropped by L2 evictions
+
+    // Physical placement of page-table pages
+    PageTablePlacement tablePlacement_;
+    UINT64 regionNextFrame_;  // Next free frame of the reserved region
+    UINT64 regionEndFrame_;   // One past the last reserved frame
+    UINT64 colocateFrames_;   // Frames per sibling-table block
+    // Per parent table, next free frame and frames left in its block
+    std::unordered_map<UINT64, std::pair<UINT64, UINT64>> siblingBlocks_;
+    UINT64 placementFallbacks_;  // Tables placed outside a full region
+    std::unordered_set<UINT64> tableRegions_;  // 2MB regions holding tables
+
+    // Locality of consecutive walk references to each level (PGD..PTE)
+    static constexpr UINT64 kWalkRefLineShift = 6;     // 64B lines
+    static constexpr UINT64 kWalkRefRegionShift = 21;  // 2MB regions
+    UINT64 lastWalkRef_[4] = {};
+    UINT64 walkRefs_[4] = {};
+    UINT64 walkRefsSameLine_[4] = {};
+    UINT64 walkRefsSameRegion_[4] = {};
 
     // page table set up
     const UINT64 pgdEntryNum_;
@@ -58,21 +140,24 @@ class PageTable {
 
     // Statistics for page table translation
     TranslationStats translationStats_;
-    // Per-level statistics
-    struct PageTableLevelStats {
-        std::string name;    // Level name
-        UINT64 accesses;     // Number of times this level was accessed
-        UINT64 allocations;  // Number of tables allocated at this level
-        UINT64 entries;      // Number of entries used at this level
-        UINT64 size;         // Size of the table at this level
-
-        PageTableLevelStats(const std::string& levelName, UINT64 tableSize)
-            : name(levelName),
-              accesses(0),
-              allocations(0),
-              entries(0),
-              size(tableSize) {}
+    // Table count and footprint sampled at doubling translation counts
+    struct GrowthSample {
+        UINT64 translations;
+        UINT64 tables;
+        UINT64 mappedPages;
     };
+    std::vector<GrowthSample> growthSamples_;
+    UINT64 nextGrowthSample_;
+
+    // Optional per-PC walk accounting
+    bool pcWalkStatsEnabled_ = false;
+    std::unordered_map<ADDRINT, PcWalkStats> pcWalkStats_;
+    UINT64 walkStartMemAccess_ = 0;  // pageWalkMemAccess when the walk began
+
+    // Optional dirty bits: the first write to a page (ASID-tagged VPN) sets
+    // its PTE dirty bit, another PTE read unless that write walked
+    bool trackDirty_ = false;
+    std::unordered_set<UINT64> dirtyPages_;
 
     // Statistics for each level
     PageTableLevelStats pgdStats_;
@@ -80,6 +165,10 @@ class PageTable {
     PageTableLevelStats pmdStats_;
     PageTableLevelStats pteStats_;
 
+    // Optional translation event log
+    TranslationEventSink* eventSink_;
+    UINT64 eventTranslation_;  // Index of the translation being logged
+
    public:
     PageTable(PhysicalMemory& physicalMemory, CacheHierarchy& dataCache,
               bool isPteCachable = true, UINT64 l1TlbSize = 64,
@@ -91,11 +180,21 @@ class PageTable {
               UINT64 pudEntryNum = 512, UINT64 pmdEntryNum = 512,
               UINT64 pteEntryNum = 512, bool tocEnabled = false,
               UINT64 tocSize = 0)
-        : physMem_(physicalMemory),
+        : asidTag_(0),
+          physMem_(physicalMemory),
           dataCache_(dataCache),
           isPteCachable_(isPteCachable),
+          walkPrefetchLines_(0),
+          walkPrefetchLevel_(2),
           l1Tlb_("L1 TLB", l1TlbSize, l1TlbWays),
           l2Tlb_("L2 TLB", l2TlbSize, l2TlbWays),
+          tlbInclusion_(kTlbNine),
+          tlbBackInvalidations_(0),
+          tablePlacement_(kPtInterleaved),
+          regionNextFrame_(0),
+          regionEndFrame_(0),
+          colocateFrames_(0),
+          placementFallbacks_(0),
           pgdEntryNum_(pgdEntryNum),
           pudEntryNum_(pudEntryNum),
           pmdEntryNum_(pmdEntryNum),
@@ -108,16 +207,18 @@ class PageTable {
           pudPwc_("PDPTE Cache (PUD)", pudPwcSize, pudPwcWays, pudShift_, 47),
           pmdPwc_("PDE Cache (PMD)", pmdPwcSize, pmdPwcWays, pmdShift_, 47),
           translationStats_(),
-          pgdStats_("PGD (Page Global Directory)", pgdEntryNum),
-          pudStats_("PUD (Page Upper Directory)", pudEntryNum),
-          pmdStats_("PMD (Page Middle Directory)", pmdEntryNum),
-          pteStats_("PTE (Page Table Entry)", pteEntryNum) {
-        // Allocate the root page table (PGD)
-        cr3_ = physMem_.AllocateFrame() * kMemTracePageSize;
-        pageTables_[cr3_] = std::make_unique<PageTableEntry[]>(pgdEntryNum);
-        // memset all entries to 0
-        std::fill_n(pageTables_[cr3_].get(), pgdEntryNum, PageTableEntry());
-        pgdStats_.allocations++;
+          nextGrowthSample_(1024),
+          pgdStats_("PGD (Page Global Directory)", 0, pgdEntryNum),
+          pudStats_("PUD (Page Upper Directory)", 1, pudEntryNum),
+          pmdStats_("PMD (Page Middle Directory)", 2, pmdEntryNum),
+          pteStats_("PTE (Page Table Entry)", 3, pteEntryNum),
+          eventSink_(nullptr),
+          eventTranslation_(0) {
+        // PFNs are stored in 32 bits; ValidateSimConfig rejects larger
+        // memories, this only backs it up
+        assert(physicalMemory.GetTotalFrames() <= (1ULL << 32));
+        // Allocate the root page table (PGD) of address space 0
+        cr3_ = AllocateRoot();
         // assert that the page table entry is power of 2
         assert((pgdEntryNum & (pgdEntryNum - 1)) == 0);
         assert((pudEntryNum & (pudEntryNum - 1)) == 0);
@@ -138,6 +239,34 @@ class PageTable {
         }
     }
 
+    // Switch to the address space of the given ASID, creating its PGD on
+    // first use. TLBs and PWCs are shared and keep entries of all ASIDs.
+    void SwitchAddressSpace(UINT64 asid) {
+        if (asid == (asidTag_ >> kAsidTagShift)) {
+            return;
+        }
+        while (roots_.size() <= asid) {
+            AllocateRoot();
+        }
+        cr3_ = roots_[asid];
+        asidTag_ = asid << kAsidTagShift;
+        l2Tlb_.SetClassOfService(asid);
+        pgdPwc_.SetAsid(asid);
+        pudPwc_.SetAsid(asid);
+        pmdPwc_.SetAsid(asid);
+    }
+
+    // Way masks of the shared L2 TLB, one per ASID
+    void SetL2TlbWayMasks(const std::vector<UINT64>& masks) {
+        for (UINT64 asid = 0; asid < masks.size(); ++asid) {
+            l2Tlb_.SetWayMask(asid, masks[asid]);
+        }
+        l2Tlb_.SetClassOfService(GetAsid());
+    }
+
+    UINT64 GetAsid() const { return asidTag_ >> kAsidTagShift; }
+    UINT64 GetNumAddressSpaces() const { return roots_.size(); }
+
     // Get indexes into the page tables for a given virtual address
     UINT64 GetPgdIndex(ADDRINT vaddr) const {
         return (vaddr >> pgdShift_) & pgdMask_;
@@ -169,19 +298,14 @@ class PageTable {
         UINT64 pteEntryAddr = pteAddr + (pteIndex * entrySize);
 
         // Cache Lookup for PTE entry (if cacheable)
-        bool hit = false;
-        UINT64 pteEntryValue = 0;
-        if (isPteCachable_)
-            hit = dataCache_.TranslateLookup(pteEntryAddr, pteEntryValue,
-                                             translationStats_);
-        PageTableEntry& pteEntry = pageTables_[pteAddr][pteIndex];
+        bool hit = WalkLookup(3, pteEntryAddr, kPageTableLine);
+        UINT32& ptePfn = EntrySlot(pteAddr, pteIndex, pteEntryNum_);
 
         // Allocate physical page if not present
-        if (!pteEntry.present) {
-            pteEntry.present = 1;
-            pteEntry.writable = 1;
-            pteEntry.pfn = physMem_.AllocateFrame();
-            pteStats_.entries++;
+        if (ptePfn == 0) {
+            ptePfn = physMem_.AllocateFrame();
+            LogEvent(kEventPageAlloc, (UINT64)ptePfn << kPageShift, 3);
+            AddEntry(pteAddr, pteStats_);
             // assert(!hit);
         }
 
@@ -197,7 +321,7 @@ class PageTable {
         }
 
         // Return physical address
-        return (pteEntry.pfn << kPageShift) | offset;
+        return ((UINT64)ptePfn << kPageShift) | offset;
     }
 
     // Complete translation from PMD level - used by PUD PWC hit path
@@ -208,28 +332,15 @@ class PageTable {
         // Access the PMD table
         UINT64 entrySize = kMemTracePageSize / pmdEntryNum_;
         UINT64 pmdEntryAddr = pmdAddr + (pmdIndex * entrySize);
-        // first access data cache
-        UINT64 pmdEntryValue = 0;
         // Cache Lookup for PMD entry (if cacheable)
-        bool hit = false;
-        if (isPteCachable_)
-            hit = dataCache_.TranslateLookup(pmdEntryAddr, pmdEntryValue,
-                                             translationStats_);
+        bool hit = WalkLookup(2, pmdEntryAddr, kPageTableLine);
 
-        PageTableEntry& pmdEntry = pageTables_[pmdAddr][pmdIndex];
+        UINT32& pmdPfn = EntrySlot(pmdAddr, pmdIndex, pmdEntryNum_);
         // Allocate PTE if not present
-        if (!pmdEntry.present) {
-            pmdEntry.present = 1;
-            pmdEntry.writable = 1;
-            pmdEntry.pfn = physMem_.AllocateFrame();
-            UINT64 pteAddr = pmdEntry.pfn * kMemTracePageSize;
-            pageTables_[pteAddr] =
-                std::make_unique<PageTableEntry[]>(pteEntryNum_);
-            // memset all entries to 0
-            std::fill_n(pageTables_[pteAddr].get(), pteEntryNum_,
-                        PageTableEntry());
-            pteStats_.allocations++;
-            pmdStats_.entries++;
+        if (pmdPfn == 0) {
+            pmdPfn = AllocateTableFrame(pmdAddr);
+            AllocateTable((UINT64)pmdPfn * kMemTracePageSize, pteStats_);
+            AddEntry(pmdAddr, pmdStats_);
             // assert(!hit);
         }
         if (hit) {
@@ -243,10 +354,10 @@ class PageTable {
         }
 
         // Insert into PMD PWC
-        pmdPwc_.Insert(vaddr, pmdEntry.pfn);
+        pmdPwc_.Insert(vaddr, pmdPfn);
 
         // Complete the translation
-        return CompletePmdCacheHit(vaddr, pmdEntry.pfn);
+        return CompletePmdCacheHit(vaddr, pmdPfn);
     }
 
     // Complete translation from PUD level - used by PGD PWC hit path
@@ -257,27 +368,14 @@ class PageTable {
         // Access the PUD table
         UINT64 entrySize = kMemTracePageSize / pudEntryNum_;
         UINT64 pudEntryAddr = pudAddr + (pudIndex * entrySize);
-        // first access data cache
-        UINT64 pudEntryValue = 0;
-        bool hit = false;
         // Cache Lookup for PUD entry (if cacheable)
-        if (isPteCachable_)
-            hit = dataCache_.TranslateLookup(pudEntryAddr, pudEntryValue,
-                                             translationStats_);
-        PageTableEntry& pudEntry = pageTables_[pudAddr][pudIndex];
+        bool hit = WalkLookup(1, pudEntryAddr, kUpperPageTableLine);
+        UINT32& pudPfn = EntrySlot(pudAddr, pudIndex, pudEntryNum_);
         // Allocate PMD if not present
-        if (!pudEntry.present) {
-            pudEntry.present = 1;
-            pudEntry.writable = 1;
-            pudEntry.pfn = physMem_.AllocateFrame();
-            UINT64 pmdAddr = pudEntry.pfn * kMemTracePageSize;
-            pageTables_[pmdAddr] =
-                std::make_unique<PageTableEntry[]>(pmdEntryNum_);
-            // memset all entries to 0
-            std::fill_n(pageTables_[pmdAddr].get(), pmdEntryNum_,
-                        PageTableEntry());
-            pmdStats_.allocations++;
-            pudStats_.entries++;
+        if (pudPfn == 0) {
+            pudPfn = AllocateTableFrame(pudAddr);
+            AllocateTable((UINT64)pudPfn * kMemTracePageSize, pmdStats_);
+            AddEntry(pudAddr, pudStats_);
         }
 
         if (hit) {
@@ -291,10 +389,10 @@ class PageTable {
         }
 
         // Insert into PUD PWC
-        pudPwc_.Insert(vaddr, pudEntry.pfn);
+        pudPwc_.Insert(vaddr, pudPfn);
 
         // Complete the translation
-        return CompletePudCacheHit(vaddr, pudEntry.pfn);
+        return CompletePudCacheHit(vaddr, pudPfn);
     }
 
     // Complete a full page table walk
@@ -302,27 +400,14 @@ class PageTable {
         // Step 1: Get PGD entry
         UINT64 pgdIndex = GetPgdIndex(vaddr);
         UINT64 pgdAddr = cr3_ + (pgdIndex * sizeof(PageTableEntry));
-        // first access data cache
-        UINT64 pgdEntryValue = 0;
-        bool hit = false;
         // Cache Lookup for PGD entry (if cacheable)
-        if (isPteCachable_)
-            hit = dataCache_.TranslateLookup(pgdAddr, pgdEntryValue,
-                                             translationStats_);
-        PageTableEntry& pgdEntry = pageTables_[cr3_][pgdIndex];
+        bool hit = WalkLookup(0, pgdAddr, kUpperPageTableLine);
+        UINT32& pgdPfn = EntrySlot(cr3_, pgdIndex, pgdEntryNum_);
         // Allocate PUD if not present
-        if (!pgdEntry.present) {
-            pgdEntry.present = 1;
-            pgdEntry.writable = 1;
-            pgdEntry.pfn = physMem_.AllocateFrame();
-            UINT64 pudAddr = pgdEntry.pfn * kMemTracePageSize;
-            pageTables_[pudAddr] =
-                std::make_unique<PageTableEntry[]>(pudEntryNum_);
-            // memset all entries to 0
-            std::fill_n(pageTables_[pudAddr].get(), pudEntryNum_,
-                        PageTableEntry());
-            pudStats_.allocations++;
-            pgdStats_.entries++;
+        if (pgdPfn == 0) {
+            pgdPfn = AllocateTableFrame(cr3_);
+            AllocateTable((UINT64)pgdPfn * kMemTracePageSize, pudStats_);
+            AddEntry(cr3_, pgdStats_);
         }
         if (hit) {
             translationStats_.pteDataCacheHits++;
@@ -335,88 +420,398 @@ class PageTable {
         }
 
         // Insert into PGD PWC
-        pgdPwc_.Insert(vaddr, pgdEntry.pfn);
+        pgdPwc_.Insert(vaddr, pgdPfn);
 
         // Continue with PUD level
-        return CompletePgdCacheHit(vaddr, pgdEntry.pfn);
+        return CompletePgdCacheHit(vaddr, pgdPfn);
+    }
+
+    // Send translation events of subsequent translations to sink (or stop
+    // logging with nullptr)
+    void SetEventSink(TranslationEventSink* sink) { eventSink_ = sink; }
+
+    // Count walks and their memory references per PC from now on
+    void EnablePcWalkStats() { pcWalkStatsEnabled_ = true; }
+    const std::unordered_map<ADDRINT, PcWalkStats>& GetPcWalkStats() const {
+        return pcWalkStats_;
+    }
+
+    // Where tables allocated from now on are placed: a reserved contiguous
+    // region of regionFrames, blocks of colocateFrames shared by the
+    // children of one table, or a separate top-of-memory pool
+    void SetTablePlacement(PageTablePlacement placement, UINT64 regionFrames,
+                           UINT64 colocateFrames) {
+        tablePlacement_ = placement;
+        if (placement == kPtReserved) {
+            regionNextFrame_ = physMem_.ReserveFrames(regionFrames);
+            regionEndFrame_ = regionNextFrame_ + regionFrames;
+        }
+        colocateFrames_ = colocateFrames;
+        assert(placement != kPtColocated || colocateFrames > 0);
+    }
+
+    // Prefetch lines of the target page into the data caches once a walk
+    // completes (lines = 0 disables)
+    void SetWalkPrefetch(UINT64 lines, UINT64 level) {
+        assert(level == 2 || level == 3);
+        walkPrefetchLines_ = lines;
+        walkPrefetchLevel_ = level;
+    }
+
+    // L1/L2 TLB relationship, an optional victim TLB of victimEntries
+    // (fully associative) and optional PC-based L2 TLB bypass
+    void SetTlbPolicy(TlbInclusion inclusion, UINT64 victimEntries,
+                      bool l2Bypass) {
+        tlbInclusion_ = inclusion;
+        if (victimEntries > 0) {
+            victimTlb_ = std::make_unique<TLB>("Victim TLB", victimEntries,
+                                               victimEntries);
+        }
+        if (l2Bypass) {
+            l2TlbPredictor_ = std::make_unique<TlbDeadEntryPredictor>();
+            l2Tlb_.SetDeadEntryPredictor(l2TlbPredictor_.get());
+        }
+    }
+
+    // Range-limited tags (region registers + offset) in the TLBs and PWCs;
+    // 0 regions keeps full tags in that kind of structure
+    void SetTagRegions(UINT64 tlbRegions, UINT64 tlbOffsetBits,
+                       UINT64 pwcRegions, UINT64 pwcOffsetBits) {
+        if (tlbRegions > 0) {
+            l1Tlb_.EnableTagRegions(tlbRegions, tlbOffsetBits);
+            l2Tlb_.EnableTagRegions(tlbRegions, tlbOffsetBits);
+            if (victimTlb_) {
+                victimTlb_->EnableTagRegions(tlbRegions, tlbOffsetBits);
+            }
+        }
+        if (pwcRegions > 0) {
+            pgdPwc_.EnableTagRegions(pwcRegions, pwcOffsetBits);
+            pudPwc_.EnableTagRegions(pwcRegions, pwcOffsetBits);
+            pmdPwc_.EnableTagRegions(pwcRegions, pwcOffsetBits);
+        }
+    }
+
+    // Fill the L1 TLB, moving its victim to the victim TLB and, in
+    // exclusive mode, whatever falls out of L1 (or the victim TLB) to L2
+    void FillL1Tlb(UINT64 vpn, UINT64 pfn) {
+        UINT64 evictedVpn, evictedPfn;
+        l1Tlb_.Insert(vpn, pfn);
+        if (!l1Tlb_.TakeEviction(evictedVpn, evictedPfn)) {
+            return;
+        }
+        if (victimTlb_) {
+            victimTlb_->Insert(evictedVpn, evictedPfn);
+            if (!victimTlb_->TakeEviction(evictedVpn, evictedPfn)) {
+                return;
+            }
+        }
+        if (tlbInclusion_ == kTlbExclusive) {
+            FillL2Tlb(evictedVpn, evictedPfn, 0);
+        }
+    }
+
+    // Fill the L2 TLB unless the bypass predictor marks the fill dead; in
+    // inclusive mode an L2 eviction invalidates the L1 copy
+    void FillL2Tlb(UINT64 vpn, UINT64 pfn, ADDRINT pc) {
+        UINT16 signature = TlbDeadEntryPredictor::Signature(pc);
+        // Skipping L2 would break inclusion, so only NINE may bypass
+        if (l2TlbPredictor_ && tlbInclusion_ == kTlbNine &&
+            l2TlbPredictor_->ShouldBypass(signature)) {
+            return;
+        }
+        l2Tlb_.Insert(vpn, pfn, signature);
+        if (tlbInclusion_ != kTlbInclusive) {
+            return;
+        }
+        // Entries leaving L2, by eviction or with a replaced tag region,
+        // leave the upper levels too
+        UINT64 evictedVpn, evictedPfn;
+        if (l2Tlb_.TakeEviction(evictedVpn, evictedPfn)) {
+            BackInvalidate(evictedVpn);
+        }
+        for (UINT64 droppedVpn : l2Tlb_.GetDroppedVpns()) {
+            BackInvalidate(droppedVpn);
+        }
+    }
+
+    // Drop an entry from the TLB levels above the inclusive L2 TLB
+    void BackInvalidate(UINT64 vpn) {
+        bool dropped = l1Tlb_.Invalidate(vpn);
+        if (victimTlb_) {
+            dropped |= victimTlb_->Invalidate(vpn);
+        }
+        tlbBackInvalidations_ += dropped;
+    }
+
+    // Install a walked translation and trigger the optional data prefetch
+    ADDRINT FinishWalk(UINT64 vpn, ADDRINT paddr, ADDRINT pc) {
+        UINT64 pfn = paddr >> kPageShift;
+        FillL1Tlb(vpn, pfn);
+        if (tlbInclusion_ != kTlbExclusive) {
+            FillL2Tlb(vpn, pfn, pc);
+        }
+        if (walkPrefetchLines_ > 0) {
+            dataCache_.PrefetchLines(paddr, walkPrefetchLines_,
+                                     walkPrefetchLevel_, kWalkPrefetch);
+        }
+        if (pcWalkStatsEnabled_) {
+            PcWalkStats& stats = pcWalkStats_[pc];
+            stats.walks++;
+            stats.memAccesses +=
+                translationStats_.pageWalkMemAccess - walkStartMemAccess_;
+        }
+        // Tables only grow on walks, so sampling here is exact enough
+        UINT64 translations = translationStats_.GetTotalTranslation();
+        if (translations >= nextGrowthSample_) {
+            growthSamples_.push_back(
+                {translations, pageTables_.size(), pteStats_.entries});
+            // Skip the boundaries passed without a walk
+            while (translations >= nextGrowthSample_) {
+                nextGrowthSample_ *= 2;
+            }
+        }
+        return paddr;
     }
 
-    // Translate a virtual address to physical address
-    ADDRINT Translate(ADDRINT vaddr) {
-        // Extract the virtual page number and page offset
-        UINT64 vpn = vaddr >> kPageShift;
+    // Update PTE dirty bits on the first write to each page
+    void EnableDirtyTracking() { trackDirty_ = true; }
+
+    // Translate a virtual address to physical address; pc (if known) keys
+    // the L2 TLB bypass predictor
+    ADDRINT Translate(ADDRINT vaddr, ADDRINT pc = 0, bool isWrite = false) {
+        // Extract the virtual page number (tagged with the ASID) and offset
+        UINT64 vpn = (vaddr >> kPageShift) | asidTag_;
         UINT64 offset = GetOffset(vaddr);
 
         // 1. Check L1 TLB first (fastest)
         UINT64 pfn;
+        ADDRINT paddr;
+        const bool setDirty =
+            isWrite && trackDirty_ && !dirtyPages_.count(vpn);
+        bool walked = false;
         if (l1Tlb_.Lookup(vpn, pfn)) {
             translationStats_.l1TlbHits++;
             // L1 TLB hit - combine PFN with offset
+            paddr = (pfn << kPageShift) | offset;
+        } else {
+            walked = setDirty && !IsTlbResident(vpn);
+            paddr = TranslateL1Miss(vaddr, vpn, pc);
+        }
+        if (setDirty) {
+            SetDirty(vaddr, vpn, walked);
+        }
+        return paddr;
+    }
+
+    // Translate a software prefetch into paddr. A prefetch to a page that
+    // is not mapped would fault, which the hardware drops instead: returns
+    // false without walking or allocating the page.
+    bool TranslatePrefetch(ADDRINT vaddr, ADDRINT pc, ADDRINT& paddr) {
+        UINT64 vpn = (vaddr >> kPageShift) | asidTag_;
+        if (!l1Tlb_.Contains(vpn) && !IsTlbResident(vpn) && !IsMapped(vaddr)) {
+            translationStats_.droppedPrefetches++;
+            return false;
+        }
+        paddr = Translate(vaddr, pc);
+        return true;
+    }
+
+    // Translate a batch of accesses into out, stopping before the first one
+    // that would walk the page table. Walks fill the data caches, so the
+    // caller must issue the data accesses translated so far before
+    // translating that access with Translate. Returns the number translated.
+    UINT64 TranslateBatch(const MEMREF* refs, UINT64 numRefs, ADDRINT* out) {
+        const UINT64 asidTag = asidTag_;
+        UINT64 l1Hits = 0;
+        UINT64 i = 0;
+        for (; i < numRefs; ++i) {
+            if (i + kBatchPrefetchDistance < numRefs) {
+                UINT64 aheadVpn =
+                    (refs[i + kBatchPrefetchDistance].ea >> kPageShift) |
+                    asidTag;
+                l1Tlb_.PrefetchSet(aheadVpn);
+                l2Tlb_.PrefetchSet(aheadVpn);
+            }
+            const ADDRINT vaddr = refs[i].ea;
+            UINT64 vpn = (vaddr >> kPageShift) | asidTag;
+            // Setting a dirty bit reads the PTE through the data caches too
+            if (trackDirty_ && !refs[i].read && !dirtyPages_.count(vpn)) {
+                break;
+            }
+            // One probe of the L1 TLB set; a miss that walks is left for
+            // Translate to count
+            UINT64 pfn;
+            if (l1Tlb_.Probe(vpn, pfn)) {
+                l1Hits++;
+                out[i] = (pfn << kPageShift) | GetOffset(vaddr);
+                continue;
+            }
+            if (!IsTlbResident(vpn)) {
+                break;
+            }
+            l1Tlb_.CountMiss();
+            out[i] = TranslateL1Miss(vaddr, vpn, refs[i].pc);
+        }
+        translationStats_.l1TlbHits += l1Hits;
+        return i;
+    }
+
+   private:
+    // Set the dirty bit of the (already mapped) page of vaddr. A write that
+    // walked sets it on the PTE it just read; one that hit a TLB entry
+    // filled clean makes the walker read the PTE again to set it.
+    void SetDirty(ADDRINT vaddr, UINT64 vpn, bool walked) {
+        dirtyPages_.insert(vpn);
+        translationStats_.dirtyBitUpdates++;
+        if (walked) {
+            return;
+        }
+        UINT64 pudAddr = (UINT64)EntrySlot(cr3_, GetPgdIndex(vaddr),
+                                           pgdEntryNum_)
+                         << kPageShift;
+        UINT64 pmdAddr = (UINT64)EntrySlot(pudAddr, GetPudIndex(vaddr),
+                                           pudEntryNum_)
+                         << kPageShift;
+        UINT64 pteAddr = (UINT64)EntrySlot(pmdAddr, GetPmdIndex(vaddr),
+                                           pmdEntryNum_)
+                         << kPageShift;
+        UINT64 entrySize = kMemTracePageSize / pteEntryNum_;
+        if (!WalkLookup(3, pteAddr + GetPteIndex(vaddr) * entrySize,
+                        kPageTableLine)) {
+            translationStats_.pageWalkMemAccess++;
+        }
+    }
+
+    // Whether vaddr's page is present, creating no table storage
+    bool IsMapped(ADDRINT vaddr) const {
+        const UINT64 indices[4] = {GetPgdIndex(vaddr), GetPudIndex(vaddr),
+                                   GetPmdIndex(vaddr), GetPteIndex(vaddr)};
+        UINT64 tableAddr = cr3_;
+        for (UINT64 index : indices) {
+            UINT32 pfn = PeekEntry(tableAddr, index);
+            if (pfn == 0) {
+                return false;
+            }
+            tableAddr = (UINT64)pfn << kPageShift;
+        }
+        return true;
+    }
+
+    // PFN in an entry, 0 if not present; read-only EntrySlot
+    UINT32 PeekEntry(UINT64 tableAddr, UINT64 index) const {
+        auto it = pageTables_.find(tableAddr);
+        if (it == pageTables_.end() || !it->second.chunks) {
+            return 0;
+        }
+        const UINT32* chunk = it->second.chunks[index / kTableChunkEntries];
+        return chunk ? chunk[index % kTableChunkEntries] : 0;
+    }
+
+    // Whether a translation beyond the L1 TLB is held by a TLB level
+    bool IsTlbResident(UINT64 vpn) const {
+        return (victimTlb_ && victimTlb_->Contains(vpn)) ||
+               l2Tlb_.Contains(vpn);
+    }
+
+    // Rest of Translate after an L1 TLB miss
+    ADDRINT TranslateL1Miss(ADDRINT vaddr, UINT64 vpn, ADDRINT pc) {
+        UINT64 offset = GetOffset(vaddr);
+        UINT64 pfn;
+        if (eventSink_) {
+            eventTranslation_ = translationStats_.GetTotalTranslation();
+            LogEvent(kEventTlbMiss, vaddr, 0);
+        }
+
+        // 1b. L1 TLB miss - check the victim TLB, swap the entry back to L1
+        if (victimTlb_ && victimTlb_->Lookup(vpn, pfn)) {
+            translationStats_.victimTlbHits++;
+            LogEvent(kEventTlbHit, vaddr, 1);
+            victimTlb_->Invalidate(vpn);
+            FillL1Tlb(vpn, pfn);
             return (pfn << kPageShift) | offset;
         }
 
         // 2. L1 TLB miss - check L2 TLB
         if (l2Tlb_.Lookup(vpn, pfn)) {
             translationStats_.l2TlbHits++;
+            LogEvent(kEventTlbHit, vaddr, 2);
 
-            // L2 TLB hit - update L1 TLB with the translation
-            l1Tlb_.Insert(vpn, pfn);
+            // L2 TLB hit - update L1 TLB with the translation (exclusive
+            // mode moves the entry instead of copying it)
+            if (tlbInclusion_ == kTlbExclusive) {
+                l2Tlb_.Invalidate(vpn);
+            }
+            FillL1Tlb(vpn, pfn);
 
             // Combine PFN with offset
             return (pfn << kPageShift) | offset;
         }
 
+        walkStartMemAccess_ = translationStats_.pageWalkMemAccess;
+
         // 3. L2 TLB miss - check PMD PWC (maps VA[47:21] to PTE table PFN)
         UINT64 pteTablePfn;
         if (pmdPwc_.Lookup(vaddr, pteTablePfn)) {
             translationStats_.pmdCacheHits++;
+            LogEvent(kEventPwcHit, vaddr, 2);
             ADDRINT paddr = CompletePmdCacheHit(vaddr, pteTablePfn);
-
-            // Update both TLBs with the translation
-            pfn = paddr >> kPageShift;
-            l1Tlb_.Insert(vpn, pfn);
-            l2Tlb_.Insert(vpn, pfn);
-            return paddr;
+            return FinishWalk(vpn, paddr, pc);
         }
 
         // 4. PMD PWC miss - check PUD PWC (maps VA[47:30] to PMD table PFN)
         UINT64 pmdTablePfn;
         if (pudPwc_.Lookup(vaddr, pmdTablePfn)) {
             translationStats_.pudCacheHits++;
+            LogEvent(kEventPwcHit, vaddr, 1);
             ADDRINT paddr = CompletePudCacheHit(vaddr, pmdTablePfn);
-
-            // Update both TLBs with the translation
-            pfn = paddr >> kPageShift;
-            l1Tlb_.Insert(vpn, pfn);
-            l2Tlb_.Insert(vpn, pfn);
-            return paddr;
+            return FinishWalk(vpn, paddr, pc);
         }
 
         // 5. PUD PWC miss - check PGD PWC (maps VA[47:39] to PUD table PFN)
         UINT64 pudTablePfn;
         if (pgdPwc_.Lookup(vaddr, pudTablePfn)) {
             translationStats_.pgdCacheHits++;
+            LogEvent(kEventPwcHit, vaddr, 0);
             ADDRINT paddr = CompletePgdCacheHit(vaddr, pudTablePfn);
-
-            // Update both TLBs with the translation
-            pfn = paddr >> kPageShift;
-            l1Tlb_.Insert(vpn, pfn);
-            l2Tlb_.Insert(vpn, pfn);
-            return paddr;
+            return FinishWalk(vpn, paddr, pc);
         }
 
         // 6. Full page table walk needed
         translationStats_.fullWalks++;
+        LogEvent(kEventFullWalk, vaddr, 0);
         ADDRINT paddr = CompleteFullWalk(vaddr);
-
-        // Update both TLBs with the translation
-        pfn = paddr >> kPageShift;
-        l1Tlb_.Insert(vpn, pfn);
-        l2Tlb_.Insert(vpn, pfn);
-        return paddr;
+        return FinishWalk(vpn, paddr, pc);
     }
 
+   public:
     // Print detailed page table and cache statistics
+    void PrintTagRegionStats(std::ostream& os) const {
+        const TagRegionTable* tables[] = {
+            l1Tlb_.GetTagRegions(),
+            victimTlb_ ? victimTlb_->GetTagRegions() : nullptr,
+            l2Tlb_.GetTagRegions(), pgdPwc_.GetTagRegions(),
+            pudPwc_.GetTagRegions(), pmdPwc_.GetTagRegions()};
+        const std::string names[] = {
+            l1Tlb_.GetName(), victimTlb_ ? victimTlb_->GetName() : "",
+            l2Tlb_.GetName(), pgdPwc_.GetName(), pudPwc_.GetName(),
+            pmdPwc_.GetName()};
+        bool header = false;
+        for (size_t i = 0; i < 6; ++i) {
+            if (!tables[i]) {
+                continue;
+            }
+            if (!header) {
+                os << "\nRange-Limited Tags:" << '\n'
+                   << std::left << std::setw(22) << "Structure" << std::right
+                   << std::setw(8) << "Regions" << std::setw(10) << "Tag Bits"
+                   << std::setw(14) << "Region Fills" << std::setw(14)
+                   << "Reassigned" << std::setw(14) << "Dropped" << '\n';
+                header = true;
+            }
+            tables[i]->PrintStats(os, names[i]);
+        }
+    }
+
     void PrintDetailedStats(std::ostream& os) const {
         translationStats_.PrintTranslationStats(os);
 
@@ -446,6 +841,10 @@ class PageTable {
            << std::setprecision(2) << l2Tlb_.GetHitRate() * 100.0 << "%"
            << '\n';
 
+        if (victimTlb_) {
+            PrintStructureStats(os, *victimTlb_);
+        }
+
         // PWC stats
         os << std::left << std::setw(30) << pgdPwc_.GetName() << std::setw(10)
            << pgdPwc_.GetSize() << std::setw(10) << pgdPwc_.GetNumSets()
@@ -471,6 +870,19 @@ class PageTable {
            << std::setprecision(2) << pmdPwc_.GetHitRate() * 100.0 << "%"
            << '\n';
 
+        os << "\nTLB Inclusion Policy: " << TlbInclusionName(tlbInclusion_)
+           << '\n';
+        if (tlbInclusion_ == kTlbInclusive) {
+            os << "L1 TLB Back-Invalidations: " << tlbBackInvalidations_
+               << '\n';
+        }
+        if (l2TlbPredictor_) {
+            os << "L2 TLB Dead Predictions: "
+               << l2TlbPredictor_->GetDeadPredictions()
+               << ", Bypassed Fills: " << l2TlbPredictor_->GetBypasses()
+               << '\n';
+        }
+
         os << "\nVirtual Address Bit Ranges Used for PWC Tags:" << '\n';
         os << std::left << std::setw(30) << pgdPwc_.GetName() << "["
            << pgdPwc_.GetHighBit() << ":" << pgdPwc_.GetLowBit() << "]" << '\n';
@@ -479,6 +891,8 @@ class PageTable {
         os << std::left << std::setw(30) << pmdPwc_.GetName() << "["
            << pmdPwc_.GetHighBit() << ":" << pmdPwc_.GetLowBit() << "]" << '\n';
 
+        PrintTagRegionStats(os);
+
         // Page table statistics by level
         os << "\nPage Table Statistics by Level:" << '\n';
         os << "==============================" << '\n';
@@ -500,6 +914,12 @@ class PageTable {
         os << "Total memory for page tables: "
            << (pageTables_.size() * kMemTracePageSize) / (1024.0 * 1024.0)
            << " MB" << '\n';
+        os << "Host memory for page tables: "
+           << tableArena_.GetUsedBytes() / (1024.0 * 1024.0) << " MB" << '\n';
+
+        PrintFillHistogram(os);
+        PrintGrowthStats(os);
+        PrintPlacementStats(os);
     }
 
     void PrintMemoryStats(std::ostream& os) const {
@@ -528,6 +948,218 @@ class PageTable {
     }
 
    private:
+    template <typename Structure>
+    void PrintStructureStats(std::ostream& os, const Structure& s) const {
+        os << std::left << std::setw(30) << s.GetName() << std::setw(10)
+           << s.GetSize() << std::setw(10) << s.GetNumSets() << std::setw(10)
+           << s.GetNumWays() << std::right << std::setw(15) << s.GetAccesses()
+           << std::setw(15) << s.GetHits() << std::setw(15) << std::fixed
+           << std::setprecision(2) << s.GetHitRate() * 100.0 << "%" << '\n';
+    }
+
+    // Frame for a new table whose parent table is at parentAddr (0 for a
+    // root), following the placement policy
+    UINT64 AllocateTableFrame(UINT64 parentAddr) {
+        UINT64 frame;
+        switch (tablePlacement_) {
+            case kPtReserved:
+                if (regionNextFrame_ < regionEndFrame_) {
+                    frame = regionNextFrame_++;
+                    physMem_.ClaimFrame(frame);
+                } else {
+                    placementFallbacks_++;
+                    frame = physMem_.AllocateFrame();
+                }
+                break;
+            case kPtColocated: {
+                std::pair<UINT64, UINT64>& block = siblingBlocks_[parentAddr];
+                if (block.second == 0) {
+                    block.first = physMem_.ReserveFrames(colocateFrames_);
+                    block.second = colocateFrames_;
+                }
+                frame = block.first++;
+                block.second--;
+                physMem_.ClaimFrame(frame);
+                break;
+            }
+            case kPtSeparateNode:
+                frame = physMem_.AllocateTopFrame();
+                break;
+            default:
+                frame = physMem_.AllocateFrame();
+                break;
+        }
+        tableRegions_.insert(frame >> (kWalkRefRegionShift - kPageShift));
+        return frame;
+    }
+
+    void LogEvent(UINT8 type, UINT64 addr, UINT8 level, UINT8 hitLevel = 0) {
+        if (eventSink_) {
+            eventSink_->Record({addr, (UINT32)eventTranslation_, type, level,
+                                hitLevel, (UINT8)GetAsid()});
+        }
+    }
+
+    // Read a table entry, through the data caches if tables are cacheable
+    bool WalkLookup(int level, UINT64 entryAddr, UINT8 lineClass) {
+        RecordWalkRef(level, entryAddr);
+        bool hit = false;
+        UINT8 source = kWalkRefUncached;
+        if (isPteCachable_) {
+            UINT64 entryValue = 0;
+            hit = dataCache_.TranslateLookup(entryAddr, entryValue,
+                                             translationStats_, lineClass);
+            source = dataCache_.GetLastWalkRefSource();
+        }
+        LogEvent(kEventWalkRef, entryAddr, level, source);
+        return hit;
+    }
+
+    void RecordWalkRef(int level, UINT64 entryAddr) {
+        if (walkRefs_[level] > 0) {
+            UINT64 last = lastWalkRef_[level];
+            walkRefsSameLine_[level] += (entryAddr >> kWalkRefLineShift) ==
+                                        (last >> kWalkRefLineShift);
+            walkRefsSameRegion_[level] +=
+                (entryAddr >> kWalkRefRegionShift) ==
+                (last >> kWalkRefRegionShift);
+        }
+        walkRefs_[level]++;
+        lastWalkRef_[level] = entryAddr;
+    }
+
+    void PrintFillHistogram(std::ostream& os) const {
+        const char* buckets[kFillBuckets] = {
+            "0%",    "<=1%",  "<=10%", "<=20%", "<=30%",  "<=40%",
+            "<=50%", "<=60%", "<=70%", "<=80%", "<=90%", "<=100%"};
+        const PageTableLevelStats* levels[4] = {&pgdStats_, &pudStats_,
+                                                &pmdStats_, &pteStats_};
+        os << "\nPage Table Fill Distribution (tables per fill level):\n";
+        os << std::left << std::setw(30) << "Fill" << std::right
+           << std::setw(15) << "PGD" << std::setw(15) << "PUD"
+           << std::setw(15) << "PMD" << std::setw(15) << "PTE" << '\n';
+        os << std::string(90, '-') << '\n';
+        for (UINT64 b = 0; b < kFillBuckets; ++b) {
+            os << std::left << std::setw(30) << buckets[b] << std::right;
+            for (const PageTableLevelStats* level : levels) {
+                os << std::setw(15) << level->fillHistogram[b];
+            }
+            os << '\n';
+        }
+    }
+
+    // Page-table memory per GB of mapped footprint
+    static double TableMbPerFootprintGb(UINT64 tables, UINT64 mappedPages) {
+        return mappedPages > 0 ? (double)tables * kMemTracePageSize /
+                                     (1024.0 * 1024.0) /
+                                     ((double)mappedPages * kMemTracePageSize /
+                                      (1024.0 * 1024.0 * 1024.0))
+                               : 0.0;
+    }
+
+    void PrintGrowthStats(std::ostream& os) const {
+        os << "\nPage Table Growth:\n";
+        os << std::left << std::setw(30) << "Translations" << std::right
+           << std::setw(15) << "Tables" << std::setw(15) << "Table MB"
+           << std::setw(15) << "Footprint MB" << std::setw(15) << "MB per GB"
+           << '\n';
+        os << std::string(90, '-') << '\n';
+        std::vector<GrowthSample> samples = growthSamples_;
+        samples.push_back({translationStats_.GetTotalTranslation(),
+                           pageTables_.size(), pteStats_.entries});
+        for (const GrowthSample& sample : samples) {
+            os << std::left << std::setw(30) << sample.translations
+               << std::right << std::setw(15) << sample.tables << std::fixed
+               << std::setprecision(2) << std::setw(15)
+               << sample.tables * kMemTracePageSize / (1024.0 * 1024.0)
+               << std::setw(15)
+               << sample.mappedPages * kMemTracePageSize / (1024.0 * 1024.0)
+               << std::setw(15)
+               << TableMbPerFootprintGb(sample.tables, sample.mappedPages)
+               << '\n';
+        }
+        os << "Page table memory per GB of footprint: "
+           << TableMbPerFootprintGb(pageTables_.size(), pteStats_.entries)
+           << " MB" << '\n';
+    }
+
+    void PrintPlacementStats(std::ostream& os) const {
+        os << "\nPage Table Placement: "
+           << PageTablePlacementName(tablePlacement_) << '\n';
+        os << "Table frames in " << tableRegions_.size() << " 2MB regions ("
+           << std::fixed << std::setprecision(2)
+           << (tableRegions_.empty()
+                   ? 0.0
+                   : (double)pageTables_.size() / tableRegions_.size())
+           << " tables per region)";
+        if (tablePlacement_ == kPtReserved) {
+            os << ", " << placementFallbacks_ << " outside the region";
+        }
+        os << '\n';
+
+        const char* levels[4] = {"PGD", "PUD", "PMD", "PTE"};
+        os << std::left << std::setw(30) << "Walk References" << std::right
+           << std::setw(15) << "References" << std::setw(15) << "Same Line %"
+           << std::setw(15) << "Same 2MB %" << '\n';
+        os << std::string(75, '-') << '\n';
+        for (int level = 0; level < 4; ++level) {
+            UINT64 pairs = walkRefs_[level] > 0 ? walkRefs_[level] - 1 : 0;
+            os << std::left << std::setw(30) << levels[level] << std::right
+               << std::setw(15) << walkRefs_[level] << std::setw(15)
+               << (pairs ? (double)walkRefsSameLine_[level] / pairs * 100.0
+                         : 0.0)
+               << std::setw(15)
+               << (pairs ? (double)walkRefsSameRegion_[level] / pairs * 100.0
+                         : 0.0)
+               << '\n';
+        }
+    }
+
+    // Register an empty table at the given physical address; its storage is
+    // materialized by the first EntrySlot on it
+    void AllocateTable(UINT64 tableAddr, PageTableLevelStats& stats) {
+        pageTables_[tableAddr] = TableStore();
+        LogEvent(kEventTableAlloc, tableAddr, stats.level);
+        stats.allocations++;
+        stats.fillHistogram[0]++;
+    }
+
+    // Count a newly present entry of a table, moving the table between
+    // fill buckets
+    void AddEntry(UINT64 tableAddr, PageTableLevelStats& stats) {
+        UINT64& tableEntries = pageTables_[tableAddr].entries;
+        stats.fillHistogram[stats.FillBucket(tableEntries)]--;
+        tableEntries++;
+        stats.fillHistogram[stats.FillBucket(tableEntries)]++;
+        stats.entries++;
+    }
+
+    // PFN slot of an entry, creating the table's chunk array and the chunk
+    // holding the entry on first use
+    UINT32& EntrySlot(UINT64 tableAddr, UINT64 index, UINT64 numEntries) {
+        UINT32**& chunks = pageTables_[tableAddr].chunks;
+        if (!chunks) {
+            UINT64 numChunks =
+                (numEntries + kTableChunkEntries - 1) / kTableChunkEntries;
+            chunks = static_cast<UINT32**>(tableArena_.Allocate(
+                numChunks * sizeof(UINT32*), alignof(UINT32*)));
+        }
+        UINT32*& chunk = chunks[index / kTableChunkEntries];
+        if (!chunk) {
+            chunk = static_cast<UINT32*>(tableArena_.Allocate(
+                kTableChunkEntries * sizeof(UINT32), alignof(UINT32)));
+        }
+        return chunk[index % kTableChunkEntries];
+    }
+
+    // Allocate and zero a new PGD, returns its physical address
+    UINT64 AllocateRoot() {
+        UINT64 root = AllocateTableFrame(0) * kMemTracePageSize;
+        AllocateTable(root, pgdStats_);
+        roots_.push_back(root);
+        return root;
+    }
+
     // Helper to print stats for a page table level
     void PrintLevelStats(std::ostream& os,
                          const PageTableLevelStats& stats) const {
@@ -547,6 +1179,9 @@ class PageTable {
    public:
     // Get statistics
     UINT64 GetNumPageTables() const { return pageTables_.size(); }
+    const TranslationStats& GetTranslationStats() const {
+        return translationStats_;
+    }
 
     // TLB statistics
     double GetL1TlbHitRate() const { return l1Tlb_.GetHitRate(); }
@@ -559,10 +1194,9 @@ class PageTable {
     // Overall TLB efficiency
     double GetTlbEfficiency() const {
         UINT64 totalTranslations = translationStats_.GetTotalTranslation();
-        return totalTranslations > 0 ? (double)(translationStats_.l1TlbHits +
-                                                translationStats_.l2TlbHits) /
-                                           totalTranslations
-                                     : 0.0;
+        return totalTranslations > 0
+                   ? (double)translationStats_.GetTlbHits() / totalTranslations
+                   : 0.0;
     }
 
     // Page walk statistics
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "common.h"
+
+// Utility monitor (UMON) for one class of service: a shadow tag directory over
+// a sample of sets, kept in true LRU order, that counts hits by LRU stack
+// position. Hits at positions < n are what the requester would get with n
+// ways, independent of the ways it is actually given.
+class UtilityMonitor {
+   private:
+    UINT64 numWays_;
+    UINT64 sampleStride_;                   // Monitor every Nth set
+    std::vector<std::vector<UINT64>> atd_;  // [sampled set] tags, MRU first
+    std::vector<UINT64> stackHits_;         // Hits per LRU stack position
+
+   public:
+    UtilityMonitor(UINT64 numSets, UINT64 numWays, UINT64 sampleStride)
+        : numWays_(numWays),
+          sampleStride_(sampleStride),
+          atd_((numSets + sampleStride - 1) / sampleStride),
+          stackHits_(numWays, 0) {}
+
+    void Observe(UINT64 setIndex, UINT64 tag) {
+        if (setIndex % sampleStride_ != 0) {
+            return;
+        }
+        std::vector<UINT64>& stack = atd_[setIndex / sampleStride_];
+        auto it = std::find(stack.begin(), stack.end(), tag);
+        if (it != stack.end()) {
+            stackHits_[it - stack.begin()]++;
+            stack.erase(it);
+        } else if (stack.size() == numWays_) {
+            stack.pop_back();  // Evict the LRU shadow tag
+        }
+        stack.insert(stack.begin(), tag);
+    }
+
+    // Sampled hits this requester would see with the given number of ways
+    UINT64 Utility(UINT64 ways) const {
+        UINT64 hits = 0;
+        for (UINT64 i = 0; i < ways && i < numWays_; ++i) {
+            hits += stackHits_[i];
+        }
+        return hits;
+    }
+
+    // Age the counters so the partition tracks phase changes
+    void Decay() {
+        for (UINT64& hits : stackHits_) {
+            hits /= 2;
+        }
+    }
+};
+
+// Utility-based cache partitioning (UCP). Every interval accesses the ways of
+// a cache are re-divided among the classes of service with the lookahead
+// algorithm, then handed out as contiguous way masks.
+class UcpController {
+   private:
+    UINT64 numWays_;
+    UINT64 interval_;                        // Accesses between repartitions
+    UINT64 accesses_;                        // Accesses since last repartition
+    UINT64 repartitions_;                    // Number of repartitions so far
+    std::vector<UtilityMonitor> monitors_;   // One UMON per class of service
+    std::vector<UINT64> allocation_;         // Ways given to each COS
+
+   public:
+    UcpController(UINT64 numCos, UINT64 numSets, UINT64 numWays,
+                  UINT64 interval, UINT64 sampleStride)
+        : numWays_(numWays),
+          interval_(interval),
+          accesses_(0),
+          repartitions_(0),
+          monitors_(numCos, UtilityMonitor(numSets, numWays, sampleStride)),
+          allocation_(numCos, numWays / numCos) {
+        // Spread the remainder of an uneven initial split
+        for (UINT64 c = 0; c < numWays % numCos; ++c) {
+            allocation_[c]++;
+        }
+    }
+
+    // Record an access, returns true when the masks should be reprogrammed
+    bool Observe(UINT64 cos, UINT64 setIndex, UINT64 tag) {
+        if (cos < monitors_.size()) {
+            monitors_[cos].Observe(setIndex, tag);
+        }
+        if (++accesses_ < interval_) {
+            return false;
+        }
+        accesses_ = 0;
+        Repartition();
+        return true;
+    }
+
+    // Lookahead partitioning: repeatedly grant the block of ways with the
+    // highest marginal utility per way, every COS keeps at least one way
+    void Repartition() {
+        UINT64 numCos = monitors_.size();
+        std::fill(allocation_.begin(), allocation_.end(), 1);
+        UINT64 balance = numWays_ - numCos;
+        while (balance > 0) {
+            double bestUtility = -1.0;
+            UINT64 bestCos = 0;
+            UINT64 bestWays = 1;
+            for (UINT64 c = 0; c < numCos; ++c) {
+                UINT64 base = monitors_[c].Utility(allocation_[c]);
+                for (UINT64 k = 1; k <= balance; ++k) {
+                    double mu =
+                        (double)(monitors_[c].Utility(allocation_[c] + k) -
+                                 base) /
+                        k;
+                    if (mu > bestUtility) {
+                        bestUtility = mu;
+                        bestCos = c;
+                        bestWays = k;
+                    }
+                }
+            }
+            allocation_[bestCos] += bestWays;
+            balance -= bestWays;
+        }
+        for (UtilityMonitor& monitor : monitors_) {
+            monitor.Decay();
+        }
+        repartitions_++;
+    }
+
+    // Contiguous way masks matching the current allocation
+    std::vector<UINT64> GetWayMasks() const {
+        std::vector<UINT64> masks;
+        UINT64 firstWay = 0;
+        for (UINT64 ways : allocation_) {
+            UINT64 mask = (ways >= 64 ? ~0ULL : (1ULL << ways) - 1);
+            masks.push_back(mask << firstWay);
+            firstWay += ways;
+        }
+        return masks;
+    }
+
+    UINT64 GetRepartitions() const { return repartitions_; }
+    const std::vector<UINT64>& GetAllocation() const { return allocation_; }
+};
@@ -1,16 +1,30 @@
 #pragma once
 
 #include <iostream>
+#include <stdexcept>
 #include <vector>
 #include "common.h"
+#include "huge_page.h"
 
 // Physical Memory Pool
 class PhysicalMemory {
    private:
     UINT64 size_;                       // Size in bytes
     UINT64 allocatedFrames_;            // Number of allocated frames
-    std::vector<bool> frameAllocated_;  // Bitmap of allocated frames
+    // Bitmap of allocated frames
+    std::vector<bool, HugePageAllocator<bool>> frameAllocated_;
     UINT64 nextFrame_;                  // Next frame to allocate
+    UINT64 topFrame_;  // Highest frame not yet taken by the top-down pool
+
+    void CheckExhausted() const {
+        if (nextFrame_ > topFrame_ + 1) {
+            // No free frames available; callers report it (the library
+            // through memsim_last_error)
+            throw std::runtime_error(
+                "Physical memory exhausted. No more frames available.");
+        }
+    }
+
    public:
     PhysicalMemory(UINT64 memorySize = kPhysicalMemorySize)
         : size_(memorySize), allocatedFrames_(0) {
@@ -20,23 +34,40 @@ class PhysicalMemory {
         frameAllocated_[0] = true;
         allocatedFrames_ = 1;
         nextFrame_ = 1;  // Start allocating from frame 1
+        topFrame_ = numFrames - 1;
     }
 
     // Allocate a physical frame
     UINT64 AllocateFrame() {
-        if (nextFrame_ >= frameAllocated_.size()) {
-            // // No free frames available
-            // throw std::runtime_error("Physical memory exhausted");
-            std::cerr << "Error: Physical memory exhausted. No more frames "
-                         "available.\n";
-            exit(1);
-        }
-        frameAllocated_[nextFrame_] = true;
-        allocatedFrames_++;
         nextFrame_++;
+        CheckExhausted();
+        ClaimFrame(nextFrame_ - 1);
         return nextFrame_ - 1;
     }
 
+    // Set aside count contiguous frames, returns the first. The frames are
+    // not counted as allocated until claimed.
+    UINT64 ReserveFrames(UINT64 count) {
+        nextFrame_ += count;
+        CheckExhausted();
+        return nextFrame_ - count;
+    }
+
+    // Mark a frame obtained from ReserveFrames as allocated
+    void ClaimFrame(UINT64 frame) {
+        frameAllocated_[frame] = true;
+        allocatedFrames_++;
+    }
+
+    // Allocate from the top of memory downwards, a pool kept apart from
+    // the bottom-up frames (e.g. another NUMA node or memory tier)
+    UINT64 AllocateTopFrame() {
+        topFrame_--;
+        CheckExhausted();
+        ClaimFrame(topFrame_ + 1);
+        return topFrame_ + 1;
+    }
+
     // Get statistics
     UINT64 GetAllocatedFrames() const { return allocatedFrames_; }
     UINT64 GetTotalFrames() const { return frameAllocated_.size(); }
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <memory>
 #include "cache.h"
 #include "common.h"
+#include "tag_region.h"
 
 // Page Walk Cache (PWC) - caches partial translations
 // if table of contents (TOC) is enabled, the value type is a pointer
@@ -12,12 +14,32 @@ class PageWalkCache : public SetAssociativeCache<UINT64, UINT64> {
     UINT64 indexBitsHigh_;  // High bit position for VA tag extraction
     UINT64 tocSize_ = 4;    // Size of the table of contents (TOC) in bytes
     UINT64 tocMask_ = 0;    // Mask for TOC size
+    UINT64 asidTag_ = 0;    // Current ASID, pre-shifted above the VA tag
+    std::unique_ptr<TagRegionTable> regions_;  // Range-limited tags, if set
 
     typedef struct TOCEntry {
         bool valid = false;  // Tag for the entry
         UINT64 value = 0;    // Pointer to the next level page table
     } TOCEntry;
 
+    // Claim the region of tag, dropping the entries of a replaced region
+    void AllocateRegion(UINT64 tag) {
+        UINT64 evicted;
+        if (!regions_->Allocate(tag, evicted)) {
+            return;
+        }
+        std::vector<UINT64> tags = FindTags(
+            [&](UINT64 t) { return regions_->Region(t) == evicted; });
+        for (UINT64 t : tags) {
+            if (tocEnabled_) {
+                UINT64 setIndex = GetSetIndex(t);
+                delete[] (TOCEntry*)(Set(setIndex)[FindWay(setIndex, t)].value);
+            }
+            Invalidate(t);
+        }
+        regions_->RecordDropped(tags.size());
+    }
+
    protected:
     // Hash function to map VA tag to set index
     UINT64 GetSetIndex(const UINT64& vaTag) const override {
@@ -42,9 +64,9 @@ class PageWalkCache : public SetAssociativeCache<UINT64, UINT64> {
           indexBitsHigh_(highBit) {
         for (UINT64 i = 0; i < numSets_; i++) {
             for (UINT64 j = 0; j < numWays_; j++) {
-                sets_[i][j].value =
+                Set(i)[j].value =
                     (UINT64) nullptr;       // Initialize value to nullptr
-                sets_[i][j].valid = false;  // Initialize valid bit to false
+                Set(i)[j].valid = false;  // Initialize valid bit to false
             }
         }
     }
@@ -57,12 +79,19 @@ class PageWalkCache : public SetAssociativeCache<UINT64, UINT64> {
         indexBitsLow_ += __builtin_ctz(size);
     }
     UINT64 GetTocSize() const { return tocSize_; }
+    void SetAsid(UINT64 asid) { asidTag_ = asid << kAsidTagShift; }
+
+    // Store tags as one of regions base registers plus offsetBits of the tag
+    void EnableTagRegions(UINT64 regions, UINT64 offsetBits) {
+        regions_.reset(new TagRegionTable(regions, offsetBits));
+    }
+    const TagRegionTable* GetTagRegions() const { return regions_.get(); }
 
     // Extract tag from virtual address
     UINT64 GetTag(ADDRINT vaddr) const {
         UINT64 mask = ((1ULL << (indexBitsHigh_ - indexBitsLow_ + 1)) - 1)
                       << indexBitsLow_;
-        return (vaddr & mask) >> indexBitsLow_;
+        return ((vaddr & mask) >> indexBitsLow_) | asidTag_;
     }
 
     // Look up translation for a virtual address
@@ -74,71 +103,74 @@ class PageWalkCache : public SetAssociativeCache<UINT64, UINT64> {
             UINT64 tocIndex =
                 (vaddr & tocMask_) >> (indexBitsLow_ - __builtin_ctz(tocSize_));
 
-            for (UINT64 way = 0; way < numWays_; way++) {
-                if (sets_[setIndex][way].valid &&
-                    sets_[setIndex][way].tag == tag) {
-                    TOCEntry* tocPtr = (TOCEntry*)(sets_[setIndex][way].value);
-                    if (tocPtr[tocIndex].valid) {
-                        nextLevelPfn = tocPtr[tocIndex].value;
-                        this->hits_++;
-                        UpdateLru(setIndex, way);
-                        return true;
-                    } else {
-                        // Entry is not valid, return false
-                        return false;
-                    }
-                }
+            UINT64 way = FindWay(setIndex, tag);
+            if (way == numWays_) {
+                return false;
             }
-
-            return false;
+            TOCEntry* tocPtr = (TOCEntry*)(Set(setIndex)[way].value);
+            if (!tocPtr[tocIndex].valid) {
+                // Entry is not valid, return false
+                return false;
+            }
+            nextLevelPfn = tocPtr[tocIndex].value;
+            this->hits_++;
+            UpdateLru(setIndex, way);
+            if (regions_) {
+                regions_->Touch(tag);
+            }
+            return true;
+        }
+        bool hit =
+            SetAssociativeCache<UINT64, UINT64>::Lookup(tag, nextLevelPfn);
+        if (hit && regions_) {
+            regions_->Touch(tag);
         }
-        return SetAssociativeCache<UINT64, UINT64>::Lookup(tag, nextLevelPfn);
+        return hit;
     }
 
     // Insert translation for a virtual address
     void Insert(ADDRINT vaddr, UINT64 nextLevelPfn) {
         UINT64 tag = GetTag(vaddr);
+        if (regions_) {
+            AllocateRegion(tag);
+        }
         if (tocEnabled_) {
             UINT64 setIndex = GetSetIndex(tag);
             UINT64 tocIndex =
                 (vaddr & tocMask_) >> (indexBitsLow_ - __builtin_ctz(tocSize_));
-            for (UINT64 way = 0; way < numWays_; way++) {
-                if (sets_[setIndex][way].valid &&
-                    sets_[setIndex][way].tag == tag) {
-                    // Entry already exists, update TOC entry
-                    TOCEntry* tocPtr = (TOCEntry*)(sets_[setIndex][way].value);
-                    // Update TOC entry
-                    tocPtr[tocIndex].valid = true;
-                    tocPtr[tocIndex].value = nextLevelPfn;
-                    UpdateLru(setIndex, way);
-                    return;
-                }
+            UINT64 way = FindWay(setIndex, tag);
+            if (way != numWays_) {
+                // Entry already exists, update TOC entry
+                TOCEntry* tocPtr = (TOCEntry*)(Set(setIndex)[way].value);
+                tocPtr[tocIndex].valid = true;
+                tocPtr[tocIndex].value = nextLevelPfn;
+                UpdateLru(setIndex, way);
+                return;
             }
 
             // Entry does not exist, choose a victim
-            UINT64 way = FindLruWay(setIndex);
-            bool evictValid = sets_[setIndex][way].valid;
+            way = FindLruWay(setIndex);
+            bool evictValid = Set(setIndex)[way].valid;
             bool evictDirty = false;
             UINT64 evictTag;
             TOCEntry* evictTOCPtr = nullptr;
             if (evictValid) {
-                evictTag = sets_[setIndex][way].tag;
-                evictTOCPtr = (TOCEntry*)(sets_[setIndex][way].value);
+                evictTag = Set(setIndex)[way].tag;
+                evictTOCPtr = (TOCEntry*)(Set(setIndex)[way].value);
                 evictDirty = evictTOCPtr[tocIndex].valid;
             }
 
             // Allocate new TOC entry if needed
-            sets_[setIndex][way].value =
+            Set(setIndex)[way].value =
                 (UINT64) new TOCEntry[tocSize_]{};  // Allocate TOC entry
-            TOCEntry* tocPtr = (TOCEntry*)(sets_[setIndex][way].value);
+            TOCEntry* tocPtr = (TOCEntry*)(Set(setIndex)[way].value);
             for (UINT64 i = 0; i < tocSize_; i++) {
                 tocPtr[i].valid = false;  // Initialize TOC entry to invalid
             }
             tocPtr[tocIndex].valid = true;  // Set the new entry to valid
             tocPtr[tocIndex].value = nextLevelPfn;  // Set the new entry value
-            sets_[setIndex][way].tag = tag;         // Set the tag
-            sets_[setIndex][way].valid = true;      // Set the entry to valid
-            sets_[setIndex][way].dirty = false;  // Set the entry to not dirty
+            InstallTag(setIndex, way, tag);  // Set the tag, mark valid
+            Set(setIndex)[way].dirty = false;  // Set the entry to not dirty
             UpdateLru(setIndex, way);            // Update LRU for the set
 
             // Handle eviction if needed
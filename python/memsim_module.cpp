@@ -0,0 +1,196 @@
+// memsim_module.cpp
+// Python bindings of the simulator library (memsim.h). Accesses are
+// submitted as NumPy structured arrays of dtype memsim.MEMREF, which share
+// the trace record layout, so batches (including np.memmap'd version 1
+// trace files) go to the simulator without a copy; counters come back as
+// dicts. read_trace decodes either trace format.
+#include <pybind11/functional.h>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "memsim.h"
+#include "trace_reader.h"
+
+namespace py = pybind11;
+
+// Counter names of memsim_stats, in struct order
+static const std::pair<const char*, uint64_t memsim_stats::*> kStatsFields[] = {
+    {"accesses", &memsim_stats::accesses},
+    {"l1_tlb_hits", &memsim_stats::l1_tlb_hits},
+    {"victim_tlb_hits", &memsim_stats::victim_tlb_hits},
+    {"l2_tlb_hits", &memsim_stats::l2_tlb_hits},
+    {"pmd_pwc_hits", &memsim_stats::pmd_pwc_hits},
+    {"pud_pwc_hits", &memsim_stats::pud_pwc_hits},
+    {"pgd_pwc_hits", &memsim_stats::pgd_pwc_hits},
+    {"full_walks", &memsim_stats::full_walks},
+    {"walk_mem_accesses", &memsim_stats::walk_mem_accesses},
+    {"l1_accesses", &memsim_stats::l1_accesses},
+    {"l1_hits", &memsim_stats::l1_hits},
+    {"l2_accesses", &memsim_stats::l2_accesses},
+    {"l2_hits", &memsim_stats::l2_hits},
+    {"l3_accesses", &memsim_stats::l3_accesses},
+    {"l3_hits", &memsim_stats::l3_hits},
+    {"mem_accesses", &memsim_stats::mem_accesses},
+    {"cycles", &memsim_stats::cycles},
+    {"page_tables", &memsim_stats::page_tables},
+    {"allocated_frames", &memsim_stats::allocated_frames},
+};
+
+static py::dict StatsDict(const memsim_stats& stats) {
+    py::dict dict;
+    for (const auto& field : kStatsFields) {
+        dict[field.first] = stats.*field.second;
+    }
+    return dict;
+}
+
+// Machine options from keyword arguments: l2_tlb_size=2048 becomes
+// "--l2_tlb_size 2048", booleans 1/0 and sequences comma separated lists
+static void AppendKwargOptions(const py::kwargs& kwargs,
+                               std::vector<std::string>& options) {
+    for (const auto& item : kwargs) {
+        options.push_back("--" + py::cast<std::string>(item.first));
+        py::handle value = item.second;
+        if (py::isinstance<py::bool_>(value)) {
+            options.push_back(value.cast<bool>() ? "1" : "0");
+        } else if (py::isinstance<py::list>(value) ||
+                   py::isinstance<py::tuple>(value)) {
+            std::string list;
+            for (py::handle element : value) {
+                list += (list.empty() ? "" : ",") +
+                        py::str(element).cast<std::string>();
+            }
+            options.push_back(list);
+        } else {
+            options.push_back(py::str(value).cast<std::string>());
+        }
+    }
+}
+
+// Whole trace (either format) as a MEMREF array, plus the MemRefContext
+// array when context is set
+static py::object ReadTrace(const std::string& path, bool context) {
+    TraceReader reader;
+    if (!reader.Open(path)) {
+        throw py::value_error("could not open trace " + path);
+    }
+    constexpr UINT64 kBatch = 1 << 16;
+    std::vector<MEMREF> refs;
+    std::vector<MemRefContext> contexts;
+    {
+        py::gil_scoped_release release;
+        UINT64 count = 0;
+        do {
+            refs.resize(count + kBatch);
+            contexts.resize(count + kBatch);
+            count += reader.ReadBatch(refs.data() + count, kBatch,
+                                      contexts.data() + count);
+        } while (refs.size() == count);
+        refs.resize(count);
+        contexts.resize(count);
+    }
+    py::array_t<MEMREF> refArray(refs.size(), refs.data());
+    if (!context) {
+        return std::move(refArray);
+    }
+    py::array_t<MemRefContext> contextArray(contexts.size(), contexts.data());
+    return py::make_tuple(refArray, contextArray);
+}
+
+PYBIND11_MODULE(memsim, m) {
+    m.doc() = "Memory hierarchy and address translation simulator";
+
+    PYBIND11_NUMPY_DTYPE(MEMREF, pc, ea, size, read, flags);
+    m.attr("MEMREF") = py::dtype::of<MEMREF>();
+    PYBIND11_NUMPY_DTYPE(MemRefContext, tid, instructions);
+    m.attr("MEMREF_CONTEXT") = py::dtype::of<MemRefContext>();
+    py::list statNames;
+    for (const auto& field : kStatsFields) {
+        statNames.append(field.first);
+    }
+    m.attr("STAT_NAMES") = py::tuple(statNames);
+
+    m.def("read_trace", &ReadTrace, py::arg("path"), py::arg("context") = false,
+          "Decode a version 1 or 2 trace into a memsim.MEMREF array; with "
+          "context, also return the memsim.MEMREF_CONTEXT array (thread, "
+          "instruction delta) as a tuple");
+
+    py::class_<MemorySimulator>(m, "Simulator")
+        .def(py::init([](const std::vector<std::string>& options,
+                         bool snapshots, const py::kwargs& kwargs) {
+                 std::vector<std::string> all = options;
+                 AppendKwargOptions(kwargs, all);
+                 return new MemorySimulator(MemorySimulator::ParseConfig(all),
+                                            snapshots);
+             }),
+             py::arg("options") = std::vector<std::string>(),
+             py::arg("snapshots") = false,
+             "Simulated machine from offline analyzer options, as a list "
+             "(['--l2_tlb_size', '2048']) and/or keywords (l2_tlb_size="
+             "2048). With snapshots, accesses are journaled for restore().")
+        .def(
+            "access",
+            [](MemorySimulator& sim,
+               py::array_t<MEMREF, py::array::c_style> refs,
+               bool paddrs) -> py::object {
+                if (refs.ndim() != 1) {
+                    throw py::value_error("refs must be one-dimensional");
+                }
+                UINT64 count = refs.shape(0);
+                if (!paddrs) {
+                    py::gil_scoped_release release;
+                    sim.Access(refs.data(), count);
+                    return py::none();
+                }
+                py::array_t<uint64_t> out(count);
+                ADDRINT* outData = out.mutable_data();
+                {
+                    py::gil_scoped_release release;
+                    sim.Access(refs.data(), count, outData);
+                }
+                return std::move(out);
+            },
+            py::arg("refs").noconvert(), py::arg("paddrs") = false,
+            "Translate and access a contiguous memsim.MEMREF array in place "
+            "(other dtypes are rejected rather than copied). Returns the "
+            "physical addresses when paddrs is set. The GIL is released, "
+            "but one simulator must only be driven by one thread.")
+        .def("switch_address_space", &MemorySimulator::SwitchAddressSpace,
+             py::arg("asid"))
+        .def(
+            "stats",
+            [](const MemorySimulator& sim) { return StatsDict(sim.GetStats()); },
+            "Counters as a dict keyed by memsim.STAT_NAMES")
+        .def(
+            "report",
+            [](const MemorySimulator& sim) {
+                std::ostringstream os;
+                sim.PrintStats(os);
+                return os.str();
+            },
+            "Translation, page table and cache reports of the offline "
+            "analyzer")
+        .def(
+            "set_stats_callback",
+            [](MemorySimulator& sim, UINT64 interval, py::object callback) {
+                if (callback.is_none()) {
+                    sim.SetStatsCallback(0, nullptr);
+                    return;
+                }
+                sim.SetStatsCallback(
+                    interval, [callback](const memsim_stats& stats) {
+                        // access() runs without the GIL
+                        py::gil_scoped_acquire acquire;
+                        callback(StatsDict(stats));
+                    });
+            },
+            py::arg("interval"), py::arg("callback"),
+            "Call callback(stats) after the first batch past every interval "
+            "accesses; None stops the stream")
+        .def("snapshot", &MemorySimulator::Snapshot)
+        .def("restore", &MemorySimulator::Restore, py::arg("snapshot"));
+}
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""
+In-process configuration sweep
+
+Runs one trace through the memsim Python module once per value of a
+simulator option and prints the counters as CSV, instead of launching the
+offline analyzer per configuration and scraping its output. Build the
+module with -DMEMSIM_BUILD_PYTHON=ON and put the build directory on
+PYTHONPATH, e.g.
+
+    PYTHONPATH=build/release script/memsim_sweep.py trace.bin \\
+        --sweep l2_tlb_size=512,1024,2048 --set pte_cachable=1
+"""
+
+import argparse
+import csv
+import sys
+
+import numpy as np
+
+import memsim
+
+DEFAULT_BATCH_SIZE = 1 << 16
+TRACE_MAGIC = b'MEMTRACE'  # Version 2 trace header (trace_format.h)
+
+
+def parse_assignment(text):
+    name, _, value = text.partition('=')
+    if not name or not value:
+        raise argparse.ArgumentTypeError(f"expected NAME=VALUE, got {text}")
+    return name, value
+
+
+def load_trace(path):
+    with open(path, 'rb') as f:
+        magic = f.read(len(TRACE_MAGIC))
+    if magic == TRACE_MAGIC:
+        # Version 2 records are variable length: decode into memory
+        return memsim.read_trace(path)
+    return np.memmap(path, dtype=memsim.MEMREF, mode='r')
+
+
+def run(trace, options, batch_size):
+    sim = memsim.Simulator(options)
+    for start in range(0, len(trace), batch_size):
+        # Slices of the memmap are views: the simulator reads the file pages
+        sim.access(trace[start:start + batch_size])
+    return sim.stats()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument('trace', help='MEMREF trace file')
+    parser.add_argument('--sweep', type=parse_assignment, required=True,
+                        help='option and comma separated values, e.g. '
+                             'l2_tlb_size=512,1024')
+    parser.add_argument('--set', type=parse_assignment, action='append',
+                        default=[], help='fixed option, e.g. pte_cachable=1')
+    parser.add_argument('--batch_size', type=int, default=DEFAULT_BATCH_SIZE)
+    args = parser.parse_args()
+
+    trace = load_trace(args.trace)
+    fixed = [word for name, value in args.set
+             for word in (f'--{name}', value)]
+    name, values = args.sweep
+
+    writer = csv.writer(sys.stdout)
+    writer.writerow([name] + list(memsim.STAT_NAMES))
+    for value in values.split(','):
+        stats = run(trace, fixed + [f'--{name}', value], args.batch_size)
+        writer.writerow([value] + [stats[stat] for stat in memsim.STAT_NAMES])
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,49 @@
+#!/bin/bash
+# Profile-guided build of the standalone tools (CMake presets pgo-generate
+# and pgo-use), trained on synthetic traces over the TOC on/off and
+# PTE-cacheable on/off translation paths, then an accesses/sec comparison
+# against the plain release build.
+#
+# Usage: script/pgo_build.sh [training accesses] [benchmark accesses]
+set -e
+cd "$(dirname "$0")/.."
+
+TRAIN_ACCESSES=${1:-2000000}
+BENCH_ACCESSES=${2:-2000000}
+PROFILES=build/pgo-profiles
+TRAIN_TRACE=build/pgo-train.trace
+
+# 1. Instrumented build, fresh profiles
+rm -rf "$PROFILES"
+cmake --preset pgo-generate
+cmake --build --preset pgo-generate -j"$(nproc)"
+
+# 2. Training: every TOC / PTE-cacheable combination through the offline
+# analyzer, and the benchmark itself (which runs the same combinations)
+build/pgo-generate/synthetic_trace --accesses "$TRAIN_ACCESSES" --seed 1 \
+    "$TRAIN_TRACE"
+for pte in 0 1; do
+    for toc in 0 1; do
+        echo "Training: pte_cachable=$pte toc_enabled=$toc"
+        build/pgo-generate/memory_simulator_offline --pte_cachable $pte \
+            --toc_enabled $toc --toc_size $((toc * 8)) "$TRAIN_TRACE" > /dev/null
+    done
+done
+build/pgo-generate/simulator_bench --accesses "$TRAIN_ACCESSES" --repeat 1 \
+    > /dev/null
+
+# 3. Optimized builds with and without the profile
+cmake --preset pgo-use
+cmake --build --preset pgo-use -j"$(nproc)"
+cmake --preset release
+cmake --build --preset release -j"$(nproc)"
+
+# 4. Benchmark on a stream the profile was not trained on
+echo
+echo "== Release (no PGO) =="
+build/release/simulator_bench --accesses "$BENCH_ACCESSES" --seed 2
+echo
+echo "== PGO + LTO =="
+build/pgo-use/simulator_bench --accesses "$BENCH_ACCESSES" --seed 2
+echo
+echo "PGO analyzer: build/pgo-use/memory_simulator_offline"
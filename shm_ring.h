@@ -0,0 +1,291 @@
+#pragma once
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include "common.h"
+
+// Shared-memory ring of MEMREF records: one producer (the Pin tool)
+// publishes, several consumer processes (offline analyzers, usually with
+// different configurations) each read every record at their own pace. The
+// producer never overwrites a record an attached consumer has not read, so
+// the slowest consumer throttles the traced program. The ring lives in
+// /dev/shm (the shm_open namespace) as memsim-NAME.
+
+constexpr UINT64 kShmRingMagic = 0x474e49524d53454dULL;  // "MESMRING"
+constexpr UINT32 kShmRingVersion = 2;
+constexpr UINT32 kShmRingMaxConsumers = 16;
+
+// ShmRingHeader::Consumer::attached states
+enum : UINT32 {
+    kShmSlotFree = 0,
+    kShmSlotAttached = 1,  // readPos is valid and holds the producer back
+    kShmSlotClaimed = 2,   // Taken by a consumer still setting up its cursor
+};
+
+struct ShmRingHeader {
+    std::atomic<UINT64> magic;  // Stored last, once the ring is set up
+    UINT32 version;
+    UINT32 expectedConsumers;  // Producer waits for these before publishing
+    UINT64 capacity;           // Records, a power of two
+    alignas(64) std::atomic<UINT64> writePos;  // Records published
+    std::atomic<UINT32> closed;                // Producer finished
+    // Per-consumer cursors, one cache line each
+    struct alignas(64) Consumer {
+        std::atomic<UINT32> attached;
+        std::atomic<INT64> pid;
+        std::atomic<UINT64> readPos;  // Records consumed
+    } consumers[kShmRingMaxConsumers];
+};
+
+static_assert(std::atomic<UINT64>::is_always_lock_free,
+              "shared-memory cursors must be lock-free");
+
+inline std::string ShmRingPath(const std::string& name) {
+    return "/dev/shm/memsim-" + name;
+}
+
+// Back off while waiting on the other side: spin briefly, then sleep
+inline void ShmRingBackoff(UINT64& spins) {
+    if (++spins < 64) {
+        return;
+    }
+    usleep(spins < 1024 ? 10 : 200);
+}
+
+class ShmRingWriter {
+   private:
+    ShmRingHeader* header_;
+    MEMREF* records_;
+    UINT64 mappedBytes_;
+    std::string path_;
+    bool started_;  // Expected consumers attached
+
+    // Oldest record still unread by a live consumer, writePos when none;
+    // never more than a ring behind, whatever a cursor holds
+    UINT64 MinReadPos(UINT64 writePos, bool reapDead) {
+        UINT64 minPos = writePos;
+        for (auto& consumer : header_->consumers) {
+            if (consumer.attached.load() != kShmSlotAttached) {
+                continue;
+            }
+            // A consumer that died without detaching would stall the ring
+            if (reapDead && kill(consumer.pid.load(), 0) != 0 &&
+                errno == ESRCH) {
+                consumer.attached.store(kShmSlotFree);
+                continue;
+            }
+            minPos = std::min(minPos, consumer.readPos.load());
+        }
+        const UINT64 capacity = header_->capacity;
+        return writePos > capacity ? std::max(minPos, writePos - capacity)
+                                   : minPos;
+    }
+
+    UINT64 AttachedConsumers() const {
+        UINT64 count = 0;
+        for (const auto& consumer : header_->consumers) {
+            count += consumer.attached.load() == kShmSlotAttached;
+        }
+        return count;
+    }
+
+   public:
+    ShmRingWriter()
+        : header_(nullptr), records_(nullptr), mappedBytes_(0),
+          started_(false) {}
+    ~ShmRingWriter() { Close(); }
+
+    // Create the ring, replacing a stale one; capacity is rounded up to a
+    // power of two records
+    bool Open(const std::string& name, UINT64 capacity,
+              UINT32 expectedConsumers) {
+        UINT64 records = 1;
+        while (records < capacity) {
+            records <<= 1;
+        }
+        path_ = ShmRingPath(name);
+        unlink(path_.c_str());
+        int fd = open(path_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) {
+            return false;
+        }
+        mappedBytes_ = sizeof(ShmRingHeader) + records * sizeof(MEMREF);
+        if (ftruncate(fd, mappedBytes_) != 0) {
+            close(fd);
+            unlink(path_.c_str());
+            return false;
+        }
+        void* base = mmap(nullptr, mappedBytes_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            unlink(path_.c_str());
+            return false;
+        }
+        // The fresh file is zeroed: cursors start at 0, no consumers
+        header_ = static_cast<ShmRingHeader*>(base);
+        records_ = reinterpret_cast<MEMREF*>(header_ + 1);
+        header_->capacity = records;
+        header_->expectedConsumers =
+            std::min(expectedConsumers, kShmRingMaxConsumers);
+        header_->version = kShmRingVersion;
+        header_->magic.store(kShmRingMagic);
+        return true;
+    }
+
+    // Copy count records into the ring, waiting for space
+    void Publish(const MEMREF* buffer, UINT64 count) {
+        UINT64 spins = 0;
+        while (!started_) {
+            started_ = AttachedConsumers() >= header_->expectedConsumers;
+            if (!started_) {
+                ShmRingBackoff(spins);
+            }
+        }
+
+        const UINT64 capacity = header_->capacity;
+        UINT64 writePos = header_->writePos.load(std::memory_order_relaxed);
+        while (count > 0) {
+            // Dead consumers are only looked for once the ring has stalled
+            UINT64 space = 0;
+            for (spins = 0; space == 0;) {
+                UINT64 minPos = MinReadPos(writePos, spins >= 1024);
+                space = capacity - (writePos - minPos);
+                if (space == 0) {
+                    ShmRingBackoff(spins);
+                }
+            }
+            UINT64 n = std::min(count, space);
+            UINT64 offset = writePos & (capacity - 1);
+            UINT64 first = std::min(n, capacity - offset);
+            memcpy(records_ + offset, buffer, first * sizeof(MEMREF));
+            memcpy(records_, buffer + first, (n - first) * sizeof(MEMREF));
+            writePos += n;
+            header_->writePos.store(writePos);
+            buffer += n;
+            count -= n;
+        }
+    }
+
+    // Mark the end of the stream; attached consumers drain what is left
+    void Close() {
+        if (!header_) {
+            return;
+        }
+        header_->closed.store(1);
+        munmap(header_, mappedBytes_);
+        unlink(path_.c_str());
+        header_ = nullptr;
+    }
+};
+
+class ShmRingReader {
+   private:
+    ShmRingHeader* header_;
+    MEMREF* records_;
+    UINT64 mappedBytes_;
+    ShmRingHeader::Consumer* slot_;
+
+   public:
+    ShmRingReader()
+        : header_(nullptr), records_(nullptr), mappedBytes_(0),
+          slot_(nullptr) {}
+    ~ShmRingReader() { Close(); }
+
+    // Attach to the ring as a new consumer, reading from the next record
+    // published (the first one when the producer waits for consumers)
+    bool Open(const std::string& name) {
+        int fd = open(ShmRingPath(name).c_str(), O_RDWR);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (UINT64)st.st_size < sizeof(ShmRingHeader)) {
+            close(fd);
+            return false;
+        }
+        mappedBytes_ = st.st_size;
+        void* base = mmap(nullptr, mappedBytes_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            return false;
+        }
+        header_ = static_cast<ShmRingHeader*>(base);
+        records_ = reinterpret_cast<MEMREF*>(header_ + 1);
+        if (header_->magic.load() != kShmRingMagic ||
+            header_->version != kShmRingVersion) {
+            Close();
+            return false;
+        }
+
+        // Claim a slot, hidden from the producer until its cursor is set
+        for (auto& consumer : header_->consumers) {
+            UINT32 free = kShmSlotFree;
+            if (consumer.attached.compare_exchange_strong(free,
+                                                          kShmSlotClaimed)) {
+                slot_ = &consumer;
+                break;
+            }
+        }
+        if (!slot_) {
+            Close();
+            return false;
+        }
+        slot_->pid.store(getpid());
+        slot_->readPos.store(header_->writePos.load());
+        slot_->attached.store(kShmSlotAttached);
+        // Start at the end published once the producer can see this slot:
+        // a chunk it sized without the slot starts at or before that end
+        // and only overwrites records before its start
+        slot_->readPos.store(header_->writePos.load());
+        return true;
+    }
+
+    // Read up to maxRecords entries, waiting until that many (at most a
+    // full ring) are published or the producer closes the ring; returns 0
+    // at end of stream
+    UINT64 ReadBatch(MEMREF* buffer, UINT64 maxRecords) {
+        const UINT64 capacity = header_->capacity;
+        const UINT64 wanted = std::min(maxRecords, capacity);
+        UINT64 readPos = slot_->readPos.load(std::memory_order_relaxed);
+        UINT64 available;
+        UINT64 spins = 0;
+        while (true) {
+            bool closed = header_->closed.load(std::memory_order_acquire);
+            available =
+                header_->writePos.load(std::memory_order_acquire) - readPos;
+            if (available >= wanted || closed) {
+                break;
+            }
+            ShmRingBackoff(spins);
+        }
+
+        UINT64 n = std::min(available, maxRecords);
+        UINT64 offset = readPos & (capacity - 1);
+        UINT64 first = std::min(n, capacity - offset);
+        memcpy(buffer, records_ + offset, first * sizeof(MEMREF));
+        memcpy(buffer + first, records_, (n - first) * sizeof(MEMREF));
+        slot_->readPos.store(readPos + n, std::memory_order_release);
+        return n;
+    }
+
+    void Close() {
+        if (slot_) {
+            slot_->attached.store(kShmSlotFree);
+            slot_ = nullptr;
+        }
+        if (header_) {
+            munmap(header_, mappedBytes_);
+            header_ = nullptr;
+        }
+    }
+};
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "huge_page.h"
+
+// Command line options of the simulated machine, shared by the offline
+// analyzer and the library API (memsim.h)
+
+// Parse a comma separated list of (decimal or 0x-prefixed hex) numbers
+inline std::vector<UINT64> ParseList(const std::string& text) {
+    std::vector<UINT64> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        values.push_back(std::stoull(item, nullptr, 0));
+    }
+    return values;
+}
+
+// Parse one flag per cache level (L1,L2,L3), e.g. "0,0,1"
+inline void ParseLevelFlags(const std::string& text, bool flags[3]) {
+    std::vector<UINT64> values = ParseList(text);
+    if (values.size() != 3) {
+        throw std::invalid_argument("expected three values (L1,L2,L3)");
+    }
+    for (int level = 0; level < 3; ++level) {
+        flags[level] = values[level] != 0;
+    }
+}
+
+// Count that sizes a structure (entries, ways, bytes); zero is rejected
+inline UINT64 ParsePositive(const char* text) {
+    UINT64 value = std::stoull(text);
+    if (value == 0) {
+        throw std::invalid_argument("expected a positive value");
+    }
+    return value;
+}
+
+// Cache line size, a power of two
+inline UINT64 ParseLineSize(const char* text) {
+    UINT64 value = ParsePositive(text);
+    if ((value & (value - 1)) != 0) {
+        throw std::invalid_argument("expected a power of two");
+    }
+    return value;
+}
+
+// A set-associative structure needs a power-of-two number of sets, at
+// least one (the set index is a mask of the tag)
+inline void CheckSets(UINT64 size, UINT64 ways, UINT64 line,
+                      const std::string& option) {
+    UINT64 sets = size / (ways * line);
+    if (sets == 0 || (sets & (sets - 1)) != 0 || size % (ways * line) != 0) {
+        throw std::invalid_argument(option +
+                                    " must give a power-of-two number of sets");
+    }
+}
+
+// Way masks must each select some of the structure's ways (at most 64)
+inline void CheckWayMasks(const std::vector<UINT64>& masks, UINT64 ways,
+                          const std::string& option) {
+    if (masks.empty()) {
+        return;
+    }
+    if (ways > 64) {
+        throw std::invalid_argument(option + " needs at most 64 ways");
+    }
+    UINT64 allWays = ways == 64 ? ~0ULL : (1ULL << ways) - 1;
+    for (UINT64 mask : masks) {
+        if (mask == 0 || (mask & ~allWays) != 0) {
+            throw std::invalid_argument(option + ": mask " +
+                                        std::to_string(mask) +
+                                        " must select some of the " +
+                                        std::to_string(ways) + " ways");
+        }
+    }
+}
+
+// Check the values that depend on several options, once all are parsed;
+// throws std::invalid_argument
+inline void ValidateSimConfig(const SimConfig& config) {
+    CheckSets(config.tlb.l1Size, config.tlb.l1Ways, 1, "--l1_tlb_size");
+    CheckSets(config.tlb.l2Size, config.tlb.l2Ways, 1, "--l2_tlb_size");
+    CheckSets(config.pwc.pgdSize, config.pwc.pgdWays, 1, "--pgd_pwc_size");
+    CheckSets(config.pwc.pudSize, config.pwc.pudWays, 1, "--pud_pwc_size");
+    CheckSets(config.pwc.pmdSize, config.pwc.pmdWays, 1, "--pmd_pwc_size");
+    CheckSets(config.cache.l1Size, config.cache.l1Ways, config.cache.l1Line,
+              "--l1_cache_size");
+    CheckSets(config.cache.l2Size, config.cache.l2Ways, config.cache.l2Line,
+              "--l2_cache_size");
+    CheckSets(config.cache.l3Size, config.cache.l3Ways, config.cache.l3Line,
+              "--l3_cache_size");
+    if (config.pteLines.cacheSize > 0) {
+        CheckSets(config.pteLines.cacheSize, config.pteLines.cacheWays,
+                  config.cache.l2Line, "--pte_cache_size");
+    }
+    CheckWayMasks(config.partition.l2Masks, config.cache.l2Ways,
+                  "--l2_way_masks");
+    CheckWayMasks(config.partition.l3Masks, config.cache.l3Ways,
+                  "--l3_way_masks");
+    CheckWayMasks(config.partition.l2TlbMasks, config.tlb.l2Ways,
+                  "--l2_tlb_way_masks");
+    // Page tables store PFNs in 32 bits
+    if (config.physMemGb > (1ULL << 32) / ((1ULL << 30) / kMemTracePageSize)) {
+        throw std::invalid_argument(
+            "--phys_mem_gb must give at most 2^32 frames (" +
+            std::to_string((1ULL << 32) /
+                           ((1ULL << 30) / kMemTracePageSize)) +
+            " GB)");
+    }
+    // Page-table frames set aside by the placement policies
+    if (config.pgtbl.regionMb >= config.PhysicalMemBytes() >> 20) {
+        throw std::invalid_argument(
+            "--pt_region_mb must be smaller than physical memory");
+    }
+    if (config.pgtbl.colocateFrames >=
+        config.PhysicalMemBytes() / kMemTracePageSize) {
+        throw std::invalid_argument(
+            "--pt_colocate_frames must fit in physical memory");
+    }
+    if (config.tlb.l2Bypass && config.tlb.inclusion != kTlbNine) {
+        throw std::invalid_argument(
+            "--l2_tlb_bypass needs --tlb_inclusion nine");
+    }
+    if (config.partition.l3Ucp &&
+        (config.cache.l3Ways > 64 ||
+         config.UcpClassesOfService() > config.cache.l3Ways)) {
+        throw std::invalid_argument(
+            "--l3_ucp needs at most 64 L3 ways and a way per class of "
+            "service (" +
+            std::to_string(config.UcpClassesOfService()) + ")");
+    }
+}
+
+// Apply the option at argv[i] to config, moving i past its value. Returns
+// false for options outside the simulated machine; malformed values throw
+// std::invalid_argument (or std::out_of_range).
+inline bool ParseSimOption(int argc, char* argv[], int& i, SimConfig& config) {
+    std::string arg = argv[i];
+    if (arg == "--phys_mem_gb" && i + 1 < argc) {
+        config.physMemGb = ParsePositive(argv[++i]);
+    } else if (arg == "--huge_pages" && i + 1 < argc) {
+        if (!ParseHugePagePolicy(argv[++i], config.hugePages)) {
+            throw std::invalid_argument("unknown huge page policy " +
+                                        std::string(argv[i]));
+        }
+    } else if (arg == "--l1_tlb_size" && i + 1 < argc) {
+        config.tlb.l1Size = ParsePositive(argv[++i]);
+    } else if (arg == "--l1_tlb_ways" && i + 1 < argc) {
+        config.tlb.l1Ways = ParsePositive(argv[++i]);
+    } else if (arg == "--l2_tlb_size" && i + 1 < argc) {
+        config.tlb.l2Size = ParsePositive(argv[++i]);
+    } else if (arg == "--l2_tlb_ways" && i + 1 < argc) {
+        config.tlb.l2Ways = ParsePositive(argv[++i]);
+    } else if (arg == "--tlb_inclusion" && i + 1 < argc) {
+        std::string policy = argv[++i];
+        if (policy == "nine") {
+            config.tlb.inclusion = kTlbNine;
+        } else if (policy == "inclusive") {
+            config.tlb.inclusion = kTlbInclusive;
+        } else if (policy == "exclusive") {
+            config.tlb.inclusion = kTlbExclusive;
+        } else {
+            throw std::invalid_argument("unknown TLB inclusion policy " +
+                                        policy);
+        }
+    } else if (arg == "--victim_tlb_size" && i + 1 < argc) {
+        config.tlb.victimSize = std::stoull(argv[++i]);
+    } else if (arg == "--l2_tlb_bypass" && i + 1 < argc) {
+        config.tlb.l2Bypass = (std::stoi(argv[++i]) != 0);
+    } else if (arg == "--l1_cache_size" && i + 1 < argc) {
+        config.cache.l1Size = ParsePositive(argv[++i]);
+    } else if (arg == "--l1_ways" && i + 1 < argc) {
+        config.cache.l1Ways = ParsePositive(argv[++i]);
+    } else if (arg == "--l1_line" && i + 1 < argc) {
+        config.cache.l1Line = ParseLineSize(argv[++i]);
+    } else if (arg == "--l2_cache_size" && i + 1 < argc) {
+        config.cache.l2Size = ParsePositive(argv[++i]);
+    } else if (arg == "--l2_ways" && i + 1 < argc) {
+        config.cache.l2Ways = ParsePositive(argv[++i]);
+    } else if (arg == "--l2_line" && i + 1 < argc) {
+        config.cache.l2Line = ParseLineSize(argv[++i]);
+    } else if (arg == "--l3_cache_size" && i + 1 < argc) {
+        config.cache.l3Size = ParsePositive(argv[++i]);
+    } else if (arg == "--l3_ways" && i + 1 < argc) {
+        config.cache.l3Ways = ParsePositive(argv[++i]);
+    } else if (arg == "--l3_line" && i + 1 < argc) {
+        config.cache.l3Line = ParseLineSize(argv[++i]);
+    } else if (arg == "--pte_cachable" && i + 1 < argc) {
+        config.pgtbl.pteCachable = (std::stoi(argv[++i]) != 0);
+    } else if (arg == "--pgd_size" && i + 1 < argc) {
+        config.pgtbl.pgdSize = ParsePositive(argv[++i]);
+    } else if (arg == "--pud_size" && i + 1 < argc) {
+        config.pgtbl.pudSize = ParsePositive(argv[++i]);
+    } else if (arg == "--pmd_size" && i + 1 < argc) {
+        config.pgtbl.pmdSize = ParsePositive(argv[++i]);
+    } else if (arg == "--pte_size" && i + 1 < argc) {
+        config.pgtbl.pteSize = ParsePositive(argv[++i]);
+    } else if (arg == "--pgd_pwc_size" && i + 1 < argc) {
+        config.pwc.pgdSize = ParsePositive(argv[++i]);
+    } else if (arg == "--pgd_pwc_ways" && i + 1 < argc) {
+        config.pwc.pgdWays = ParsePositive(argv[++i]);
+    } else if (arg == "--pud_pwc_size" && i + 1 < argc) {
+        config.pwc.pudSize = ParsePositive(argv[++i]);
+    } else if (arg == "--pud_pwc_ways" && i + 1 < argc) {
+        config.pwc.pudWays = ParsePositive(argv[++i]);
+    } else if (arg == "--pmd_pwc_size" && i + 1 < argc) {
+        config.pwc.pmdSize = ParsePositive(argv[++i]);
+    } else if (arg == "--pmd_pwc_ways" && i + 1 < argc) {
+        config.pwc.pmdWays = ParsePositive(argv[++i]);
+    } else if (arg == "--toc_enabled" && i + 1 < argc) {
+        config.pgtbl.tocEnabled = (std::stoi(argv[++i]) != 0);
+    } else if (arg == "--toc_size" && i + 1 < argc) {
+        config.pgtbl.tocSize = std::stoull(argv[++i]);
+    } else if (arg == "--tlb_tag_regions" && i + 1 < argc) {
+        config.tagRegions.tlbRegions = std::stoull(argv[++i]);
+    } else if (arg == "--tlb_tag_offset_bits" && i + 1 < argc) {
+        config.tagRegions.tlbOffsetBits = std::stoull(argv[++i]);
+        if (config.tagRegions.tlbOffsetBits >= 64) {
+            throw std::invalid_argument("expected fewer than 64 bits");
+        }
+    } else if (arg == "--pwc_tag_regions" && i + 1 < argc) {
+        config.tagRegions.pwcRegions = std::stoull(argv[++i]);
+    } else if (arg == "--pwc_tag_offset_bits" && i + 1 < argc) {
+        config.tagRegions.pwcOffsetBits = std::stoull(argv[++i]);
+        if (config.tagRegions.pwcOffsetBits >= 64) {
+            throw std::invalid_argument("expected fewer than 64 bits");
+        }
+    } else if (arg == "--pt_placement" && i + 1 < argc) {
+        std::string policy = argv[++i];
+        if (policy == "interleaved") {
+            config.pgtbl.placement = kPtInterleaved;
+        } else if (policy == "reserved") {
+            config.pgtbl.placement = kPtReserved;
+        } else if (policy == "colocate") {
+            config.pgtbl.placement = kPtColocated;
+        } else if (policy == "node") {
+            config.pgtbl.placement = kPtSeparateNode;
+        } else {
+            throw std::invalid_argument("unknown page table placement " +
+                                        policy);
+        }
+    } else if (arg == "--pt_region_mb" && i + 1 < argc) {
+        config.pgtbl.regionMb = std::stoull(argv[++i]);
+    } else if (arg == "--pt_colocate_frames" && i + 1 < argc) {
+        config.pgtbl.colocateFrames = std::stoull(argv[++i]);
+        if (config.pgtbl.colocateFrames == 0) {
+            throw std::invalid_argument("expected a positive frame count");
+        }
+    } else if (arg == "--pte_insert_lru" && i + 1 < argc) {
+        config.pteLines.insertLru = (std::stoi(argv[++i]) != 0);
+    } else if (arg == "--pte_protected_ways" && i + 1 < argc) {
+        config.pteLines.protectedWays = std::stoull(argv[++i]);
+    } else if (arg == "--pte_pin_upper" && i + 1 < argc) {
+        config.pteLines.pinUpper = (std::stoi(argv[++i]) != 0);
+    } else if (arg == "--pte_cache_size" && i + 1 < argc) {
+        config.pteLines.cacheSize = std::stoull(argv[++i]);
+    } else if (arg == "--pte_cache_ways" && i + 1 < argc) {
+        config.pteLines.cacheWays = ParsePositive(argv[++i]);
+    } else if (arg == "--walk_prefetch" && i + 1 < argc) {
+        config.prefetch.walkEnabled = (std::stoi(argv[++i]) != 0);
+    } else if (arg == "--walk_prefetch_level" && i + 1 < argc) {
+        config.prefetch.walkLevel = std::stoull(argv[++i]);
+        if (config.prefetch.walkLevel != 2 && config.prefetch.walkLevel != 3) {
+            throw std::invalid_argument("expected 2 (L2 and L3) or 3 (L3)");
+        }
+    } else if (arg == "--walk_prefetch_lines" && i + 1 < argc) {
+        config.prefetch.walkLines = ParsePositive(argv[++i]);
+    } else if (arg == "--l2_way_masks" && i + 1 < argc) {
+        config.partition.l2Masks = ParseList(argv[++i]);
+    } else if (arg == "--l3_way_masks" && i + 1 < argc) {
+        config.partition.l3Masks = ParseList(argv[++i]);
+    } else if (arg == "--l2_tlb_way_masks" && i + 1 < argc) {
+        config.partition.l2TlbMasks = ParseList(argv[++i]);
+    } else if (arg == "--walk_cos" && i + 1 < argc) {
+        config.partition.walkCos = std::stoi(argv[++i]);
+        if (config.partition.walkCos < -1) {
+            throw std::invalid_argument("expected a class of service or -1");
+        }
+    } else if (arg == "--l3_ucp" && i + 1 < argc) {
+        config.partition.l3Ucp = (std::stoi(argv[++i]) != 0);
+    } else if (arg == "--ucp_interval" && i + 1 < argc) {
+        config.partition.ucpInterval = std::stoull(argv[++i]);
+        if (config.partition.ucpInterval == 0) {
+            throw std::invalid_argument("expected a positive interval");
+        }
+    } else if (arg == "--ucp_sample_stride" && i + 1 < argc) {
+        config.partition.ucpSampleStride = std::stoull(argv[++i]);
+        if (config.partition.ucpSampleStride == 0) {
+            throw std::invalid_argument("expected a positive stride");
+        }
+    } else if (arg == "--write_through" && i + 1 < argc) {
+        ParseLevelFlags(argv[++i], config.writes.writeThrough);
+    } else if (arg == "--write_allocate" && i + 1 < argc) {
+        ParseLevelFlags(argv[++i], config.writes.writeAllocate);
+    } else if (arg == "--store_buffer" && i + 1 < argc) {
+        config.writes.storeBuffer = std::stoull(argv[++i]);
+    } else if (arg == "--tlb_dirty" && i + 1 < argc) {
+        config.writes.tlbDirty = (std::stoi(argv[++i]) != 0);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline void PrintSimOptionsUsage(std::ostream& os) {
+    os << "Simulated machine:\n"
+       << "  --phys_mem_gb N           Physical memory size in GB "
+          "(default: 1)\n"
+       << "  --huge_pages P            Host page backing of large "
+          "simulator structures: off, thp or hugetlb (default: thp)\n"
+       << "  --l1_tlb_size N           L1 TLB size (default: 64)\n"
+       << "  --l1_tlb_ways N           L1 TLB associativity "
+          "(default: 4)\n"
+       << "  --l2_tlb_size N           L2 TLB size (default: 1024)\n"
+       << "  --l2_tlb_ways N           L2 TLB associativity "
+          "(default: 8)\n"
+       << "  --tlb_inclusion P         L1/L2 TLB relationship: nine, "
+          "inclusive or exclusive (default: nine)\n"
+       << "  --victim_tlb_size N       Fully-associative victim TLB "
+          "entries (default: 0, disabled)\n"
+       << "  --l2_tlb_bypass BOOL      PC-based dead-entry bypass of "
+          "the L2 TLB, with nine inclusion only (default: 0)\n"
+       << "  --l1_cache_size N         L1 Cache size in bytes "
+          "(default: 32768)\n"
+       << "  --l1Ways N               L1 Cache associativity "
+          "(default: 8)\n"
+       << "  --l1Line N               L1 Cache line size (default: "
+          "64)\n"
+       << "  --l2_cache_size N         L2 Cache size in bytes "
+          "(default: 262144)\n"
+       << "  --l2Ways N               L2 Cache associativity "
+          "(default: 16)\n"
+       << "  --l2Line N               L2 Cache line size (default: "
+          "64)\n"
+       << "  --l3_cache_size N         L3 Cache size in bytes "
+          "(default: 8388608)\n"
+       << "  --l3_ways N               L3 Cache associativity "
+          "(default: 16)\n"
+       << "  --l3Line N               L3 Cache line size (default: "
+          "64)\n"
+       << "  --pteCachable BOOL       PTE cacheable flag (default: "
+          "0)\n"
+       << "  --pgdSize N              PGD size in entries "
+          "(default: 512)\n"
+       << "  --pudSize N              PUD size in entries "
+          "(default: 512)\n"
+       << "  --pmdSize N              PMD size in entries "
+          "(default: 512)\n"
+       << "  --pteSize N              PTE size in entries "
+          "(default: 512)\n"
+       << "  --pgd_pwc_size N          PGD PWC size in entries "
+          "(default: 4)\n"
+       << "  --pgd_pwc_ways N          PGD PWC associativity "
+          "(default: 4)\n"
+       << "  --pud_pwc_size N          PUD PWC size in entries "
+          "(default: 4)\n"
+       << "  --pud_pwc_ways N          PUD PWC associativity "
+          "(default: 4)\n"
+       << "  --pmd_pwc_size N          PMD PWC size in entries "
+          "(default: 16)\n"
+       << "  --pmd_pwc_ways N          PMD PWC associativity "
+          "(default: 4)\n"
+       << " ---toc_enabled BOOL          Enable TOC (default: 0)\n"
+       << "  --toc_size N               TOC size in bytes "
+          "(default: 0)\n"
+       << "  --tlb_tag_regions N       Region registers for "
+          "range-limited TLB tags (default: 0, full tags)\n"
+       << "  --tlb_tag_offset_bits N   VPN bits kept per TLB entry "
+          "(default: 16)\n"
+       << "  --pwc_tag_regions N       Region registers for "
+          "range-limited PWC tags (default: 0, full tags)\n"
+       << "  --pwc_tag_offset_bits N   VA tag bits kept per PWC "
+          "entry (default: 9)\n"
+       << "  --pt_placement P          Page-table page placement: "
+          "interleaved, reserved, colocate or node "
+          "(default: interleaved)\n"
+       << "  --pt_region_mb N          Reserved page-table region "
+          "size in MB (default: 64)\n"
+       << "  --pt_colocate_frames N    Frames per block of sibling "
+          "tables (default: 8)\n"
+       << "  --pte_insert_lru BOOL     Insert page-table lines at "
+          "LRU in L2/L3 (default: 0)\n"
+       << "  --pte_protected_ways N    Page-table lines per L2/L3 "
+          "set protected from data fills (default: 0)\n"
+       << "  --pte_pin_upper BOOL      Never evict PGD/PUD lines "
+          "from L2/L3 (default: 0)\n"
+       << "  --pte_cache_size N        Dedicated PTE cache size in "
+          "bytes (default: 0, disabled)\n"
+       << "  --pte_cache_ways N        Dedicated PTE cache "
+          "associativity (default: 4)\n"
+       << "  --walk_prefetch BOOL      Prefetch the target line(s) "
+          "when a page walk completes (default: 0)\n"
+       << "  --walk_prefetch_level N   Walk prefetch fills L2+L3 (2) "
+          "or only L3 (3) (default: 2)\n"
+       << "  --walk_prefetch_lines N   Lines prefetched from the "
+          "target address (default: 1)\n"
+       << "  --l2_way_masks M0,M1,...  L2 allocation way mask per "
+          "class of service (tenant N uses COS N)\n"
+       << "  --l3_way_masks M0,M1,...  L3 allocation way mask per "
+          "class of service\n"
+       << "  --l2_tlb_way_masks M0,... L2 TLB allocation way mask "
+          "per ASID\n"
+       << "  --walk_cos N              Class of service of page walk "
+          "references (default: requester's)\n"
+       << "  --l3_ucp BOOL             Utility-based partitioning of "
+          "L3 (default: 0)\n"
+       << "  --ucp_interval N          L3 accesses between UCP "
+          "repartitions (default: 1000000)\n"
+       << "  --ucp_sample_stride N     UCP monitors every Nth set "
+          "(default: 32)\n"
+       << "  --write_through B1,B2,B3  Write-through per cache level "
+          "(default: 0,0,0, write-back)\n"
+       << "  --write_allocate B1,B2,B3 Allocate on write miss per "
+          "cache level (default: 1,1,1)\n"
+       << "  --store_buffer N          Store buffer entries; stores "
+          "leave the critical path until it fills (default: 0)\n"
+       << "  --tlb_dirty BOOL          First write to a page updates "
+          "its PTE dirty bit through the caches (default: 0)\n";
+}
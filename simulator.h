@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include "common.h"
+#include "data_cache.h"
+#include "page_table.h"
+#include "physical_memory.h"
+
+// Physical memory, caches and page table built from one configuration
+struct Simulator {
+    PhysicalMemory physicalMemory;
+    CacheHierarchy cacheHierarchy;
+    PageTable pageTable;
+
+    // Totals compared between configurations
+    struct Counters {
+        UINT64 tlbMisses = 0;
+        UINT64 walkMemAccesses = 0;
+        UINT64 memAccesses = 0;
+        UINT64 cycles = 0;
+    };
+
+    Simulator(const SimConfig& config)
+        : physicalMemory(config.PhysicalMemBytes()),
+          cacheHierarchy(
+              config.cache.l1Size, config.cache.l1Ways, config.cache.l1Line,
+              config.cache.l2Size, config.cache.l2Ways, config.cache.l2Line,
+              config.cache.l3Size, config.cache.l3Ways, config.cache.l3Line),
+          pageTable(physicalMemory, cacheHierarchy, config.pgtbl.pteCachable,
+                    config.tlb.l1Size, config.tlb.l1Ways, config.tlb.l2Size,
+                    config.tlb.l2Ways, config.pwc.pgdSize, config.pwc.pgdWays,
+                    config.pwc.pudSize, config.pwc.pudWays, config.pwc.pmdSize,
+                    config.pwc.pmdWays, config.pgtbl.pgdSize,
+                    config.pgtbl.pudSize, config.pgtbl.pmdSize,
+                    config.pgtbl.pteSize, config.pgtbl.tocEnabled,
+                    config.pgtbl.tocSize) {
+        // Page-table line treatment in the data caches
+        if (config.pteLines.insertLru || config.pteLines.protectedWays > 0 ||
+            config.pteLines.pinUpper) {
+            cacheHierarchy.SetPageTableLinePolicy(config.pteLines.insertLru,
+                                                  config.pteLines.protectedWays,
+                                                  config.pteLines.pinUpper);
+        }
+        if (config.pteLines.cacheSize > 0) {
+            cacheHierarchy.EnablePteCache(config.pteLines.cacheSize,
+                                          config.pteLines.cacheWays,
+                                          config.cache.l2Line);
+        }
+
+        if (config.tlb.inclusion != kTlbNine || config.tlb.victimSize > 0 ||
+            config.tlb.l2Bypass) {
+            pageTable.SetTlbPolicy(config.tlb.inclusion, config.tlb.victimSize,
+                                   config.tlb.l2Bypass);
+        }
+        if (config.tagRegions.tlbRegions > 0 ||
+            config.tagRegions.pwcRegions > 0) {
+            pageTable.SetTagRegions(
+                config.tagRegions.tlbRegions, config.tagRegions.tlbOffsetBits,
+                config.tagRegions.pwcRegions, config.tagRegions.pwcOffsetBits);
+        }
+        if (config.pgtbl.placement != kPtInterleaved) {
+            pageTable.SetTablePlacement(
+                config.pgtbl.placement,
+                config.pgtbl.regionMb * ((1ULL << 20) / kMemTracePageSize),
+                config.pgtbl.colocateFrames);
+        }
+        if (config.prefetch.walkEnabled) {
+            pageTable.SetWalkPrefetch(config.prefetch.walkLines,
+                                      config.prefetch.walkLevel);
+        }
+
+        // Store handling
+        bool defaultWrites = true;
+        for (int level = 0; level < 3; ++level) {
+            defaultWrites &= !config.writes.writeThrough[level] &&
+                             config.writes.writeAllocate[level];
+        }
+        if (!defaultWrites) {
+            cacheHierarchy.SetWritePolicy(config.writes.writeThrough,
+                                          config.writes.writeAllocate);
+        }
+        if (config.writes.storeBuffer > 0) {
+            cacheHierarchy.EnableStoreBuffer(config.writes.storeBuffer);
+        }
+        if (config.writes.tlbDirty) {
+            pageTable.EnableDirtyTracking();
+        }
+
+        // Way partitioning of the shared caches and L2 TLB
+        if (!config.partition.l2Masks.empty()) {
+            cacheHierarchy.SetWayMasks(2, config.partition.l2Masks);
+        }
+        if (!config.partition.l3Masks.empty()) {
+            cacheHierarchy.SetWayMasks(3, config.partition.l3Masks);
+        }
+        if (!config.partition.l2TlbMasks.empty()) {
+            pageTable.SetL2TlbWayMasks(config.partition.l2TlbMasks);
+        }
+        if (config.partition.walkCos >= 0) {
+            cacheHierarchy.SetWalkCos(config.partition.walkCos);
+        }
+        if (config.partition.l3Ucp) {
+            cacheHierarchy.EnableL3Ucp(config.UcpClassesOfService(),
+                                       config.partition.ucpInterval,
+                                       config.partition.ucpSampleStride);
+        }
+    }
+
+    // Translate and access a batch, the physical addresses go to paddrs (0
+    // for software prefetches dropped on an unmapped page)
+    void ProcessBatch(const MEMREF* buffer, UINT64 numElements,
+                      ADDRINT* paddrs) {
+        // Translate and access runs of TLB-resident accesses in bulk; an
+        // access that walks the page table goes alone, after the data
+        // accesses before it, so the walk sees the same cache state
+        UINT64 i = 0;
+        while (i < numElements) {
+            UINT64 translated = pageTable.TranslateBatch(
+                buffer + i, numElements - i, paddrs + i);
+            cacheHierarchy.AccessBatch(paddrs + i, buffer + i, translated);
+            i += translated;
+            if (i < numElements) {
+                const MEMREF& ref = buffer[i];
+                if (ref.flags & kMemRefPrefetch) {
+                    ProcessPrefetch(ref, paddrs[i]);
+                    i++;
+                    continue;
+                }
+                paddrs[i] = pageTable.Translate(ref.ea, ref.pc, !ref.read);
+                UINT64 value = 0;
+                cacheHierarchy.Access(paddrs[i], value, !ref.read, ref.flags);
+                i++;
+            }
+        }
+    }
+
+    // Software prefetch that missed the TLBs: its walk does not block the
+    // core either, so its cycles are hidden with the fill's
+    void ProcessPrefetch(const MEMREF& ref, ADDRINT& paddr) {
+        UINT64 start = cacheHierarchy.GetAccessCycles();
+        paddr = 0;
+        if (pageTable.TranslatePrefetch(ref.ea, ref.pc, paddr)) {
+            cacheHierarchy.SoftwarePrefetch(paddr, ref.flags);
+        }
+        cacheHierarchy.HidePrefetchCycles(cacheHierarchy.GetAccessCycles() -
+                                          start);
+    }
+
+    void SwitchAddressSpace(UINT64 asid) {
+        pageTable.SwitchAddressSpace(asid);
+        cacheHierarchy.SetRequester(asid);
+    }
+
+    Counters GetCounters() const {
+        const TranslationStats& ts = pageTable.GetTranslationStats();
+        Counters counters;
+        counters.tlbMisses = ts.GetTotalTranslation() - ts.GetTlbHits();
+        counters.walkMemAccesses = ts.pageWalkMemAccess;
+        counters.memAccesses = cacheHierarchy.memAccessCount;
+        counters.cycles = cacheHierarchy.GetTotalCycles();
+        return counters;
+    }
+};
@@ -0,0 +1,87 @@
+// synthetic_trace.cpp
+// Writes a deterministic synthetic MEMREF trace (see synthetic_trace.h),
+// used to train profile-guided builds and for benchmarking. Version 2
+// output (trace_format.h) spreads the accesses over several threads in
+// runs of kThreadRun, with 1-4 instructions per access.
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "synthetic_trace.h"
+#include "trace_format.h"
+
+using std::cerr;
+using std::cout;
+
+constexpr UINT64 kThreadRun = 64;
+
+int main(int argc, char* argv[]) {
+    UINT64 numAccesses = 1000000;
+    UINT64 seed = 1;
+    UINT32 format = 1;
+    UINT64 numThreads = 1;
+    std::string outputFile;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            cout << "Usage: " << argv[0] << " [options] <outputTrace>\n"
+                 << "Options:\n"
+                 << "  -h, --help                Show this help message\n"
+                 << "  --accesses N              Accesses to generate "
+                    "(default: 1000000)\n"
+                 << "  --seed N                  Random seed (default: 1)\n"
+                 << "  --format N                Trace format version, 1 or "
+                    "2 (default: 1)\n"
+                 << "  --threads N               Threads of a version 2 "
+                    "trace (default: 1)\n";
+            return 0;
+        } else if (arg == "--accesses" && i + 1 < argc) {
+            numAccesses = std::stoull(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        } else if (arg == "--format" && i + 1 < argc) {
+            format = std::stoul(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            numThreads = std::max<UINT64>(1, std::stoull(argv[++i]));
+        } else if (arg[0] != '-' && outputFile.empty()) {
+            outputFile = arg;
+        } else {
+            cerr << "Unknown option: " << arg << '\n';
+            return 1;
+        }
+    }
+
+    if (outputFile.empty()) {
+        cerr << "Error: No output trace specified" << '\n';
+        return 1;
+    }
+    if (format < 1 || format > kTraceFormatVersion) {
+        cerr << "Error: Unknown trace format " << format << '\n';
+        return 1;
+    }
+    std::ofstream output(outputFile, std::ios::binary);
+    if (!output.is_open()) {
+        cerr << "Error: Could not open output file: " << outputFile << '\n';
+        return 1;
+    }
+
+    SyntheticTrace trace(seed);
+    TraceWriter writer;
+    writer.Open(output, format, kTraceHasThreads | kTraceHasInstructions);
+    std::vector<MEMREF> buffer(4096);
+    std::vector<MemRefContext> context(buffer.size());
+    for (UINT64 done = 0; done < numAccesses; done += buffer.size()) {
+        UINT64 n = std::min<UINT64>(buffer.size(), numAccesses - done);
+        trace.Fill(buffer.data(), n);
+        for (UINT64 i = 0; i < n; ++i) {
+            context[i].tid = (done + i) / kThreadRun % numThreads;
+            context[i].instructions = 1 + (buffer[i].pc >> 2) % 4;
+        }
+        writer.Write(buffer.data(), context.data(), n);
+    }
+    output.close();
+    return 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include "common.h"
+
+// Deterministic synthetic MEMREF stream for benchmarks and profile
+// training: half random accesses over a 1GB heap (mostly walks), 30% a
+// sequential stream over 16MB (TLB hits), 20% random over a 1MB hot set
+class SyntheticTrace {
+   private:
+    static constexpr ADDRINT kHeapBase = 0x7f0000000000ULL;
+    static constexpr UINT64 kHeapBytes = 1ULL << 30;
+    static constexpr ADDRINT kStreamBase = 0x400000;
+    static constexpr UINT64 kStreamBytes = 1ULL << 24;
+    static constexpr ADDRINT kHotBase = 0x10000000;
+    static constexpr UINT64 kHotBytes = 1ULL << 20;
+    static constexpr ADDRINT kPcBase = 0x401000;
+    static constexpr UINT64 kNumPcs = 64;
+
+    UINT64 state_;  // xorshift64 state, never 0
+    UINT64 count_;  // Accesses generated so far
+
+    UINT64 NextRandom() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_;
+    }
+
+   public:
+    explicit SyntheticTrace(UINT64 seed = 1)
+        : state_(seed * 0x9e3779b97f4a7c15ULL | 1), count_(0) {}
+
+    MEMREF Next() {
+        MEMREF ref;
+        UINT64 kind = NextRandom() % 10;
+        if (kind < 5) {
+            ref.ea = kHeapBase + NextRandom() % kHeapBytes;
+        } else if (kind < 8) {
+            ref.ea = kStreamBase + (count_ * 64) % kStreamBytes;
+        } else {
+            ref.ea = kHotBase + NextRandom() % kHotBytes;
+        }
+        ref.pc = kPcBase + (NextRandom() % kNumPcs) * 4;
+        ref.size = 8;
+        ref.read = NextRandom() % 10 < 7 ? 1 : 0;
+        ref.flags = 0;
+        count_++;
+        return ref;
+    }
+
+    void Fill(MEMREF* buffer, UINT64 count) {
+        for (UINT64 i = 0; i < count; ++i) {
+            buffer[i] = Next();
+        }
+    }
+};
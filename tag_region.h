@@ -0,0 +1,118 @@
+#pragma once
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "common.h"
+
+// Range-limited tags (base + offset): a TLB or PWC entry keeps only the
+// low offsetBits of its tag plus the index of a region register holding the
+// upper bits. The few regions a sparse address space uses cover most
+// accesses with much narrower tags. Filling a tag whose region is not held
+// claims the least recently used register, and every entry still using
+// that register's old region must be dropped.
+//
+// The simulator keeps full tags in the owning cache (the mapping is exact
+// while a region is held), so only fills and region replacements change
+// behavior; this class tracks the registers and their cost.
+class TagRegionTable {
+   private:
+    UINT64 offsetBits_;
+    std::vector<UINT64> bases_;    // Tag bits above offsetBits_, per register
+    std::vector<UINT64> lastUse_;  // LRU stamp, 0 = register unused
+    UINT64 clock_;
+    UINT64 last_;  // Register of the previous access, checked first
+
+    UINT64 regionFills_;       // Fills that needed a register
+    UINT64 regionEvictions_;   // Registers reassigned to another region
+    UINT64 entriesDropped_;    // Entries invalidated by reassignment
+
+    UINT64 Find(UINT64 base) const {
+        if (lastUse_[last_] != 0 && bases_[last_] == base) {
+            return last_;
+        }
+        for (UINT64 i = 0; i < bases_.size(); ++i) {
+            if (lastUse_[i] != 0 && bases_[i] == base) {
+                return i;
+            }
+        }
+        return bases_.size();
+    }
+
+   public:
+    // At least one register, and an offset narrower than the tag
+    TagRegionTable(UINT64 regions, UINT64 offsetBits)
+        : offsetBits_(offsetBits),
+          bases_(regions, 0),
+          lastUse_(regions, 0),
+          clock_(0),
+          last_(0),
+          regionFills_(0),
+          regionEvictions_(0),
+          entriesDropped_(0) {
+        if (regions == 0 || offsetBits >= 64) {
+            throw std::invalid_argument(
+                "tag regions need a register and fewer than 64 offset bits");
+        }
+    }
+
+    UINT64 Region(UINT64 tag) const { return tag >> offsetBits_; }
+
+    // Hit on an entry with this tag: its region is held, refresh it
+    void Touch(UINT64 tag) {
+        UINT64 reg = Find(Region(tag));
+        if (reg < bases_.size()) {
+            lastUse_[reg] = ++clock_;
+            last_ = reg;
+        }
+    }
+
+    // Make the region of tag resident before filling it. Returns true when
+    // a register was taken from another region, whose base is stored in
+    // evictedRegion; the owner must then drop that region's entries.
+    bool Allocate(UINT64 tag, UINT64& evictedRegion) {
+        UINT64 base = Region(tag);
+        UINT64 reg = Find(base);
+        if (reg < bases_.size()) {
+            lastUse_[reg] = ++clock_;
+            last_ = reg;
+            return false;
+        }
+        regionFills_++;
+        reg = 0;
+        for (UINT64 i = 1; i < bases_.size(); ++i) {
+            if (lastUse_[i] < lastUse_[reg]) {
+                reg = i;
+            }
+        }
+        bool evicted = lastUse_[reg] != 0;
+        if (evicted) {
+            regionEvictions_++;
+            evictedRegion = bases_[reg];
+        }
+        bases_[reg] = base;
+        lastUse_[reg] = ++clock_;
+        last_ = reg;
+        return evicted;
+    }
+
+    void RecordDropped(UINT64 entries) { entriesDropped_ += entries; }
+
+    // Bits stored per entry: register index plus offset
+    UINT64 GetEntryTagBits() const {
+        UINT64 indexBits = 0;
+        while ((1ULL << indexBits) < bases_.size()) {
+            indexBits++;
+        }
+        return indexBits + offsetBits_;
+    }
+
+    void PrintStats(std::ostream& os, const std::string& name) const {
+        os << std::left << std::setw(22) << name << std::right
+           << std::setw(8) << bases_.size() << std::setw(10)
+           << GetEntryTagBits() << std::setw(14) << regionFills_
+           << std::setw(14) << regionEvictions_ << std::setw(14)
+           << entriesDropped_ << '\n';
+    }
+};
@@ -0,0 +1,70 @@
+// Replacement and write-back accounting of the data caches
+#include "data_cache.h"
+#include "unit_test.h"
+
+// One set of two 64-byte ways, nothing below it
+struct TwoWayCache {
+    UINT64 memAccesses = 0;
+    DataCache cache{"test", 128, 2, 64};
+
+    TwoWayCache() {
+        cache.SetNextLevel(nullptr);
+        cache.SetMemCounter(&memAccesses);
+    }
+};
+
+// 1 KB L1 (8 sets), 4 KB L2, 16 KB L3, all 2-way with 64-byte lines; a
+// miss to memory costs 1 + 4 + 10 + 100 cycles
+static const UINT64 kMissCycles = 115;
+
+TEST(LruEvictsLeastRecentlyUsed) {
+    TwoWayCache t;
+    UINT64 value = 0;
+    t.cache.Insert(1, 0);
+    t.cache.Insert(2, 0);
+    CHECK(t.cache.Lookup(1, value));  // 2 becomes LRU
+    t.cache.Insert(3, 0);
+    CHECK(t.cache.Contains(1));
+    CHECK(!t.cache.Contains(2));
+    CHECK(t.cache.Contains(3));
+}
+
+TEST(DirtyEvictionsWriteBack) {
+    TwoWayCache t;
+    t.cache.Insert(1, 0, /*isWrite*/ true);
+    t.cache.Insert(2, 0);
+    t.cache.Insert(3, 0);  // evicts dirty 1
+    CHECK_EQ(t.cache.GetWritebacks(), 1u);
+    CHECK_EQ(t.memAccesses, 1u);
+    t.cache.Insert(4, 0);  // evicts clean 2
+    CHECK_EQ(t.cache.GetWritebacks(), 1u);
+    CHECK_EQ(t.memAccesses, 1u);
+}
+
+TEST(HierarchyHitsAndMisses) {
+    CacheHierarchy caches(1024, 2, 64, 4096, 2, 64, 16384, 2, 64);
+    UINT64 value = 0;
+    CHECK(!caches.Access(0x1000, value, false));
+    CHECK_EQ(caches.memAccessCount, 1u);
+    CHECK_EQ(caches.GetTotalCycles(), kMissCycles);
+    CHECK(caches.Access(0x1008, value, false));  // same line, L1 hit
+    CHECK_EQ(caches.memAccessCount, 1u);
+    CHECK_EQ(caches.GetTotalCycles(), kMissCycles + 1);
+}
+
+TEST(HierarchyKeepsL1VictimsInL2) {
+    CacheHierarchy caches(1024, 2, 64, 4096, 2, 64, 16384, 2, 64);
+    UINT64 value = 0;
+    // Three lines of one L1 set: the third evicts the dirty first, which
+    // L2 still holds
+    caches.Access(0x0000, value, true);
+    caches.Access(0x0200, value, false);
+    caches.Access(0x0400, value, false);
+    CHECK_EQ(caches.memAccessCount, 3u);
+    UINT64 before = caches.GetTotalCycles();
+    CHECK(caches.Access(0x0000, value, false));
+    CHECK_EQ(caches.memAccessCount, 3u);
+    CHECK_EQ(caches.GetTotalCycles() - before, 1u + 4u);  // L1 miss, L2 hit
+}
+
+int main() { return RunAllTests(); }
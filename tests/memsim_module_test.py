@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""
+Checks of the memsim Python module: the MEMREF dtype matches the trace
+record, arrays of other dtypes are rejected, and memmap'd version 1
+traces go in as they are. Run by ctest with the module's directory on
+PYTHONPATH (-DMEMSIM_BUILD_PYTHON=ON).
+"""
+
+import os
+import tempfile
+import unittest
+
+import numpy as np
+
+import memsim
+
+PAGE_SIZE = 4096
+
+
+def page_sweep(count, base=0x10000000):
+    refs = np.zeros(count, dtype=memsim.MEMREF)
+    refs['pc'] = 0x400000
+    refs['ea'] = base + np.arange(count, dtype=np.uint64) * PAGE_SIZE + 8
+    refs['size'] = 8
+    refs['read'] = 1
+    return refs
+
+
+class DtypeTest(unittest.TestCase):
+    def test_layout_matches_trace_record(self):
+        dtype = memsim.MEMREF
+        self.assertEqual(dtype.itemsize, 24)
+        self.assertEqual(dtype.names, ('pc', 'ea', 'size', 'read', 'flags'))
+        offsets = [dtype.fields[name][1] for name in dtype.names]
+        self.assertEqual(offsets, [0, 8, 16, 20, 22])
+        self.assertEqual(memsim.MEMREF_CONTEXT.itemsize, 8)
+
+    def test_other_dtypes_are_rejected(self):
+        sim = memsim.Simulator()
+        with self.assertRaises(TypeError):
+            sim.access(np.zeros((4, 3), dtype=np.uint64))
+        self.assertEqual(sim.stats()['accesses'], 0)
+
+
+class AccessTest(unittest.TestCase):
+    def test_paddrs_keep_page_offset(self):
+        sim = memsim.Simulator(l2_tlb_size=2048)
+        refs = page_sweep(100)
+        paddrs = sim.access(refs, paddrs=True)
+        self.assertEqual(len(paddrs), 100)
+        self.assertTrue(np.all(paddrs % PAGE_SIZE == 8))
+        stats = sim.stats()
+        self.assertEqual(stats['accesses'], 100)
+        self.assertEqual(set(stats), set(memsim.STAT_NAMES))
+
+    def test_memmap_trace_matches_read_trace(self):
+        refs = page_sweep(1000)
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'sweep.trace')
+            refs.tofile(path)
+            mapped = np.memmap(path, dtype=memsim.MEMREF, mode='r')
+            decoded = memsim.read_trace(path)
+            self.assertTrue(np.array_equal(decoded, refs))
+
+            direct = memsim.Simulator()
+            direct.access(refs)
+            from_file = memsim.Simulator()
+            from_file.access(mapped[:500])
+            from_file.access(mapped[500:])
+            self.assertEqual(direct.stats(), from_file.stats())
+            del mapped
+
+    def test_bad_option_raises(self):
+        with self.assertRaises(ValueError):
+            memsim.Simulator(l1_ways=0)
+
+
+if __name__ == '__main__':
+    unittest.main()
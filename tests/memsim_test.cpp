@@ -0,0 +1,117 @@
+// Library interface: option validation, error reporting, snapshots
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "memsim.h"
+#include "unit_test.h"
+
+// count reads of consecutive pages from base
+static std::vector<MEMREF> PageSweep(ADDRINT base, UINT64 count) {
+    std::vector<MEMREF> refs(count);
+    for (UINT64 i = 0; i < count; ++i) {
+        refs[i] = {0x400000, base + i * kMemTracePageSize, 8, 1, 0};
+    }
+    return refs;
+}
+
+static bool SameStats(const memsim_stats& a, const memsim_stats& b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+TEST(ParseConfigRejectsBadValues) {
+    const std::vector<std::vector<std::string>> bad = {
+        {"--l1_ways", "0"},
+        {"--phys_mem_gb", "0"},
+        {"--l1_line", "48"},
+        {"--pt_colocate_frames", "0"},
+        {"--walk_prefetch_level", "1"},
+        {"--no_such_option", "1"},
+    };
+    for (const auto& options : bad) {
+        bool threw = false;
+        try {
+            MemorySimulator::ParseConfig(options);
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+    SimConfig config = MemorySimulator::ParseConfig({"--l2_tlb_size", "2048"});
+    CHECK_EQ(config.tlb.l2Size, 2048u);
+}
+
+TEST(ConstructorValidatesConfig) {
+    SimConfig config;
+    config.tlb.l2Size = 1000;  // 125 sets
+    bool threw = false;
+    try {
+        MemorySimulator sim(config);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+TEST(ConstructorRejectsFramesBeyond32Bits) {
+    SimConfig config;
+    config.physMemGb = 20000;  // more than 2^32 4 KB frames
+    bool threw = false;
+    try {
+        MemorySimulator sim(config);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+TEST(CreateReportsBadOptions) {
+    const char* options[] = {"--l3_way_masks", "0x10000", "--l3_ways", "16"};
+    CHECK(memsim_create(4, options, 0) == nullptr);
+    CHECK(strstr(memsim_last_error(), "--l3_way_masks") != nullptr);
+}
+
+TEST(ExhaustedMemoryIsAnError) {
+    const char* options[] = {"--phys_mem_gb", "1"};
+    memsim* sim = memsim_create(2, options, 0);
+    CHECK(sim != nullptr);
+    // More pages than the 262144 frames of 1 GB
+    std::vector<MEMREF> refs = PageSweep(0x10000000, 300000);
+    CHECK_EQ(memsim_access(sim,
+                           reinterpret_cast<const memsim_memref*>(refs.data()),
+                           refs.size()),
+             -1);
+    CHECK(strstr(memsim_last_error(), "exhausted") != nullptr);
+    memsim_destroy(sim);
+}
+
+TEST(RestoreRewindsToSnapshot) {
+    MemorySimulator sim(SimConfig(), /*snapshots*/ true);
+    std::vector<MEMREF> first = PageSweep(0x10000000, 2000);
+    std::vector<MEMREF> second = PageSweep(0x20000000, 3000);
+    sim.Access(first.data(), first.size());
+    UINT64 snapshot = sim.Snapshot();
+    memsim_stats atSnapshot = sim.GetStats();
+
+    sim.Access(second.data(), second.size());
+    memsim_stats afterSecond = sim.GetStats();
+    CHECK_EQ(afterSecond.accesses, 5000u);
+
+    sim.Restore(snapshot);
+    CHECK(SameStats(sim.GetStats(), atSnapshot));
+    // Replaying the same accesses lands on the same counters
+    sim.Access(second.data(), second.size());
+    CHECK(SameStats(sim.GetStats(), afterSecond));
+}
+
+TEST(SnapshotNeedsJournal) {
+    MemorySimulator sim{SimConfig()};
+    bool threw = false;
+    try {
+        sim.Snapshot();
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+int main() { return RunAllTests(); }
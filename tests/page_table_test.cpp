@@ -0,0 +1,46 @@
+// Translation paths of the page table and its table statistics
+#include "simulator.h"
+#include "unit_test.h"
+
+static SimConfig SmallConfig() {
+    SimConfig config;
+    config.physMemGb = 1;
+    return config;
+}
+
+TEST(WalkThenTlbHit) {
+    Simulator sim(SmallConfig());
+    ADDRINT first = sim.pageTable.Translate(0x7f0000001000);
+    const TranslationStats& stats = sim.pageTable.GetTranslationStats();
+    CHECK_EQ(stats.fullWalks, 1u);
+    CHECK(stats.pageWalkMemAccess > 0);
+
+    ADDRINT again = sim.pageTable.Translate(0x7f0000001008);
+    CHECK_EQ(again, first + 8);
+    CHECK_EQ(stats.l1TlbHits, 1u);
+    CHECK_EQ(stats.fullWalks, 1u);
+    CHECK_EQ(stats.GetTotalTranslation(), 2u);
+}
+
+TEST(NeighbourPageHitsPmdCache) {
+    Simulator sim(SmallConfig());
+    sim.pageTable.Translate(0x7f0000001000);
+    sim.pageTable.Translate(0x7f0000002000);  // same PTE table
+    const TranslationStats& stats = sim.pageTable.GetTranslationStats();
+    CHECK_EQ(stats.fullWalks, 1u);
+    CHECK_EQ(stats.pmdCacheHits, 1u);
+    CHECK_EQ(stats.GetTlbHits(), 0u);
+}
+
+TEST(FillBucketBoundaries) {
+    PageTableLevelStats stats("PTE", 3, 512);
+    CHECK_EQ(stats.FillBucket(0), 0u);
+    CHECK_EQ(stats.FillBucket(1), 1u);    // at most 1% full
+    CHECK_EQ(stats.FillBucket(5), 1u);
+    CHECK_EQ(stats.FillBucket(6), 2u);    // (1%, 10%]
+    CHECK_EQ(stats.FillBucket(52), 3u);   // (10%, 20%]
+    CHECK_EQ(stats.FillBucket(256), 6u);  // half full
+    CHECK_EQ(stats.FillBucket(512), kFillBuckets - 1);
+}
+
+int main() { return RunAllTests(); }
@@ -0,0 +1,79 @@
+// Software prefetches: dropped on unmapped pages, filled on mapped ones
+#include <vector>
+#include "simulator.h"
+#include "unit_test.h"
+
+static const ADDRINT kPage = 0x7f0000100000;
+
+static SimConfig SmallConfig() {
+    SimConfig config;
+    config.physMemGb = 1;
+    return config;
+}
+
+static MEMREF Load(ADDRINT ea) { return {0x400000, ea, 8, 1, 0}; }
+
+static MEMREF Prefetch(ADDRINT ea) {
+    return {0x400004, ea, 64, 1, kMemRefPrefetch};
+}
+
+TEST(PrefetchToUnmappedPageIsDropped) {
+    Simulator sim(SmallConfig());
+    UINT64 frames = sim.physicalMemory.GetAllocatedFrames();
+    MEMREF refs[] = {Prefetch(kPage), Prefetch(kPage + 4096)};
+    ADDRINT paddrs[2] = {1, 1};
+    sim.ProcessBatch(refs, 2, paddrs);
+
+    const TranslationStats& stats = sim.pageTable.GetTranslationStats();
+    CHECK_EQ(paddrs[0], 0u);
+    CHECK_EQ(paddrs[1], 0u);
+    CHECK_EQ(stats.droppedPrefetches, 2u);
+    CHECK_EQ(stats.GetTotalTranslation(), 0u);  // no walk
+    CHECK_EQ(sim.physicalMemory.GetAllocatedFrames(), frames);
+    CHECK_EQ(sim.cacheHierarchy.memAccessCount, 0u);
+    CHECK_EQ(sim.cacheHierarchy.GetTotalCycles(), 0u);
+}
+
+TEST(PrefetchToMappedPageFillsL1) {
+    Simulator sim(SmallConfig());
+    MEMREF refs[] = {Load(kPage), Prefetch(kPage + 256), Load(kPage + 256)};
+    ADDRINT paddrs[3];
+    sim.ProcessBatch(refs, 3, paddrs);
+
+    const TranslationStats& stats = sim.pageTable.GetTranslationStats();
+    CHECK_EQ(stats.droppedPrefetches, 0u);
+    CHECK_EQ(paddrs[1], paddrs[0] + 256);
+    const DataCache& l1 = sim.cacheHierarchy.GetCache(1);
+    CHECK_EQ(l1.GetPrefetchFills(kSoftwarePrefetch), 1u);
+    CHECK_EQ(l1.GetUsefulPrefetches(kSoftwarePrefetch), 1u);
+    // The demand load after the prefetch hits
+    CHECK_EQ(l1.GetAccesses() - l1.GetHits(), 1u);
+}
+
+TEST(PrefetchToMappedPageMissingTlbsWalks) {
+    Simulator sim(SmallConfig());
+    MEMREF first[] = {Prefetch(kPage), Load(kPage)};
+    ADDRINT paddrs[2];
+    sim.ProcessBatch(first, 2, paddrs);
+    CHECK_EQ(paddrs[0], 0u);
+
+    // Push the page out of both TLBs (1024 + 64 entries by default)
+    std::vector<MEMREF> sweep;
+    for (UINT64 page = 1; page <= 4096; ++page) {
+        sweep.push_back(Load(kPage + page * 4096));
+    }
+    std::vector<ADDRINT> sweepPaddrs(sweep.size());
+    sim.ProcessBatch(sweep.data(), sweep.size(), sweepPaddrs.data());
+
+    UINT64 walks = sim.pageTable.GetTranslationStats().GetTotalTranslation() -
+                   sim.pageTable.GetTranslationStats().GetTlbHits();
+    MEMREF last[] = {Prefetch(kPage + 64)};
+    ADDRINT paddr = 0;
+    sim.ProcessBatch(last, 1, &paddr);
+    const TranslationStats& stats = sim.pageTable.GetTranslationStats();
+    CHECK_EQ(paddr, paddrs[1] + 64);
+    CHECK_EQ(stats.droppedPrefetches, 1u);
+    CHECK_EQ(stats.GetTotalTranslation() - stats.GetTlbHits(), walks + 1);
+}
+
+int main() { return RunAllTests(); }
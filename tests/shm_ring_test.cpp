@@ -0,0 +1,177 @@
+// Producer/consumer hand-off through the shared-memory ring
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "shm_ring.h"
+#include "unit_test.h"
+
+static std::string RingName(const char* test) {
+    return "unit-test-" + std::to_string(getpid()) + "-" + test;
+}
+
+// Records whose ea is their stream position times 64
+static std::vector<MEMREF> Stream(UINT64 first, UINT64 count) {
+    std::vector<MEMREF> refs(count);
+    for (UINT64 i = 0; i < count; ++i) {
+        refs[i] = {0x400000, (first + i) * 64, 8, 1, 0};
+    }
+    return refs;
+}
+
+// Read count records in batches of batchSize, checking they continue the
+// stream from position first
+static bool ReadStream(ShmRingReader& reader, UINT64 first, UINT64 count,
+                       UINT64 batchSize) {
+    std::vector<MEMREF> buffer(batchSize);
+    for (UINT64 read = 0; read < count;) {
+        UINT64 n = reader.ReadBatch(buffer.data(), batchSize);
+        if (n == 0) {
+            return false;
+        }
+        for (UINT64 i = 0; i < n; ++i) {
+            if (buffer[i].ea != (first + read + i) * 64) {
+                return false;
+            }
+        }
+        read += n;
+    }
+    return true;
+}
+
+// The ring's header, mapped a second time to look at the cursors
+static ShmRingHeader* MapHeader(const std::string& name) {
+    int fd = open(ShmRingPath(name).c_str(), O_RDWR);
+    void* base = mmap(nullptr, sizeof(ShmRingHeader), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    close(fd);
+    return base == MAP_FAILED ? nullptr : static_cast<ShmRingHeader*>(base);
+}
+
+TEST(BatchLargerThanRingReturnsFullRing) {
+    const std::string name = RingName("batch");
+    ShmRingWriter writer;
+    CHECK(writer.Open(name, 8, 1));
+    ShmRingReader reader;
+    CHECK(reader.Open(name));
+
+    MEMREF refs[20];
+    for (UINT64 i = 0; i < 20; ++i) {
+        refs[i] = {0x400000, i * 64, 8, 1, 0};
+    }
+    std::atomic<bool> drained(false);
+    std::thread producer([&] {
+        writer.Publish(refs, 20);
+        while (!drained.load()) {
+            std::this_thread::yield();
+        }
+        writer.Close();
+    });
+
+    // Asking for more than the ring holds must not wait for the close
+    MEMREF buffer[64];
+    UINT64 read = 0;
+    while (read < 16) {
+        UINT64 n = reader.ReadBatch(buffer, 64);
+        CHECK_EQ(n, 8u);
+        for (UINT64 i = 0; i < n; ++i) {
+            CHECK_EQ(buffer[i].ea, (read + i) * 64);
+        }
+        read += n;
+    }
+    drained.store(true);
+    CHECK_EQ(reader.ReadBatch(buffer, 64), 4u);
+    CHECK_EQ(buffer[3].ea, 19u * 64);
+    CHECK_EQ(reader.ReadBatch(buffer, 64), 0u);
+    producer.join();
+    reader.Close();
+}
+
+TEST(ConsumerAttachesAfterWrap) {
+    const std::string name = RingName("late");
+    ShmRingWriter writer;
+    CHECK(writer.Open(name, 8, 1));
+    ShmRingReader early;
+    CHECK(early.Open(name));
+
+    std::vector<MEMREF> first = Stream(0, 20);
+    std::vector<MEMREF> second = Stream(20, 20);
+    std::atomic<int> step(0);
+    std::thread producer([&] {
+        writer.Publish(first.data(), first.size());
+        while (step.load() < 1) {
+            std::this_thread::yield();
+        }
+        writer.Publish(second.data(), second.size());
+        while (step.load() < 2) {
+            std::this_thread::yield();
+        }
+        writer.Close();
+    });
+
+    CHECK(ReadStream(early, 0, 20, 4));
+    // The ring has wrapped twice; the new consumer starts at the end
+    ShmRingReader late;
+    CHECK(late.Open(name));
+    step.store(1);
+    // Neither consumer loses a record while the producer laps them
+    bool lateOk = true, earlyOk = true;
+    for (UINT64 pos = 20; pos < 40; pos += 4) {
+        earlyOk &= ReadStream(early, pos, 4, 4);
+        lateOk &= ReadStream(late, pos, 4, 4);
+    }
+    CHECK(earlyOk);
+    CHECK(lateOk);
+    step.store(2);
+    MEMREF buffer[4];
+    CHECK_EQ(early.ReadBatch(buffer, 4), 0u);
+    CHECK_EQ(late.ReadBatch(buffer, 4), 0u);
+    producer.join();
+}
+
+TEST(StaleCursorHoldsProducerBack) {
+    const std::string name = RingName("stale");
+    ShmRingWriter writer;
+    CHECK(writer.Open(name, 8, 1));
+    ShmRingReader reader;
+    CHECK(reader.Open(name));
+    ShmRingHeader* header = MapHeader(name);
+    CHECK(header != nullptr);
+    if (!header) {
+        return;
+    }
+
+    std::vector<MEMREF> first = Stream(0, 20);
+    std::thread producer([&] { writer.Publish(first.data(), first.size()); });
+    CHECK(ReadStream(reader, 0, 20, 4));
+    producer.join();
+
+    // A slot showing a cursor from before the wrap, as a reused slot does
+    ShmRingHeader::Consumer& stale = header->consumers[1];
+    stale.pid.store(getpid());
+    stale.readPos.store(0);
+    stale.attached.store(kShmSlotAttached);
+
+    std::vector<MEMREF> second = Stream(20, 8);
+    std::atomic<bool> published(false);
+    producer = std::thread([&] {
+        writer.Publish(second.data(), second.size());
+        published.store(true);
+        writer.Close();
+    });
+    // The producer must wait for the stale consumer, not wrap past it
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(!published.load());
+    CHECK_EQ(header->writePos.load(), 20u);
+    stale.readPos.store(20);
+    CHECK(ReadStream(reader, 20, 8, 4));
+    producer.join();
+    stale.attached.store(kShmSlotFree);
+    munmap(header, sizeof(ShmRingHeader));
+}
+
+int main() { return RunAllTests(); }
@@ -0,0 +1,137 @@
+// Store buffer: store latency leaves the critical path until it fills;
+// flushes and non-temporal stores go around it. Also the PTE dirty-bit
+// updates of first writes to a page.
+#include "data_cache.h"
+#include "simulator.h"
+#include "unit_test.h"
+
+// 1 KB L1, 4 KB L2, 16 KB L3, all 2-way with 64-byte lines; a miss to
+// memory costs 1 + 4 + 10 + 100 cycles
+static const UINT64 kMissCycles = 115;
+
+
+TEST(BufferedStoreCostsIssueCycle) {
+    CacheHierarchy caches(1024, 2, 64, 4096, 2, 64, 16384, 2, 64);
+    caches.EnableStoreBuffer(4);
+    UINT64 value = 0;
+    caches.Access(0x10000, value, true);
+    CHECK_EQ(caches.GetAccessCycles(), kMissCycles);
+    CHECK_EQ(caches.GetTotalCycles(), 1u);
+}
+
+TEST(LoadsStayOnCriticalPath) {
+    CacheHierarchy caches(1024, 2, 64, 4096, 2, 64, 16384, 2, 64);
+    caches.EnableStoreBuffer(4);
+    UINT64 value = 0;
+    caches.Access(0x10000, value, false);
+    CHECK_EQ(caches.GetTotalCycles(), kMissCycles);
+}
+
+TEST(FullBufferStallsUntilOldestDrains) {
+    CacheHierarchy caches(1024, 2, 64, 4096, 2, 64, 16384, 2, 64);
+    caches.EnableStoreBuffer(2);
+    UINT64 value = 0;
+    caches.Access(0x10000, value, true);  // drains at 115
+    caches.Access(0x20000, value, true);  // drains at 230
+    CHECK_EQ(caches.GetTotalCycles(), 2u);
+    // Issued at cycle 2 into a full buffer: waits for the first to drain
+    caches.Access(0x30000, value, true);
+    CHECK_EQ(caches.GetTotalCycles(), kMissCycles + 1);
+}
+
+TEST(NoBufferKeepsStoreLatency) {
+    CacheHierarchy caches(1024, 2, 64, 4096, 2, 64, 16384, 2, 64);
+    UINT64 value = 0;
+    caches.Access(0x10000, value, true);
+    caches.Access(0x20000, value, true);
+    CHECK_EQ(caches.GetTotalCycles(), 2 * kMissCycles);
+}
+
+TEST(CleanFlushesDoNotUnderflowHiddenCycles) {
+    CacheHierarchy caches(1024, 2, 64, 4096, 2, 64, 16384, 2, 64);
+    caches.EnableStoreBuffer(8);
+    UINT64 value = 0;
+    // Write-backs and flushes of lines no level holds access nothing
+    for (UINT64 i = 0; i < 1000; ++i) {
+        caches.Access(i * 64, value, true,
+                      i % 2 ? kMemRefCleanLine : kMemRefFlush);
+    }
+    CHECK_EQ(caches.memAccessCount, 0u);
+    CHECK_EQ(caches.GetAccessCycles(), 0u);
+    CHECK_EQ(caches.GetTotalCycles(), 0u);
+}
+
+TEST(NonTemporalStoresCombinePerLine) {
+    CacheHierarchy caches(1024, 2, 64, 4096, 2, 64, 16384, 2, 64);
+    caches.EnableStoreBuffer(8);
+    UINT64 value = 0;
+    for (UINT64 offset = 0; offset < 64; offset += 8) {
+        caches.Access(0x10000 + offset, value, true, kMemRefNonTemporal);
+    }
+    caches.Access(0x10040, value, true, kMemRefNonTemporal);
+    CHECK_EQ(caches.memAccessCount, 2u);  // one write per line
+    CHECK_EQ(caches.GetTotalCycles(), caches.GetAccessCycles());
+    CHECK_EQ(caches.GetCache(1).GetAccesses(), 0u);  // no level filled
+}
+
+TEST(FlushDropsDirtyLineCleanKeepsIt) {
+    CacheHierarchy caches(1024, 2, 64, 4096, 2, 64, 16384, 2, 64);
+    UINT64 value = 0;
+    caches.Access(0x10000, value, true);
+    caches.Access(0x20000, value, true);
+    CHECK_EQ(caches.memAccessCount, 2u);
+
+    caches.Access(0x10000, value, true, kMemRefCleanLine);
+    CHECK_EQ(caches.memAccessCount, 3u);  // dirty line written back
+    CHECK(caches.Access(0x10000, value, false));  // and still cached
+    caches.Access(0x10000, value, true, kMemRefCleanLine);
+    CHECK_EQ(caches.memAccessCount, 3u);  // clean now
+
+    caches.Access(0x20000, value, true, kMemRefFlush);
+    CHECK_EQ(caches.memAccessCount, 4u);
+    CHECK(!caches.Access(0x20000, value, false));  // dropped everywhere
+    CHECK_EQ(caches.memAccessCount, 5u);
+}
+
+// Uncached page tables, so every PTE read goes to memory
+static SimConfig DirtyBitConfig() {
+    SimConfig config;
+    config.physMemGb = 1;
+    config.pgtbl.pteCachable = false;
+    config.writes.tlbDirty = true;
+    return config;
+}
+
+TEST(WriteThatWalksSetsDirtyBitWithoutRereadingPte) {
+    Simulator reads(DirtyBitConfig());
+    reads.pageTable.Translate(0x7f0000001000);
+    const UINT64 walkAccesses =
+        reads.pageTable.GetTranslationStats().pageWalkMemAccess;
+
+    Simulator sim(DirtyBitConfig());
+    sim.pageTable.Translate(0x7f0000001000, 0, true);
+    const TranslationStats& stats = sim.pageTable.GetTranslationStats();
+    CHECK_EQ(stats.fullWalks, 1u);
+    CHECK_EQ(stats.dirtyBitUpdates, 1u);
+    CHECK_EQ(stats.pageWalkMemAccess, walkAccesses);
+}
+
+TEST(WriteHittingCleanTlbEntryRereadsPte) {
+    Simulator sim(DirtyBitConfig());
+    sim.pageTable.Translate(0x7f0000001000);
+    const TranslationStats& stats = sim.pageTable.GetTranslationStats();
+    const UINT64 walkAccesses = stats.pageWalkMemAccess;
+    CHECK_EQ(stats.dirtyBitUpdates, 0u);
+
+    sim.pageTable.Translate(0x7f0000001008, 0, true);
+    CHECK_EQ(stats.l1TlbHits, 1u);
+    CHECK_EQ(stats.dirtyBitUpdates, 1u);
+    CHECK_EQ(stats.pageWalkMemAccess, walkAccesses + 1);
+
+    // Already dirty: later writes update nothing
+    sim.pageTable.Translate(0x7f0000001010, 0, true);
+    CHECK_EQ(stats.dirtyBitUpdates, 1u);
+    CHECK_EQ(stats.pageWalkMemAccess, walkAccesses + 1);
+}
+
+int main() { return RunAllTests(); }
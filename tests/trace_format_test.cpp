@@ -0,0 +1,71 @@
+// Round trips of the version 2 record codec and the trace writer
+#include <sstream>
+#include "trace_format.h"
+#include "unit_test.h"
+
+TEST(CodecRoundTrip) {
+    const MEMREF refs[] = {
+        {0x400000, 0x7fff0000, 8, 1, 0},
+        {0x400004, 0x7ffeff00, 4, 0, kMemRefNonTemporal},
+        {0x3ffff0, 0x10, 24, 1, kMemRefPrefetch | kMemRefPrefetchL2},
+        {0x3ffff0, 0x10, 1u << 20, 0, 0},
+    };
+    const MemRefContext contexts[] = {{0, 0}, {3, 17}, {3, 0}, {0, 1}};
+    UINT8 bytes[4 * kTraceMaxRecordBytes];
+
+    TraceCodec encoder;
+    UINT8* end = bytes;
+    for (int i = 0; i < 4; ++i) {
+        end = encoder.Encode(end, refs[i], contexts[i]);
+    }
+
+    TraceCodec decoder;
+    const UINT8* p = bytes;
+    for (int i = 0; i < 4; ++i) {
+        MEMREF ref = {};
+        MemRefContext context = {};
+        CHECK(decoder.Decode(p, end, ref, context));
+        CHECK_EQ(ref.pc, refs[i].pc);
+        CHECK_EQ(ref.ea, refs[i].ea);
+        CHECK_EQ(ref.size, refs[i].size);
+        CHECK_EQ(ref.read, refs[i].read);
+        CHECK_EQ(ref.flags, refs[i].flags);
+        CHECK_EQ(context.tid, contexts[i].tid);
+        CHECK_EQ(context.instructions, contexts[i].instructions);
+    }
+    CHECK(p == end);
+}
+
+TEST(CodecRejectsPartialRecord) {
+    const MEMREF ref = {0x401000, 0x12345678, 3, 1, kMemRefAtomic};
+    const MemRefContext context = {1, 2};
+    UINT8 bytes[kTraceMaxRecordBytes];
+    TraceCodec encoder;
+    UINT8* end = encoder.Encode(bytes, ref, context);
+
+    TraceCodec decoder;
+    for (const UINT8* cut = bytes; cut < end; ++cut) {
+        const UINT8* p = bytes;
+        MEMREF out = {};
+        MemRefContext outContext = {};
+        CHECK(!decoder.Decode(p, cut, out, outContext));
+        CHECK(p == bytes);
+    }
+    const UINT8* p = bytes;
+    MEMREF out = {};
+    MemRefContext outContext = {};
+    CHECK(decoder.Decode(p, end, out, outContext));
+    CHECK_EQ(out.ea, ref.ea);
+    CHECK_EQ(out.size, ref.size);
+}
+
+TEST(WriterVersionOneIsRawRecords) {
+    const MEMREF refs[] = {{1, 2, 8, 1, 0}, {3, 4, 4, 0, 0}};
+    std::ostringstream os;
+    TraceWriter writer;
+    writer.Open(os, 1);
+    writer.Write(refs, nullptr, 2);
+    CHECK_EQ(os.str().size(), sizeof(refs));
+}
+
+int main() { return RunAllTests(); }
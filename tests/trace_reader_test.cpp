@@ -0,0 +1,140 @@
+// Reading version 1 and version 2 traces back through TraceReader
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "trace_format.h"
+#include "trace_reader.h"
+#include "unit_test.h"
+
+// Enough records for version 2 reads to refill the byte buffer many times
+static const UINT64 kRecords = 100000;
+
+static std::string TracePath(const char* name) {
+    return std::string("trace_reader_test_") + std::to_string(getpid()) +
+           "_" + name + ".trace";
+}
+
+static void MakeTrace(std::vector<MEMREF>& refs,
+                      std::vector<MemRefContext>& contexts) {
+    refs.resize(kRecords);
+    contexts.resize(kRecords);
+    for (UINT64 i = 0; i < kRecords; ++i) {
+        refs[i] = {0x400000 + (i % 97) * 4, 0x7f0000000000 + (i * 328) % 1000003,
+                   i % 5 == 0 ? 12u : 8u, (UINT16)(i % 3 != 0),
+                   (UINT16)(i % 11 == 0 ? kMemRefNonTemporal : 0)};
+        contexts[i] = {(UINT32)(i % 4), (UINT32)(i % 7)};
+    }
+}
+
+static void WriteTrace(const std::string& path, UINT32 version,
+                       const std::vector<MEMREF>& refs,
+                       const std::vector<MemRefContext>& contexts) {
+    std::ofstream os(path, std::ios::binary);
+    TraceWriter writer;
+    writer.Open(os, version, kTraceHasThreads | kTraceHasInstructions);
+    // Uneven batches, so records straddle write boundaries
+    for (UINT64 i = 0; i < refs.size(); i += 1000) {
+        UINT64 count = std::min<UINT64>(1000, refs.size() - i);
+        writer.Write(&refs[i], &contexts[i], count);
+    }
+}
+
+// Read everything back in batches of batchSize
+static UINT64 ReadAll(TraceReader& reader, UINT64 batchSize,
+                      std::vector<MEMREF>& refs,
+                      std::vector<MemRefContext>& contexts) {
+    std::vector<MEMREF> buffer(batchSize);
+    std::vector<MemRefContext> context(batchSize);
+    UINT64 batches = 0;
+    while (UINT64 n = reader.ReadBatch(buffer.data(), batchSize,
+                                       context.data())) {
+        refs.insert(refs.end(), buffer.begin(), buffer.begin() + n);
+        contexts.insert(contexts.end(), context.begin(), context.begin() + n);
+        batches++;
+    }
+    return batches;
+}
+
+static bool SameRef(const MEMREF& a, const MEMREF& b) {
+    return a.pc == b.pc && a.ea == b.ea && a.size == b.size &&
+           a.read == b.read && a.flags == b.flags;
+}
+
+TEST(ReadsVersion1) {
+    std::vector<MEMREF> refs;
+    std::vector<MemRefContext> contexts;
+    MakeTrace(refs, contexts);
+    std::string path = TracePath("v1");
+    WriteTrace(path, 1, refs, contexts);
+
+    TraceReader reader;
+    CHECK(reader.Open(path));
+    CHECK_EQ(reader.GetVersion(), 1u);
+    std::vector<MEMREF> read;
+    std::vector<MemRefContext> readContexts;
+    ReadAll(reader, 4093, read, readContexts);
+    CHECK_EQ(read.size(), kRecords);
+    CHECK_EQ(reader.GetRecordsRead(), kRecords);
+    bool same = read.size() == kRecords;
+    for (UINT64 i = 0; same && i < kRecords; ++i) {
+        same = SameRef(read[i], refs[i]) && readContexts[i].tid == 0 &&
+               readContexts[i].instructions == 0;
+    }
+    CHECK(same);
+    remove(path.c_str());
+}
+
+TEST(ReadsVersion2) {
+    std::vector<MEMREF> refs;
+    std::vector<MemRefContext> contexts;
+    MakeTrace(refs, contexts);
+    std::string path = TracePath("v2");
+    WriteTrace(path, 2, refs, contexts);
+
+    TraceReader reader;
+    CHECK(reader.Open(path));
+    CHECK_EQ(reader.GetVersion(), 2u);
+    CHECK_EQ(reader.GetFeatures(),
+             (UINT32)(kTraceHasThreads | kTraceHasInstructions));
+    std::vector<MEMREF> read;
+    std::vector<MemRefContext> readContexts;
+    ReadAll(reader, 4093, read, readContexts);
+    CHECK_EQ(read.size(), kRecords);
+    bool same = read.size() == kRecords;
+    for (UINT64 i = 0; same && i < kRecords; ++i) {
+        same = SameRef(read[i], refs[i]) &&
+               readContexts[i].tid == contexts[i].tid &&
+               readContexts[i].instructions == contexts[i].instructions;
+    }
+    CHECK(same);
+    remove(path.c_str());
+}
+
+TEST(ReadsShortVersion1) {
+    // One record: shorter than the bytes sniffed for a header plus more
+    const MEMREF ref = {0x400000, 0x1000, 8, 1, 0};
+    std::string path = TracePath("short");
+    {
+        std::ofstream os(path, std::ios::binary);
+        TraceWriter writer;
+        writer.Open(os, 1);
+        writer.Write(&ref, nullptr, 1);
+    }
+    TraceReader reader;
+    CHECK(reader.Open(path));
+    MEMREF buffer[4];
+    CHECK_EQ(reader.ReadBatch(buffer, 4), 1u);
+    CHECK(SameRef(buffer[0], ref));
+    CHECK_EQ(reader.ReadBatch(buffer, 4), 0u);
+    remove(path.c_str());
+}
+
+TEST(OpenFailsOnMissingFile) {
+    TraceReader reader;
+    CHECK(!reader.Open(TracePath("missing")));
+}
+
+int main() { return RunAllTests(); }
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Minimal unit test harness, free of dependencies like the rest of the
+// build. TEST(Name) registers a test; CHECK and CHECK_EQ record a failure
+// and let the test go on. Every test binary ends with
+//
+//   int main() { return RunAllTests(); }
+//
+// and is registered with CTest through memsim_add_test (CMakeLists.txt).
+// The checks are not asserts, so they also run in Release builds.
+
+struct UnitTest {
+    const char* name;
+    std::function<void()> body;
+};
+
+inline std::vector<UnitTest>& UnitTests() {
+    static std::vector<UnitTest> tests;
+    return tests;
+}
+
+inline int& UnitTestFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+struct UnitTestRegistrar {
+    UnitTestRegistrar(const char* name, std::function<void()> body) {
+        UnitTests().push_back({name, std::move(body)});
+    }
+};
+
+#define TEST(name)                                               \
+    static void name();                                          \
+    static UnitTestRegistrar name##Registrar(#name, name);       \
+    static void name()
+
+#define CHECK(condition)                                                   \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            std::cerr << __FILE__ << ":" << __LINE__                       \
+                      << ": CHECK failed: " #condition << '\n';            \
+            UnitTestFailures()++;                                          \
+        }                                                                  \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                         \
+    do {                                                                   \
+        auto actualValue = (actual);                                       \
+        auto expectedValue = (expected);                                   \
+        if (!(actualValue == expectedValue)) {                             \
+            std::cerr << __FILE__ << ":" << __LINE__                       \
+                      << ": CHECK_EQ failed: " #actual " is "              \
+                      << actualValue << ", expected " << expectedValue     \
+                      << '\n';                                             \
+            UnitTestFailures()++;                                          \
+        }                                                                  \
+    } while (0)
+
+// Run the registered tests, returns the process exit code
+inline int RunAllTests() {
+    for (const UnitTest& test : UnitTests()) {
+        int before = UnitTestFailures();
+        test.body();
+        std::cout << (UnitTestFailures() == before ? "[ OK ] " : "[FAIL] ")
+                  << test.name << '\n';
+    }
+    if (UnitTestFailures() > 0) {
+        std::cerr << UnitTestFailures() << " check(s) failed\n";
+        return 1;
+    }
+    return 0;
+}
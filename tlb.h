@@ -1,10 +1,95 @@
 #pragma once
 
+#include <memory>
+#include <vector>
 #include "cache.h"
 #include "common.h"
+#include "tag_region.h"
+
+// PC-indexed dead-entry predictor for L2 TLB bypass: 2-bit saturating
+// counters trained up when an entry is evicted without reuse and down when
+// an entry hits.
+class TlbDeadEntryPredictor {
+   private:
+    static constexpr UINT64 kTableSize = 4096;
+    static constexpr UINT8 kCounterMax = 3;
+    static constexpr UINT64 kSampleRate = 32;  // Insert 1/N predicted-dead
+
+    std::vector<UINT8> counters_;
+    UINT8 threshold_;
+    UINT64 deadPredictions_;  // Fills predicted dead
+    UINT64 bypasses_;         // Fills actually bypassed
+
+   public:
+    TlbDeadEntryPredictor(UINT8 threshold = 2)
+        : counters_(kTableSize, 0),
+          threshold_(threshold),
+          deadPredictions_(0),
+          bypasses_(0) {}
+
+    static UINT16 Signature(ADDRINT pc) {
+        return (pc ^ (pc >> 12) ^ (pc >> 24)) & (kTableSize - 1);
+    }
+
+    // Whether a fill with this signature should skip the TLB. A sample of
+    // predicted-dead fills is still inserted so the predictor can unlearn.
+    bool ShouldBypass(UINT16 signature) {
+        if (counters_[signature] < threshold_) {
+            return false;
+        }
+        if (++deadPredictions_ % kSampleRate == 0) {
+            return false;
+        }
+        bypasses_++;
+        return true;
+    }
+
+    void TrainDead(UINT16 signature) {
+        if (counters_[signature] < kCounterMax) {
+            counters_[signature]++;
+        }
+    }
+
+    void TrainLive(UINT16 signature) {
+        if (counters_[signature] > 0) {
+            counters_[signature]--;
+        }
+    }
+
+    UINT64 GetDeadPredictions() const { return deadPredictions_; }
+    UINT64 GetBypasses() const { return bypasses_; }
+};
 
 // Translation Lookaside Buffer (TLB) - maps VPN to PFN
 class TLB : public SetAssociativeCache<UINT64, UINT64> {
+   private:
+    // Last entry evicted by Insert, consumed by TakeEviction
+    bool evicted_ = false;
+    UINT64 evictedVpn_ = 0;
+    UINT64 evictedPfn_ = 0;
+
+    // Per-entry fill signature and reuse bit, kept when a predictor is set
+    TlbDeadEntryPredictor* predictor_ = nullptr;
+    std::vector<UINT16> signatures_;
+    std::vector<bool> reused_;
+
+    std::unique_ptr<TagRegionTable> regions_;  // Range-limited tags, if set
+    std::vector<UINT64> droppedVpns_;  // Dropped by the last Insert's region
+
+    // Claim the region of vpn, dropping the entries of a replaced region
+    void AllocateRegion(UINT64 vpn) {
+        UINT64 evicted;
+        if (!regions_->Allocate(vpn, evicted)) {
+            return;
+        }
+        droppedVpns_ = FindTags(
+            [&](UINT64 tag) { return regions_->Region(tag) == evicted; });
+        for (UINT64 tag : droppedVpns_) {
+            Invalidate(tag);
+        }
+        regions_->RecordDropped(droppedVpns_.size());
+    }
+
    protected:
     // Hash function to map VPN to set index
     UINT64 GetSetIndex(const UINT64& vpn) const override {
@@ -12,8 +97,11 @@ class TLB : public SetAssociativeCache<UINT64, UINT64> {
     }
     void HandleEviction(const UINT64& vpn, const UINT64& pfn,
                         bool dirty) override {
-        // No eviction handling needed for TLB
-        // (TLB entries are not written back to memory)
+        // TLB entries are not written back to memory, but the owner may move
+        // the victim to another TLB level
+        evicted_ = true;
+        evictedVpn_ = vpn;
+        evictedPfn_ = pfn;
     }
 
    public:
@@ -24,13 +112,80 @@ class TLB : public SetAssociativeCache<UINT64, UINT64> {
               numEntries / associativity,  // Sets = Total entries / Ways
               associativity) {}
 
+    // Track entry reuse and train the predictor on hits and evictions
+    void SetDeadEntryPredictor(TlbDeadEntryPredictor* predictor) {
+        predictor_ = predictor;
+        signatures_.assign(numSets_ * numWays_, 0);
+        reused_.assign(numSets_ * numWays_, false);
+    }
+
+    // Store tags as one of regions base registers plus offsetBits of VPN
+    void EnableTagRegions(UINT64 regions, UINT64 offsetBits) {
+        regions_.reset(new TagRegionTable(regions, offsetBits));
+    }
+    const TagRegionTable* GetTagRegions() const { return regions_.get(); }
+
     // VPN to PFN mapping lookup
     bool Lookup(UINT64 vpn, UINT64& pfn) {
-        return SetAssociativeCache<UINT64, UINT64>::Lookup(vpn, pfn);
+        if (Probe(vpn, pfn)) {
+            return true;
+        }
+        CountMiss();
+        return false;
+    }
+
+    // Lookup counting only a hit (see SetAssociativeCache::Probe)
+    bool Probe(UINT64 vpn, UINT64& pfn) {
+        bool hit = SetAssociativeCache<UINT64, UINT64>::Probe(vpn, pfn);
+        if (hit && regions_) {
+            regions_->Touch(vpn);
+        }
+        if (hit && predictor_) {
+            UINT64 setIndex = GetSetIndex(vpn);
+            UINT64 entry = setIndex * numWays_ + FindWay(setIndex, vpn);
+            if (!reused_[entry]) {
+                reused_[entry] = true;
+                predictor_->TrainLive(signatures_[entry]);
+            }
+        }
+        return hit;
     }
 
-    // Insert VPN to PFN mapping
-    void Insert(UINT64 vpn, UINT64 pfn) {
-        SetAssociativeCache<UINT64, UINT64>::Insert(vpn, pfn);
+    // Insert VPN to PFN mapping, signature identifies the filling PC
+    void Insert(UINT64 vpn, UINT64 pfn, UINT16 signature = 0) {
+        evicted_ = false;
+        droppedVpns_.clear();
+        if (regions_) {
+            AllocateRegion(vpn);
+        }
+        if (!predictor_) {
+            SetAssociativeCache<UINT64, UINT64>::Insert(vpn, pfn);
+            return;
+        }
+        bool present = Contains(vpn);
+        UINT64 way = SetAssociativeCache<UINT64, UINT64>::Insert(vpn, pfn);
+        if (present) {
+            return;
+        }
+        UINT64 entry = GetSetIndex(vpn) * numWays_ + way;
+        if (evicted_ && !reused_[entry]) {
+            predictor_->TrainDead(signatures_[entry]);
+        }
+        signatures_[entry] = signature;
+        reused_[entry] = false;
+    }
+
+    // Entries the last Insert dropped with a replaced tag region
+    const std::vector<UINT64>& GetDroppedVpns() const { return droppedVpns_; }
+
+    // Fetch the entry evicted by the last Insert, if any
+    bool TakeEviction(UINT64& vpn, UINT64& pfn) {
+        if (!evicted_) {
+            return false;
+        }
+        evicted_ = false;
+        vpn = evictedVpn_;
+        pfn = evictedPfn_;
+        return true;
     }
-};
\ No newline at end of file
+};
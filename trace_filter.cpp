@@ -0,0 +1,98 @@
+// trace_filter.cpp
+// Standalone tool that applies the trace filter pipeline to a MEMREF trace
+// and writes the surviving accesses to a new trace file. Either file may be
+// "-" (stdin/stdout) to run the filter inside a pipeline. The output keeps
+// the input's trace format unless --format converts it.
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "trace_filter.h"
+#include "trace_format.h"
+#include "trace_reader.h"
+
+using std::cerr;
+using std::cout;
+
+int main(int argc, char* argv[]) {
+    std::vector<TraceFilterStage> stages;
+    std::vector<std::string> files;
+    UINT64 batchSize = 4096;
+    UINT32 format = 0;  // 0 = same as the input
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            cout << "Usage: " << argv[0]
+                 << " [options] <inputTrace> <outputTrace>\n"
+                 << "Options:\n"
+                 << "  -h, --help                Show this help message\n"
+                 << "  --batch_size N            Batch size for processing "
+                    "(default: 4096)\n"
+                 << "  --format N                Write trace format version "
+                    "1 or 2 (default: the input's)\n"
+                 << "  <inputTrace> may be a FIFO, a Unix socket or - "
+                    "(stdin); <outputTrace> may be - (stdout)\n";
+            PrintFilterUsage(cout);
+            return 0;
+        } else if (arg == "--batch_size" && i + 1 < argc) {
+            batchSize = std::stoull(argv[++i]);
+        } else if (arg == "--format" && i + 1 < argc) {
+            format = std::stoul(argv[++i]);
+            if (format < 1 || format > kTraceFormatVersion) {
+                cerr << "Error: Unknown trace format " << format << '\n';
+                return 1;
+            }
+        } else if (ParseFilterOption(argc, argv, i, stages)) {
+            // Filter stage appended to stages
+        } else if ((arg == "-" || arg[0] != '-') && files.size() < 2) {
+            files.push_back(arg);
+        } else {
+            cerr << "Unknown option: " << arg << '\n';
+            return 1;
+        }
+    }
+
+    if (files.size() != 2) {
+        cerr << "Error: Expected an input and an output trace file" << '\n';
+        return 1;
+    }
+
+    TraceReader input;
+    if (!input.Open(files[0])) {
+        cerr << "Error: Could not open trace file: " << files[0] << '\n';
+        return 1;
+    }
+    // Statistics move to stderr when the trace goes to stdout
+    bool toStdout = files[1] == "-";
+    std::ofstream outputFile;
+    if (!toStdout) {
+        outputFile.open(files[1], std::ios::binary);
+        if (!outputFile.is_open()) {
+            cerr << "Error: Could not open output file: " << files[1] << '\n';
+            return 1;
+        }
+    }
+    std::ostream& output = toStdout ? cout : outputFile;
+
+    TraceFilter filter(stages);
+    TraceWriter writer;
+    writer.Open(output, format ? format : input.GetVersion(),
+                input.GetFeatures());
+    std::vector<MEMREF> buffer(batchSize);
+    std::vector<MemRefContext> context(batchSize);
+    while (UINT64 records = input.ReadBatch(buffer.data(), buffer.size(),
+                                            context.data())) {
+        records = filter.Apply(buffer.data(), records, context.data());
+        writer.Write(buffer.data(), context.data(), records);
+    }
+    input.Close();
+    output.flush();
+    if (!toStdout) {
+        outputFile.close();
+    }
+
+    filter.PrintStats(toStdout ? cerr : cout);
+    return 0;
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "common.h"
+
+// Composable filter/transform pipeline applied to whole MEMREF batches
+// between the trace reader and the simulator. Predicate stages compact the
+// batch in place with a branch-free loop, transform stages rewrite addresses.
+// A batch's MemRefContext array, if any, is compacted along with it; the
+// instruction deltas of dropped accesses are dropped with them.
+class TraceFilter {
+   private:
+    std::vector<TraceFilterStage> stages_;
+    std::vector<UINT64> dropped_;  // Accesses removed by each stage
+    UINT64 inputRecords_;          // Accesses fed into the pipeline
+    UINT64 outputRecords_;         // Accesses that survived all stages
+
+    // Keep the entries for which keep(ref, context) holds, preserving order
+    template <typename Pred>
+    static UINT64 Compact(MEMREF* buffer, MemRefContext* context,
+                          UINT64 numElements, Pred keep) {
+        UINT64 out = 0;
+        if (!context) {
+            const MemRefContext none = {0, 0};
+            for (UINT64 i = 0; i < numElements; ++i) {
+                buffer[out] = buffer[i];
+                out += keep(buffer[i], none) ? 1 : 0;
+            }
+            return out;
+        }
+        for (UINT64 i = 0; i < numElements; ++i) {
+            buffer[out] = buffer[i];
+            context[out] = context[i];
+            out += keep(buffer[i], context[i]) ? 1 : 0;
+        }
+        return out;
+    }
+
+   public:
+    TraceFilter(const std::vector<TraceFilterStage>& stages = {})
+        : stages_(stages),
+          dropped_(stages.size(), 0),
+          inputRecords_(0),
+          outputRecords_(0) {}
+
+    bool IsEmpty() const { return stages_.empty(); }
+
+    // Filter the batch (and its context, if given) in place, returns the
+    // number of entries kept
+    UINT64 Apply(MEMREF* buffer, UINT64 numElements,
+                 MemRefContext* context = nullptr) {
+        inputRecords_ += numElements;
+        for (size_t s = 0; s < stages_.size() && numElements > 0; ++s) {
+            const TraceFilterStage& stage = stages_[s];
+            const UINT64 lo = stage.lo;
+            const UINT64 hi = stage.hi;
+            UINT64 kept = numElements;
+            switch (stage.kind) {
+                case TraceFilterStage::kReadsOnly:
+                    kept = Compact(buffer, context, numElements,
+                                   [](const MEMREF& r, const MemRefContext&) {
+                                       return r.read != 0;
+                                   });
+                    break;
+                case TraceFilterStage::kWritesOnly:
+                    kept = Compact(buffer, context, numElements,
+                                   [](const MEMREF& r, const MemRefContext&) {
+                                       return r.read == 0;
+                                   });
+                    break;
+                case TraceFilterStage::kPcRange:
+                    // Unsigned wrap turns the two-sided test into one compare
+                    kept = Compact(buffer, context, numElements,
+                                   [=](const MEMREF& r, const MemRefContext&) {
+                                       return r.pc - lo < hi - lo;
+                                   });
+                    break;
+                case TraceFilterStage::kEaRange:
+                    kept = Compact(buffer, context, numElements,
+                                   [=](const MEMREF& r, const MemRefContext&) {
+                                       return r.ea - lo < hi - lo;
+                                   });
+                    break;
+                case TraceFilterStage::kThread:
+                    kept = Compact(buffer, context, numElements,
+                                   [=](const MEMREF&, const MemRefContext& c) {
+                                       return c.tid == lo;
+                                   });
+                    break;
+                case TraceFilterStage::kRebase:
+                    for (UINT64 i = 0; i < numElements; ++i) {
+                        buffer[i].ea = buffer[i].ea - lo + hi;
+                    }
+                    break;
+                case TraceFilterStage::kScale:
+                    for (UINT64 i = 0; i < numElements; ++i) {
+                        buffer[i].ea *= lo;
+                    }
+                    break;
+            }
+            dropped_[s] += numElements - kept;
+            numElements = kept;
+        }
+        outputRecords_ += numElements;
+        return numElements;
+    }
+
+    static std::string Describe(const TraceFilterStage& stage) {
+        std::ostringstream os;
+        os << std::hex << std::showbase;
+        switch (stage.kind) {
+            case TraceFilterStage::kReadsOnly:
+                os << "reads only";
+                break;
+            case TraceFilterStage::kWritesOnly:
+                os << "writes only";
+                break;
+            case TraceFilterStage::kPcRange:
+                os << "pc in [" << stage.lo << ", " << stage.hi << ")";
+                break;
+            case TraceFilterStage::kEaRange:
+                os << "ea in [" << stage.lo << ", " << stage.hi << ")";
+                break;
+            case TraceFilterStage::kRebase:
+                os << "rebase " << stage.lo << " -> " << stage.hi;
+                break;
+            case TraceFilterStage::kScale:
+                os << std::dec << "scale ea by " << stage.lo;
+                break;
+            case TraceFilterStage::kThread:
+                os << std::dec << "thread " << stage.lo;
+                break;
+        }
+        return os.str();
+    }
+
+    void PrintStats(std::ostream& os) const {
+        if (stages_.empty()) {
+            return;
+        }
+        os << "\nTrace Filter Statistics:\n";
+        os << "========================\n";
+        os << std::left << std::setw(45) << "Stage" << std::right
+           << std::setw(15) << "Dropped" << '\n';
+        os << std::string(60, '-') << '\n';
+        for (size_t s = 0; s < stages_.size(); ++s) {
+            os << std::left << std::setw(45) << Describe(stages_[s])
+               << std::right << std::setw(15) << dropped_[s] << '\n';
+        }
+        os << std::left << std::setw(45) << "Input accesses" << std::right
+           << std::setw(15) << inputRecords_ << '\n';
+        os << std::left << std::setw(45) << "Output accesses" << std::right
+           << std::setw(15) << outputRecords_ << '\n';
+    }
+
+    UINT64 GetInputRecords() const { return inputRecords_; }
+    UINT64 GetOutputRecords() const { return outputRecords_; }
+};
+
+// Parse "LO:HI" (decimal or 0x-prefixed hex) into a stage's bounds
+inline bool ParseFilterRange(const std::string& text, TraceFilterStage& stage) {
+    size_t colon = text.find(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    stage.lo = std::stoull(text.substr(0, colon), nullptr, 0);
+    stage.hi = std::stoull(text.substr(colon + 1), nullptr, 0);
+    return true;
+}
+
+// Consume a filter option at argv[i], appending its stage. Returns false if
+// argv[i] is not a filter option.
+inline bool ParseFilterOption(int argc, char* argv[], int& i,
+                              std::vector<TraceFilterStage>& stages) {
+    std::string arg = argv[i];
+    TraceFilterStage stage;
+    if (arg == "--filter_reads") {
+        stage.kind = TraceFilterStage::kReadsOnly;
+    } else if (arg == "--filter_writes") {
+        stage.kind = TraceFilterStage::kWritesOnly;
+    } else if ((arg == "--filter_pc" || arg == "--filter_ea" ||
+                arg == "--rebase") &&
+               i + 1 < argc) {
+        stage.kind = arg == "--filter_pc"   ? TraceFilterStage::kPcRange
+                     : arg == "--filter_ea" ? TraceFilterStage::kEaRange
+                                            : TraceFilterStage::kRebase;
+        if (!ParseFilterRange(argv[++i], stage)) {
+            std::cerr << "Error: " << arg << " expects LO:HI" << '\n';
+            exit(1);
+        }
+        // An empty range would wrap in Apply and keep nearly everything
+        if (stage.kind != TraceFilterStage::kRebase && stage.hi <= stage.lo) {
+            std::cerr << "Error: " << arg << " expects LO < HI" << '\n';
+            exit(1);
+        }
+    } else if (arg == "--scale" && i + 1 < argc) {
+        stage.kind = TraceFilterStage::kScale;
+        stage.lo = std::stoull(argv[++i], nullptr, 0);
+    } else if (arg == "--filter_tid" && i + 1 < argc) {
+        stage.kind = TraceFilterStage::kThread;
+        stage.lo = std::stoull(argv[++i], nullptr, 0);
+    } else {
+        return false;
+    }
+    stages.push_back(stage);
+    return true;
+}
+
+inline void PrintFilterUsage(std::ostream& os) {
+    os << "Trace filter stages (applied in the order given):\n"
+       << "  --filter_reads            Keep only reads\n"
+       << "  --filter_writes           Keep only writes\n"
+       << "  --filter_pc LO:HI         Keep accesses with LO <= pc < HI\n"
+       << "  --filter_ea LO:HI         Keep accesses with LO <= ea < HI\n"
+       << "  --rebase FROM:TO          Rewrite ea as ea - FROM + TO\n"
+       << "  --scale N                 Rewrite ea as ea * N\n"
+       << "  --filter_tid N            Keep only thread N (version 2 "
+          "traces; version 1 traces are thread 0)\n";
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstring>
+#include <ostream>
+#include <vector>
+#include "common.h"
+
+// Trace file formats.
+//
+// Version 1 is a bare array of 24-byte MEMREF records with no header.
+//
+// Version 2 starts with a TraceFileHeader and stores each access as a
+// variable-length record carrying its thread, the instructions that thread
+// retired since its previous access, and its MemRefFlag bits:
+//
+//   head byte   bit 0 read, bit 1 flags follow, bit 2 tid follows (the
+//               thread changed), bit 3 instruction delta follows (nonzero),
+//               bits 4-7 size code: 1 << (code - 1) bytes, 0 = size follows
+//   pc, ea      zigzag varint deltas from the previous record's
+//   [size] [flags] [tid] [instructions]   varints
+//
+// A typical record takes 4-8 bytes instead of 24. A version 1 trace never
+// starts with the header magic: as a pc it would be a non-canonical
+// address.
+
+constexpr char kTraceMagic[8] = {'M', 'E', 'M', 'T', 'R', 'A', 'C', 'E'};
+constexpr UINT32 kTraceFormatVersion = 2;
+
+// TraceFileHeader::features bits
+enum TraceFeature : UINT32 {
+    kTraceHasThreads = 1 << 0,       // tid is recorded
+    kTraceHasInstructions = 1 << 1,  // Instruction deltas are recorded
+};
+
+struct TraceFileHeader {
+    char magic[8];    // kTraceMagic
+    UINT32 version;   // Format version, 2 or later
+    UINT32 features;  // TraceFeature bits
+};
+static_assert(sizeof(TraceFileHeader) == 16, "unexpected header padding");
+
+inline bool IsTraceHeader(const TraceFileHeader& header) {
+    return memcmp(header.magic, kTraceMagic, sizeof(kTraceMagic)) == 0;
+}
+
+// Longest encoded record: head, two 10-byte and four 5-byte varints
+constexpr UINT64 kTraceMaxRecordBytes = 1 + 2 * 10 + 4 * 5;
+
+inline UINT8* PutVarint(UINT8* p, UINT64 value) {
+    while (value >= 0x80) {
+        *p++ = (UINT8)value | 0x80;
+        value >>= 7;
+    }
+    *p++ = (UINT8)value;
+    return p;
+}
+
+// Decode a varint from [p, end), false if it is cut off
+inline bool GetVarint(const UINT8*& p, const UINT8* end, UINT64& value) {
+    value = 0;
+    for (UINT32 shift = 0; p < end; shift += 7) {
+        UINT8 byte = *p++;
+        value |= (UINT64)(byte & 0x7f) << (shift & 63);
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline UINT64 ZigZag(UINT64 delta) {
+    return (delta << 1) ^ (UINT64)((INT64)delta >> 63);
+}
+
+inline UINT64 UnZigZag(UINT64 value) { return (value >> 1) ^ (0 - (value & 1)); }
+
+// Version 2 record codec; the encoder and decoder of one stream keep the
+// same delta state, so records must be decoded in order
+class TraceCodec {
+   private:
+    ADDRINT pc_ = 0;
+    ADDRINT ea_ = 0;
+    UINT32 tid_ = 0;
+
+    enum : UINT8 {
+        kHeadRead = 1 << 0,
+        kHeadFlags = 1 << 1,
+        kHeadTid = 1 << 2,
+        kHeadInstructions = 1 << 3,
+        kHeadSizeShift = 4,
+    };
+
+   public:
+    // Encode one record at p (room for kTraceMaxRecordBytes), returns the
+    // end of the record
+    UINT8* Encode(UINT8* p, const MEMREF& ref, const MemRefContext& context) {
+        UINT8 head = ref.read ? kHeadRead : 0;
+        head |= ref.flags ? kHeadFlags : 0;
+        head |= context.tid != tid_ ? kHeadTid : 0;
+        head |= context.instructions ? kHeadInstructions : 0;
+        UINT8 sizeCode = 0;
+        if (ref.size != 0 && (ref.size & (ref.size - 1)) == 0 &&
+            ref.size <= (1u << 14)) {
+            sizeCode = StaticLog2(ref.size) + 1;
+        }
+        head |= sizeCode << kHeadSizeShift;
+
+        *p++ = head;
+        p = PutVarint(p, ZigZag(ref.pc - pc_));
+        p = PutVarint(p, ZigZag(ref.ea - ea_));
+        if (sizeCode == 0) {
+            p = PutVarint(p, ref.size);
+        }
+        if (head & kHeadFlags) {
+            p = PutVarint(p, ref.flags);
+        }
+        if (head & kHeadTid) {
+            p = PutVarint(p, context.tid);
+        }
+        if (head & kHeadInstructions) {
+            p = PutVarint(p, context.instructions);
+        }
+        pc_ = ref.pc;
+        ea_ = ref.ea;
+        tid_ = context.tid;
+        return p;
+    }
+
+    // Decode the record at p; false, with p and the state untouched, if
+    // [p, end) holds only part of it
+    bool Decode(const UINT8*& p, const UINT8* end, MEMREF& ref,
+                MemRefContext& context) {
+        const UINT8* q = p;
+        if (q == end) {
+            return false;
+        }
+        UINT8 head = *q++;
+        UINT64 pcDelta, eaDelta;
+        UINT64 size = 0, flags = 0, tid = tid_, instructions = 0;
+        UINT8 sizeCode = head >> kHeadSizeShift;
+        if (!GetVarint(q, end, pcDelta) || !GetVarint(q, end, eaDelta) ||
+            (sizeCode == 0 && !GetVarint(q, end, size)) ||
+            ((head & kHeadFlags) && !GetVarint(q, end, flags)) ||
+            ((head & kHeadTid) && !GetVarint(q, end, tid)) ||
+            ((head & kHeadInstructions) && !GetVarint(q, end, instructions))) {
+            return false;
+        }
+        pc_ += UnZigZag(pcDelta);
+        ea_ += UnZigZag(eaDelta);
+        tid_ = (UINT32)tid;
+        ref.pc = pc_;
+        ref.ea = ea_;
+        ref.size = sizeCode ? 1u << (sizeCode - 1) : (UINT32)size;
+        ref.read = head & kHeadRead;
+        ref.flags = (UINT16)flags;
+        context.tid = tid_;
+        context.instructions = (UINT32)instructions;
+        p = q;
+        return true;
+    }
+};
+
+// Writes MEMREF batches as a version 1 or version 2 trace
+class TraceWriter {
+   private:
+    std::ostream* os_ = nullptr;
+    UINT32 version_ = 1;
+    TraceCodec codec_;
+    std::vector<UINT8> bytes_;
+
+   public:
+    // Start a trace on os; features (TraceFeature) describe what the
+    // contexts passed to Write carry
+    void Open(std::ostream& os, UINT32 version, UINT32 features = 0) {
+        os_ = &os;
+        version_ = version;
+        codec_ = TraceCodec();
+        if (version_ >= 2) {
+            TraceFileHeader header;
+            memcpy(header.magic, kTraceMagic, sizeof(kTraceMagic));
+            header.version = kTraceFormatVersion;
+            header.features = features;
+            os_->write(reinterpret_cast<const char*>(&header), sizeof(header));
+        }
+    }
+
+    // Append count accesses; context may be null (thread 0, no
+    // instruction deltas) and is ignored by version 1
+    void Write(const MEMREF* refs, const MemRefContext* context,
+               UINT64 count) {
+        if (version_ < 2) {
+            os_->write(reinterpret_cast<const char*>(refs),
+                       count * sizeof(MEMREF));
+            return;
+        }
+        bytes_.resize(count * kTraceMaxRecordBytes);
+        UINT8* p = bytes_.data();
+        const MemRefContext none = {0, 0};
+        for (UINT64 i = 0; i < count; ++i) {
+            p = codec_.Encode(p, refs[i], context ? context[i] : none);
+        }
+        os_->write(reinterpret_cast<const char*>(bytes_.data()),
+                   p - bytes_.data());
+    }
+
+    UINT32 GetVersion() const { return version_; }
+};
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "common.h"
+#include "shm_ring.h"
+#include "trace_format.h"
+
+// Batch reader for binary MEMREF traces. Besides regular files the trace
+// may be streamed: "-" reads stdin, a FIFO is opened like a file, a Unix
+// domain socket path is connected to, and "shm:NAME" attaches to the
+// shared-memory ring NAME published by the Pin tool (shm_ring.h). Reads
+// block until the batch is full (or the stream ends), so a producer faster
+// than the simulator stalls on the full pipe, socket buffer or ring
+// instead of the trace being staged anywhere.
+//
+// Both trace formats are read (trace_format.h): version 1 MEMREF arrays
+// and version 2 traces, whose thread and instruction deltas are returned
+// as MemRefContext. The format is told from the first bytes, so it works
+// on streams too; the shared-memory ring carries version 1 records.
+class TraceReader {
+   private:
+    // Kernel buffering requested for pipes and sockets: how far a live
+    // producer can run ahead before it is throttled
+    static constexpr int kStreamBufferBytes = 1 << 20;
+
+    std::string path_;    // Path of the trace being read
+    int fd_;              // Underlying trace descriptor, -1 when closed
+    bool ownsFd_;         // False for stdin
+    std::unique_ptr<ShmRingReader> ring_;  // Set for shm: traces
+    UINT64 recordsRead_;  // Number of complete records returned so far
+    TraceFileHeader header_;  // Version 1 for headerless traces
+
+    // Bytes read ahead of the records returned: the sniffed start of a
+    // version 1 trace, or undecoded version 2 records
+    std::vector<UINT8> bytes_;
+    UINT64 bytePos_;
+    UINT64 byteEnd_;
+    bool eof_;
+    TraceCodec codec_;
+
+    // Connect to the Unix domain socket at path, -1 on failure
+    static int ConnectSocket(const std::string& path) {
+        sockaddr_un addr = {};
+        if (path.size() >= sizeof(addr.sun_path)) {
+            return -1;
+        }
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) !=
+            0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Size the stream's kernel buffer; best effort
+    void SetStreamBuffer() {
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+            return;
+        }
+        if (S_ISFIFO(st.st_mode)) {
+#ifdef F_SETPIPE_SZ
+            fcntl(fd_, F_SETPIPE_SZ, kStreamBufferBytes);
+#endif
+        } else if (S_ISSOCK(st.st_mode)) {
+            int size = kStreamBufferBytes;
+            setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        } else if (S_ISREG(st.st_mode)) {
+#ifdef POSIX_FADV_SEQUENTIAL
+            posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        }
+    }
+
+   public:
+    // Read up to size bytes into data, fewer only at the end of the stream
+    UINT64 ReadFully(void* data, UINT64 size) {
+        char* out = static_cast<char*>(data);
+        UINT64 bytesRead = 0;
+        while (bytesRead < size) {
+            ssize_t n = read(fd_, out + bytesRead, size - bytesRead);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                std::cerr << "Warning: Error reading " << path_ << ": "
+                          << strerror(errno) << ". Stopping." << '\n';
+                break;
+            }
+            if (n == 0) {
+                // End of file, or the writer closed the stream
+                break;
+            }
+            bytesRead += n;
+        }
+        return bytesRead;
+    }
+
+    // Tell the format from the first bytes; a version 1 trace keeps them
+    // in bytes_ for the first batch
+    bool ReadHeader() {
+        TraceFileHeader header;
+        UINT64 n = ReadFully(&header, sizeof(header));
+        if (n == sizeof(header) && IsTraceHeader(header)) {
+            if (header.version > kTraceFormatVersion) {
+                std::cerr << "Error: " << path_ << " is trace format version "
+                          << header.version << ", newer than supported ("
+                          << kTraceFormatVersion << ")" << '\n';
+                return false;
+            }
+            header_ = header;
+            return true;
+        }
+        bytes_.assign(reinterpret_cast<UINT8*>(&header),
+                      reinterpret_cast<UINT8*>(&header) + n);
+        byteEnd_ = n;
+        return true;
+    }
+
+    // Move undecoded bytes to the front and read more behind them; false
+    // at the end of the stream
+    bool RefillBytes() {
+        if (eof_) {
+            return false;
+        }
+        UINT64 left = byteEnd_ - bytePos_;
+        memmove(bytes_.data(), bytes_.data() + bytePos_, left);
+        bytePos_ = 0;
+        byteEnd_ = left;
+        ssize_t n;
+        do {
+            n = read(fd_, bytes_.data() + byteEnd_, bytes_.size() - byteEnd_);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0) {
+            std::cerr << "Warning: Error reading " << path_ << ": "
+                      << strerror(errno) << ". Stopping." << '\n';
+        }
+        if (n <= 0) {
+            eof_ = true;
+            return false;
+        }
+        byteEnd_ += n;
+        return true;
+    }
+
+    UINT64 ReadVersion1(MEMREF* buffer, UINT64 maxRecords) {
+        char* data = reinterpret_cast<char*>(buffer);
+        UINT64 wanted = maxRecords * sizeof(MEMREF);
+        // Bytes read while telling the format start the trace
+        UINT64 bytesRead = std::min(wanted, byteEnd_ - bytePos_);
+        if (bytesRead > 0) {
+            memcpy(data, bytes_.data() + bytePos_, bytesRead);
+            bytePos_ += bytesRead;
+        }
+        bytesRead += ReadFully(data + bytesRead, wanted - bytesRead);
+
+        // Calculate number of complete records read
+        UINT64 records = bytesRead / sizeof(MEMREF);
+        if (bytesRead % sizeof(MEMREF) != 0) {
+            std::cerr << "Warning: Partial record detected at end of file. "
+                         "Skipping."
+                      << '\n';
+        }
+        return records;
+    }
+
+    UINT64 ReadVersion2(MEMREF* buffer, UINT64 maxRecords,
+                        MemRefContext* context) {
+        UINT64 records = 0;
+        MemRefContext scratch;
+        while (records < maxRecords) {
+            const UINT8* p = bytes_.data() + bytePos_;
+            if (codec_.Decode(p, bytes_.data() + byteEnd_, buffer[records],
+                              context ? context[records] : scratch)) {
+                bytePos_ = p - bytes_.data();
+                records++;
+            } else if (!RefillBytes()) {
+                if (bytePos_ < byteEnd_) {
+                    std::cerr << "Warning: Partial record detected at end of "
+                                 "file. Skipping."
+                              << '\n';
+                    bytePos_ = byteEnd_;
+                }
+                break;
+            }
+        }
+        return records;
+    }
+
+   public:
+    // Bytes of version 2 records buffered per refill
+    static constexpr UINT64 kByteBufferSize = 1 << 16;
+
+    TraceReader()
+        : fd_(-1), ownsFd_(false), recordsRead_(0), bytePos_(0), byteEnd_(0),
+          eof_(false) {
+        header_.version = 1;
+        header_.features = 0;
+    }
+    ~TraceReader() { Close(); }
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+    TraceReader(TraceReader&& other) noexcept
+        : path_(std::move(other.path_)),
+          fd_(other.fd_),
+          ownsFd_(other.ownsFd_),
+          ring_(std::move(other.ring_)),
+          recordsRead_(other.recordsRead_),
+          header_(other.header_),
+          bytes_(std::move(other.bytes_)),
+          bytePos_(other.bytePos_),
+          byteEnd_(other.byteEnd_),
+          eof_(other.eof_),
+          codec_(other.codec_) {
+        other.fd_ = -1;
+    }
+
+    bool Open(const std::string& path) {
+        Close();
+        path_ = path;
+        recordsRead_ = 0;
+        header_.version = 1;
+        header_.features = 0;
+        bytes_.clear();
+        bytePos_ = byteEnd_ = 0;
+        eof_ = false;
+        codec_ = TraceCodec();
+        struct stat st;
+        if (path.compare(0, 4, "shm:") == 0) {
+            ring_.reset(new ShmRingReader());
+            if (!ring_->Open(path.substr(4))) {
+                ring_.reset();
+                return false;
+            }
+            return true;
+        } else if (path == "-") {
+            fd_ = STDIN_FILENO;
+            ownsFd_ = false;
+        } else if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            fd_ = ConnectSocket(path);
+            ownsFd_ = true;
+        } else {
+            fd_ = open(path.c_str(), O_RDONLY);
+            ownsFd_ = true;
+        }
+        if (fd_ < 0) {
+            return false;
+        }
+        SetStreamBuffer();
+        if (!ReadHeader()) {
+            Close();
+            return false;
+        }
+        if (header_.version >= 2) {
+            bytes_.resize(kByteBufferSize);
+        }
+        return true;
+    }
+
+    // Read up to maxRecords entries into buffer, returns 0 at end of trace.
+    // context, if given, receives each entry's thread and instruction delta
+    // (zero for version 1 traces).
+    UINT64 ReadBatch(MEMREF* buffer, UINT64 maxRecords,
+                     MemRefContext* context = nullptr) {
+        UINT64 records;
+        if (ring_) {
+            records = ring_->ReadBatch(buffer, maxRecords);
+        } else if (header_.version >= 2) {
+            records = ReadVersion2(buffer, maxRecords, context);
+        } else {
+            records = ReadVersion1(buffer, maxRecords);
+        }
+        if (context && header_.version < 2) {
+            memset(context, 0, records * sizeof(MemRefContext));
+        }
+        recordsRead_ += records;
+        return records;
+    }
+
+    void Close() {
+        ring_.reset();
+        if (fd_ >= 0 && ownsFd_) {
+            close(fd_);
+        }
+        fd_ = -1;
+    }
+
+    const std::string& GetPath() const { return path_; }
+    UINT64 GetRecordsRead() const { return recordsRead_; }
+    UINT32 GetVersion() const { return header_.version; }
+    UINT32 GetFeatures() const { return header_.features; }
+};